@@ -8,8 +8,10 @@ TEMPLATE = subdirs
 SUBDIRS += sonivox \
            libsvoxeas \
            cmdlnsynth \
-           guisynth
+           guisynth \
+           tests
 
 libsvoxeas.depends = sonivox
 cmdlnsynth.depends = libsvoxeas
 guisynth.depends = libsvoxeas
+tests.depends = libsvoxeas
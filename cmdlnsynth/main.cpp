@@ -18,12 +18,23 @@
 
 #include <QCommandLineParser>
 #include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
 #include <QFileInfo>
+#include <QTextStream>
+#include <QTimer>
 #include <signal.h>
 
+#include "compactsong.h"
 #include "eas_reverb.h"
+#include "libraryscanner.h"
+#include "offlinerenderer.h"
 #include "programsettings.h"
+#include "segmentrenderer.h"
+#include "stemrenderer.h"
+#include "tracer.h"
 #include "synthcontroller.h"
+#include "synthengine.h"
 
 #if QT_VERSION >= QT_VERSION_CHECK(5,15,0)
     #define endl Qt::endl
@@ -31,6 +42,152 @@
 
 static SynthController* synth = 0;
 
+void printStatistics()
+{
+    SynthStatistics stats = synth->renderer()->statistics();
+    QTextStream out(stdout);
+    out << "voices: " << stats.activeVoices << "/" << stats.polyphony
+        << " peak: " << stats.peakVoices << " steals: " << stats.voiceSteals
+        << " load: " << qRound(synth->renderer()->renderLoad() * 100) << "%"
+        << " buffer: " << synth->renderer()->bufferTime() << "ms";
+    if (ProgramSettings::instance()->adaptiveLatency()) {
+        out << " latency: " << synth->renderer()->outputLatency() << "ms";
+    }
+    for (int i = 0; i < SynthStatistics::MIDI_CHANNELS; ++i) {
+        if (stats.eventRate[i] > 0 || stats.channelVoices[i] > 0) {
+            out << " ch" << i + 1 << ": " << stats.channelVoices[i] << "v "
+                << QString::number(stats.noteRate[i], 'f', 1) << "n/s "
+                << QString::number(stats.eventRate[i], 'f', 1) << "e/s";
+        }
+    }
+    out << endl;
+}
+
+void printLatencyHistory()
+{
+    QTextStream out(stdout);
+    for (const LatencyChange &change : synth->renderer()->latencyHistory()) {
+        out << QString::number(change.time / 1000.0, 'f', 1) << "s: buffer "
+            << change.from << " -> " << change.to << "ms"
+            << (change.underrun ? " (underrun)" : "") << endl;
+    }
+}
+
+int renderFiles(const QStringList &files, const QDir &outDir)
+{
+    int errors = 0;
+    OfflineRenderer renderer;
+    QTextStream out(stdout);
+    for (const QString &file : files) {
+        QFileInfo argFile(file);
+        QString waveFile = outDir.absoluteFilePath(argFile.completeBaseName() + ".wav");
+        if (argFile.exists() && renderer.render(argFile.absoluteFilePath(), waveFile)) {
+            out << waveFile << ": " << QString::number(renderer.realtimeFactor(), 'f', 1)
+                << "x realtime" << (renderer.cacheHit() ? " (cached)" : "") << endl;
+        } else {
+            fprintf(stderr, "Failed to render %s\n", qPrintable(file));
+            errors++;
+        }
+    }
+    return errors > 0 ? 1 : 0;
+}
+
+int renderStems(const QStringList &files, const QDir &outDir, bool mix)
+{
+    int errors = 0;
+    StemRenderer renderer;
+    QTextStream out(stdout);
+    for (const QString &file : files) {
+        QFileInfo argFile(file);
+        if (argFile.exists() && renderer.render(argFile.absoluteFilePath(), outDir.absolutePath(), mix)) {
+            out << argFile.fileName() << ": " << renderer.files().count() << " files, "
+                << QString::number(renderer.realtimeFactor(), 'f', 1) << "x realtime" << endl;
+            for (const QString &stem : renderer.files()) {
+                out << "  " << stem << endl;
+            }
+        } else {
+            fprintf(stderr, "Failed to render %s: %s\n", qPrintable(file),
+                    qPrintable(renderer.errorString()));
+            errors++;
+        }
+    }
+    return errors > 0 ? 1 : 0;
+}
+
+int renderSegmented(const QStringList &files, const QDir &outDir, int segments, bool verify)
+{
+    int errors = 0;
+    SegmentRenderer renderer;
+    renderer.setSegments(segments);
+    QTextStream out(stdout);
+    for (const QString &file : files) {
+        QFileInfo argFile(file);
+        QString waveFile = outDir.absoluteFilePath(argFile.completeBaseName() + ".wav");
+        if (argFile.exists() && renderer.render(argFile.absoluteFilePath(), waveFile, verify)) {
+            out << waveFile << ": " << renderer.segments() << " segments, "
+                << QString::number(renderer.realtimeFactor(), 'f', 1) << "x realtime" << endl;
+            if (verify) {
+                out << "  serial: " << QString::number(renderer.serialRealtimeFactor(), 'f', 1)
+                    << "x realtime, max error: " << renderer.maxError() << ", rms error: "
+                    << (renderer.maxError() > 0 ? QString::number(renderer.rmsError(), 'f', 1) + " dBFS"
+                                                : QStringLiteral("none")) << endl;
+            }
+        } else {
+            fprintf(stderr, "Failed to render %s: %s\n", qPrintable(file),
+                    qPrintable(renderer.errorString()));
+            errors++;
+        }
+    }
+    return errors > 0 ? 1 : 0;
+}
+
+int scanLibrary(const QString &directory)
+{
+    QElapsedTimer timer;
+    timer.start();
+    LibraryIndex index;
+    index.load();
+    LibraryScanner scanner(&index);
+    scanner.scan(directory);
+    if (!index.save()) {
+        return 1;
+    }
+    QList<LibraryEntry> entries = index.entries(directory);
+    int valid = 0;
+    qint64 duration = 0;
+    for (const LibraryEntry &entry : entries) {
+        if (entry.valid) {
+            valid++;
+            duration += entry.duration;
+        }
+    }
+    QTextStream(stdout) << entries.count() << " files (" << valid << " valid, "
+                        << duration / 3600000 << " hours): " << scanner.parsedFiles() << " parsed, "
+                        << scanner.reusedFiles() << " unchanged, " << scanner.removedFiles()
+                        << " removed in " << timer.elapsed() << " ms" << endl;
+    return 0;
+}
+
+int compileSongs(const QStringList &files)
+{
+    int errors = 0;
+    QTextStream out(stdout);
+    for (const QString &file : files) {
+        QElapsedTimer timer;
+        timer.start();
+        CompactSong song;
+        if (song.compile(file)) {
+            out << file << ": " << song.count() << " events, " << song.tempoMap().count()
+                << " tempo changes, " << song.duration() / 1000 << " ms long, compiled in "
+                << timer.elapsed() << " ms" << endl;
+        } else {
+            fprintf(stderr, "Failed to compile %s: %s\n", qPrintable(file), qPrintable(song.errorString()));
+            errors++;
+        }
+    }
+    return errors > 0 ? 1 : 0;
+}
+
 void signalHandler(int sig)
 {
     if (sig == SIGINT)
@@ -59,12 +216,82 @@ int main(int argc, char *argv[])
     QCommandLineOption wetOption(QStringList() << "w" << "wet", "Reverb wet (0..32765).", "reverb_wet", "25800");
     QCommandLineOption chorusOption(QStringList() << "c" << "chorus", "Chorus type (none=-1,presets=0,1,2,3).", "chorus_type", "-1");
     QCommandLineOption levelOption(QStringList() << "l" << "level", "Chorus level (0..32765).", "chorus_level", "0");
+    QCommandLineOption governorOption(QStringList() << "g" << "governor", "Reduce polyphony and effects when the CPU load is too high. Remembered until --no-governor is given.");
+    QCommandLineOption noGovernorOption(QStringList() << "no-governor", "Keep the full polyphony and effects under any CPU load, the default.");
+    QCommandLineOption adaptiveOption(QStringList() << "a" << "adaptive-latency", "Adjust the buffer time to the underruns of the output, starting with --buffer. Remembered until --no-adaptive-latency is given.");
+    QCommandLineOption noAdaptiveOption(QStringList() << "no-adaptive-latency", "Keep the buffer time given with --buffer, the default.");
+    QCommandLineOption latencyFloorOption(QStringList() << "latency-floor", "Smallest buffer time in milliseconds with --adaptive-latency.", "milliseconds");
+    QCommandLineOption latencyCeilingOption(QStringList() << "latency-ceiling", "Largest buffer time in milliseconds with --adaptive-latency.", "milliseconds");
+    QCommandLineOption idleOption(QStringList() << "idle-suspend", "Stop rendering after two seconds of silence until MIDI input arrives. Remembered until --no-idle-suspend is given.");
+    QCommandLineOption noIdleOption(QStringList() << "no-idle-suspend", "Keep rendering during silence, the default.");
+    QCommandLineOption statsOption(QStringList() << "s" << "stats", "Print voice statistics every N seconds.", "seconds");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Render the MIDI files to WAV files in this directory instead of playing them.", "directory");
+    QCommandLineOption previewOption(QStringList() << "preview", "Preview the MIDI files one after another at reduced quality, at this playback rate (0.5..2.0).", "rate");
+    QCommandLineOption scanOption(QStringList() << "scan", "Update the library index with the MIDI files in this directory tree, and exit.", "directory");
+    QCommandLineOption stemsOption(QStringList() << "stems", "With --output, render each MIDI channel to its own WAV file.");
+    QCommandLineOption mixOption(QStringList() << "mix", "With --stems, also write the sum of all the stems.");
+    QCommandLineOption segmentsOption(QStringList() << "segments", "With --output, render each file in this many time segments in parallel (0 uses one per CPU).", "count");
+    QCommandLineOption verifyOption(QStringList() << "verify", "With --segments, also render each file serially and report the difference.");
+    QCommandLineOption noCacheOption(QStringList() << "no-cache", "Do not use the render cache. Remembered until --cache is given.");
+    QCommandLineOption cacheOption(QStringList() << "cache", "Use the render cache, the default.");
+    QCommandLineOption renderAheadOption(QStringList() << "render-ahead", "Milliseconds of file playback rendered ahead on a background thread (0 renders it with the live MIDI).", "milliseconds");
+    QCommandLineOption highPassOption(QStringList() << "highpass", "Cutoff frequency of the output high pass filter in Hz (0 disables it).", "frequency");
+    QCommandLineOption eqOption(QStringList() << "eq", "Output equalizer gains in dB for the low, mid and high bands (-24..24).", "low,mid,high");
+    QCommandLineOption limiterOption(QStringList() << "limiter", "Output limiter threshold in dBFS (-40..0, 0 disables it).", "threshold");
+    QCommandLineOption schedulingOption(QStringList() << "scheduling", "Scheduling policy of the render thread (normal, fifo, rr, deadline).", "policy");
+    QCommandLineOption priorityOption(QStringList() << "priority", "Real time priority for the fifo and rr policies (1..99).", "priority");
+    QCommandLineOption cpusOption(QStringList() << "cpus", "CPUs for the render thread, like 2,3 or 2-3.", "list");
+    QCommandLineOption workerCpusOption(QStringList() << "worker-cpus", "CPUs for the worker threads. By default, the ones not given to the render thread.", "list");
+    QCommandLineOption portsOption(QStringList() << "p" << "ports", "Number of ALSA input ports, each one with its own synthesizer (1..16).", "ports");
+    QCommandLineOption portSoundfontOption(QStringList() << "port-soundfont", "DLS soundfont for the next additional input port, starting with the second one. May be repeated.", "file");
+    QCommandLineOption separateOption(QStringList() << "separate-outputs", "Send each input port to its own PulseAudio stream instead of mixing them. Remembered until --mixed-outputs is given.");
+    QCommandLineOption mixedOption(QStringList() << "mixed-outputs", "Mix all the input ports into one PulseAudio stream, the default.");
+    QCommandLineOption traceOption(QStringList() << "trace", "Write trace events in Chrome JSON format to this file.", "file");
+    QCommandLineOption compactOption(QStringList() << "compact-songs", "Play and render MIDI files from a compiled event array, compiling them at the first open. Remembered until --no-compact-songs is given.");
+    QCommandLineOption noCompactOption(QStringList() << "no-compact-songs", "Play and render MIDI files with the EAS file parser, the default.");
+    QCommandLineOption compileOption(QStringList() << "compile", "Compile the MIDI files for --compact-songs, and exit.");
+    QCommandLineOption midiInputOption(QStringList() << "m" << "midi-input", "Read raw MIDI bytes from an ALSA rawmidi device (hw:x,y,z), a named pipe, or the standard input (-). May be repeated.", "source");
     parser.addOption(bufferOption);
     parser.addOption(dlsOption);
     parser.addOption(reverbOption);
     parser.addOption(wetOption);
     parser.addOption(chorusOption);
     parser.addOption(levelOption);
+    parser.addOption(governorOption);
+    parser.addOption(noGovernorOption);
+    parser.addOption(statsOption);
+    parser.addOption(adaptiveOption);
+    parser.addOption(noAdaptiveOption);
+    parser.addOption(latencyFloorOption);
+    parser.addOption(latencyCeilingOption);
+    parser.addOption(idleOption);
+    parser.addOption(noIdleOption);
+    parser.addOption(outputOption);
+    parser.addOption(scanOption);
+    parser.addOption(previewOption);
+    parser.addOption(stemsOption);
+    parser.addOption(mixOption);
+    parser.addOption(segmentsOption);
+    parser.addOption(verifyOption);
+    parser.addOption(noCacheOption);
+    parser.addOption(cacheOption);
+    parser.addOption(renderAheadOption);
+    parser.addOption(highPassOption);
+    parser.addOption(eqOption);
+    parser.addOption(limiterOption);
+    parser.addOption(schedulingOption);
+    parser.addOption(priorityOption);
+    parser.addOption(cpusOption);
+    parser.addOption(workerCpusOption);
+    parser.addOption(midiInputOption);
+    parser.addOption(compactOption);
+    parser.addOption(noCompactOption);
+    parser.addOption(compileOption);
+    parser.addOption(traceOption);
+    parser.addOption(portsOption);
+    parser.addOption(portSoundfontOption);
+    parser.addOption(separateOption);
+    parser.addOption(mixedOption);
     parser.addPositionalArgument("files", "MIDI Files (.mid;.kar)", "[files ...]");
     parser.process(app);
     ProgramSettings::instance()->ReadFromNativeStorage();
@@ -77,6 +304,39 @@ int main(int argc, char *argv[])
             parser.showHelp(1);
         }
     }
+    if (parser.isSet(adaptiveOption)) {
+        ProgramSettings::instance()->setAdaptiveLatency(true);
+    } else if (parser.isSet(noAdaptiveOption)) {
+        ProgramSettings::instance()->setAdaptiveLatency(false);
+    }
+    if (parser.isSet(latencyFloorOption)) {
+        int n = parser.value(latencyFloorOption).toInt();
+        if (n > 0)
+            ProgramSettings::instance()->setLatencyFloor(n);
+        else {
+            fputs("Wrong latency floor.\n", stderr);
+            parser.showHelp(1);
+        }
+    }
+    if (parser.isSet(latencyCeilingOption)) {
+        int n = parser.value(latencyCeilingOption).toInt();
+        if (n >= ProgramSettings::instance()->latencyFloor())
+            ProgramSettings::instance()->setLatencyCeiling(n);
+        else {
+            fputs("Wrong latency ceiling.\n", stderr);
+            parser.showHelp(1);
+        }
+    }
+    if (parser.isSet(idleOption)) {
+        ProgramSettings::instance()->setIdleSuspend(true);
+    } else if (parser.isSet(noIdleOption)) {
+        ProgramSettings::instance()->setIdleSuspend(false);
+    }
+    if (parser.isSet(compactOption)) {
+        ProgramSettings::instance()->setCompactSongs(true);
+    } else if (parser.isSet(noCompactOption)) {
+        ProgramSettings::instance()->setCompactSongs(false);
+    }
     if (parser.isSet(dlsOption)) {
         ProgramSettings::instance()->setDLSsoundfont(parser.value(dlsOption));
     }
@@ -116,25 +376,262 @@ int main(int argc, char *argv[])
             parser.showHelp(1);
         }
     }
+    if (parser.isSet(governorOption)) {
+        ProgramSettings::instance()->setLoadGovernor(true);
+    } else if (parser.isSet(noGovernorOption)) {
+        ProgramSettings::instance()->setLoadGovernor(false);
+    }
+    if (parser.isSet(portsOption)) {
+        int n = parser.value(portsOption).toInt();
+        if (n >= 1 && n <= 16)
+            ProgramSettings::instance()->setInputPorts(n);
+        else {
+            fputs("Wrong number of ports.\n", stderr);
+            parser.showHelp(1);
+        }
+    }
+    if (parser.isSet(portSoundfontOption)) {
+        ProgramSettings::instance()->setPortSoundfonts(parser.values(portSoundfontOption));
+    }
+    if (parser.isSet(separateOption)) {
+        ProgramSettings::instance()->setSeparateOutputs(true);
+    } else if (parser.isSet(mixedOption)) {
+        ProgramSettings::instance()->setSeparateOutputs(false);
+    }
+    if (parser.isSet(noCacheOption)) {
+        ProgramSettings::instance()->setRenderCache(false);
+    } else if (parser.isSet(cacheOption)) {
+        ProgramSettings::instance()->setRenderCache(true);
+    }
+    if (parser.isSet(renderAheadOption)) {
+        int n = parser.value(renderAheadOption).toInt();
+        if (n >= 0 && n <= 10000)
+            ProgramSettings::instance()->setRenderAhead(n);
+        else {
+            fputs("Wrong render ahead time.\n", stderr);
+            parser.showHelp(1);
+        }
+    }
+    if (parser.isSet(highPassOption)) {
+        int n = parser.value(highPassOption).toInt();
+        if (n >= 0 && n <= 2000)
+            ProgramSettings::instance()->setHighPass(n);
+        else {
+            fputs("Wrong high pass frequency.\n", stderr);
+            parser.showHelp(1);
+        }
+    }
+    if (parser.isSet(eqOption)) {
+        QList<int> gains;
+        for (const QString &value : parser.value(eqOption).split(',')) {
+            bool ok;
+            int n = value.toInt(&ok);
+            if (ok && n >= -24 && n <= 24) {
+                gains << n;
+            }
+        }
+        if (gains.count() == 3)
+            ProgramSettings::instance()->setEqualizer(gains);
+        else {
+            fputs("Wrong equalizer gains.\n", stderr);
+            parser.showHelp(1);
+        }
+    }
+    if (parser.isSet(limiterOption)) {
+        int n = parser.value(limiterOption).toInt();
+        if (n >= -40 && n <= 0)
+            ProgramSettings::instance()->setLimiter(n);
+        else {
+            fputs("Wrong limiter threshold.\n", stderr);
+            parser.showHelp(1);
+        }
+    }
+    if (parser.isSet(schedulingOption)) {
+        ThreadSchedule::Policy policy;
+        if (ThreadSchedule::parsePolicy(parser.value(schedulingOption), &policy))
+            ProgramSettings::instance()->setSchedulingPolicy(ThreadSchedule::policyName(policy));
+        else {
+            fputs("Wrong scheduling policy.\n", stderr);
+            parser.showHelp(1);
+        }
+    }
+    if (parser.isSet(priorityOption)) {
+        int n = parser.value(priorityOption).toInt();
+        if (n >= 1 && n <= 99)
+            ProgramSettings::instance()->setRealtimePriority(n);
+        else {
+            fputs("Wrong real time priority.\n", stderr);
+            parser.showHelp(1);
+        }
+    }
+    if (parser.isSet(cpusOption)) {
+        QList<int> cpus;
+        if (ThreadSchedule::parseCpus(parser.value(cpusOption), &cpus))
+            ProgramSettings::instance()->setRenderCpus(parser.value(cpusOption));
+        else {
+            fputs("Wrong CPU list.\n", stderr);
+            parser.showHelp(1);
+        }
+    }
+    if (parser.isSet(workerCpusOption)) {
+        QList<int> cpus;
+        if (ThreadSchedule::parseCpus(parser.value(workerCpusOption), &cpus))
+            ProgramSettings::instance()->setWorkerCpus(parser.value(workerCpusOption));
+        else {
+            fputs("Wrong CPU list.\n", stderr);
+            parser.showHelp(1);
+        }
+    }
+    if (parser.isSet(traceOption)) {
+#ifdef SVOXEAS_TRACING
+        if (!Tracer::instance()->start(parser.value(traceOption))) {
+            fputs("Wrong trace file.\n", stderr);
+            parser.showHelp(1);
+        }
+        QObject::connect(&app, &QCoreApplication::aboutToQuit, [] { Tracer::instance()->stop(); });
+#else
+        fputs("Tracing is not available in this build, configure with USE_TRACING.\n", stderr);
+#endif
+    }
+    SynthEngine::setCompactSongs(ProgramSettings::instance()->compactSongs());
+    if (parser.isSet(compileOption)) {
+        if (parser.positionalArguments().isEmpty()) {
+            fputs("No MIDI files to compile.\n", stderr);
+            parser.showHelp(1);
+        }
+        return compileSongs(parser.positionalArguments());
+    }
+    if (parser.isSet(scanOption)) {
+        QFileInfo dir(parser.value(scanOption));
+        if (!dir.isDir()) {
+            fputs("Wrong library directory.\n", stderr);
+            parser.showHelp(1);
+        }
+        return scanLibrary(dir.absoluteFilePath());
+    }
+    if (parser.isSet(outputOption)) {
+        QDir outDir(parser.value(outputOption));
+        if (!QDir().mkpath(outDir.absolutePath())) {
+            fputs("Wrong output directory.\n", stderr);
+            parser.showHelp(1);
+        }
+        if (parser.positionalArguments().isEmpty()) {
+            fputs("No MIDI files to render.\n", stderr);
+            parser.showHelp(1);
+        }
+        if (parser.isSet(stemsOption)) {
+            return renderStems(parser.positionalArguments(), outDir, parser.isSet(mixOption));
+        }
+        if (parser.isSet(segmentsOption)) {
+            bool ok;
+            int segments = parser.value(segmentsOption).toInt(&ok);
+            if (!ok || segments < 0 || segments > 256) {
+                fputs("Wrong number of segments.\n", stderr);
+                parser.showHelp(1);
+            }
+            return renderSegmented(parser.positionalArguments(), outDir, segments, parser.isSet(verifyOption));
+        }
+        return renderFiles(parser.positionalArguments(), outDir);
+    }
     synth = new SynthController(ProgramSettings::instance()->bufferTime());
-    synth->renderer()->setReverbWet(ProgramSettings::instance()->reverbWet());
+    synth->renderer()->setGovernorEnabled(ProgramSettings::instance()->loadGovernor());
+    synth->renderer()->setRenderCacheEnabled(ProgramSettings::instance()->renderCache());
+    synth->renderer()->setRenderCacheSize(ProgramSettings::instance()->renderCacheSize());
+    synth->renderer()->setRenderAhead(ProgramSettings::instance()->renderAhead());
+    synth->renderer()->setAdaptiveLatency(ProgramSettings::instance()->adaptiveLatency(),
+                                          ProgramSettings::instance()->latencyFloor(),
+                                          ProgramSettings::instance()->latencyCeiling());
+    synth->renderer()->setIdleSuspend(ProgramSettings::instance()->idleSuspend());
+    synth->renderer()->setScheduling(ProgramSettings::instance()->renderSchedule(),
+                                     ProgramSettings::instance()->workerSchedule());
+    synth->renderer()->setDspParameter(DspChain::HighPassFrequency, ProgramSettings::instance()->highPass());
+    QList<int> equalizer = ProgramSettings::instance()->equalizer();
+    synth->renderer()->setDspParameter(DspChain::LowShelfGain, equalizer.value(0));
+    synth->renderer()->setDspParameter(DspChain::PeakGain, equalizer.value(1));
+    synth->renderer()->setDspParameter(DspChain::HighShelfGain, equalizer.value(2));
+    synth->renderer()->setDspParameter(DspChain::LimiterThreshold, ProgramSettings::instance()->limiter());
+    synth->renderer()->initSoundfont(ProgramSettings::instance()->dlsSoundfont());
     synth->renderer()->initReverb(ProgramSettings::instance()->reverbType());
-    synth->renderer()->setChorusLevel(ProgramSettings::instance()->chorusLevel());
+    synth->renderer()->setReverbWet(ProgramSettings::instance()->reverbWet());
     synth->renderer()->initChorus(ProgramSettings::instance()->chorusType());
-    synth->renderer()->initSoundfont(ProgramSettings::instance()->dlsSoundfont());
+    synth->renderer()->setChorusLevel(ProgramSettings::instance()->chorusLevel());
+    QStringList portSoundfonts;
+    for (int port = 2; port <= ProgramSettings::instance()->inputPorts(); ++port) {
+        portSoundfonts << ProgramSettings::instance()->portSoundfont(port);
+    }
+    synth->renderer()->setInputPorts(ProgramSettings::instance()->inputPorts(), portSoundfonts,
+                                     ProgramSettings::instance()->separateOutputs());
+    for (const QString &source : parser.values(midiInputOption)) {
+        if (!synth->renderer()->addMidiInput(source)) {
+            fprintf(stderr, "Failed to open MIDI input %s\n", qPrintable(source));
+        }
+    }
+    if (ProgramSettings::instance()->adaptiveLatency()) {
+        QObject::connect(&app, &QCoreApplication::aboutToQuit, printLatencyHistory);
+    }
     QObject::connect(&app, &QCoreApplication::aboutToQuit, synth, &QObject::deleteLater);
     QObject::connect(&app, &QCoreApplication::aboutToQuit, ProgramSettings::instance(), &ProgramSettings::SaveToNativeStorage);
     QObject::connect(synth->renderer(), &SynthRenderer::playbackStopped, &app, &QCoreApplication::quit);
     QObject::connect(synth->renderer(), &SynthRenderer::finished, &app, &QCoreApplication::quit);
+    double previewRate = 0.0;
+    if (parser.isSet(previewOption)) {
+        previewRate = parser.value(previewOption).toDouble();
+        if (previewRate < 0.5 || previewRate > 2.0) {
+            fputs("Wrong preview rate.\n", stderr);
+            parser.showHelp(1);
+        }
+    }
+    QStringList previews;
+    LibraryIndex library;
+    library.load();
     QStringList args = parser.positionalArguments();
     if (!args.isEmpty()) {
         for(int i = 0; i < args.length();  ++i) {
             QFileInfo argFile(args[i]);
-            if (argFile.exists()) {
+            if (argFile.isDir()) {
+                /* a directory plays every valid file in it, using the library index */
+                LibraryScanner scanner(&library);
+                scanner.scan(argFile.absoluteFilePath());
+                library.save();
+                for (const LibraryEntry &entry : library.entries(argFile.absoluteFilePath())) {
+                    if (entry.valid && previewRate > 0.0) {
+                        previews << entry.path;
+                    } else if (entry.valid) {
+                        synth->renderer()->playFile(entry.path);
+                    }
+                }
+            } else if (argFile.exists() && previewRate > 0.0) {
+                previews << argFile.absoluteFilePath();
+            } else if (argFile.exists()) {
                 synth->renderer()->playFile(argFile.absoluteFilePath());
             }
         }
     }
+    synth->renderer()->setLibraryIndex(library);
+    if (!previews.isEmpty()) {
+        /* each preview starts when the previous one ends */
+        QObject::connect(synth->renderer(), &SynthRenderer::previewStopped, &app, [&previews, previewRate] {
+            if (previews.isEmpty()) {
+                QCoreApplication::quit();
+            } else {
+                QTextStream(stdout) << "Preview: " << previews.first() << endl;
+                synth->renderer()->startPreview(previews.takeFirst(), previewRate);
+            }
+        });
+        QTextStream(stdout) << "Preview: " << previews.first() << endl;
+        synth->renderer()->startPreview(previews.takeFirst(), previewRate);
+    }
+    QTimer statsTimer;
+    if (parser.isSet(statsOption)) {
+        int n = parser.value(statsOption).toInt();
+        if (n > 0) {
+            QObject::connect(&statsTimer, &QTimer::timeout, printStatistics);
+            statsTimer.start(n * 1000);
+        } else {
+            fputs("Wrong statistics interval.\n", stderr);
+            parser.showHelp(1);
+        }
+    }
     synth->start();
     return app.exec();
 }
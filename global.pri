@@ -1,2 +1,5 @@
 VERSION = 1.3.0
 DEFINES += VERSION=$$VERSION
+tracing {
+    DEFINES += SVOXEAS_TRACING
+}
@@ -14,9 +14,11 @@ TARGET = guisynth
 TEMPLATE = app
 
 SOURCES += main.cpp\
-           mainwindow.cpp 
+           mainwindow.cpp \
+           scopewidget.cpp
 
-HEADERS  += mainwindow.h 
+HEADERS  += mainwindow.h \
+            scopewidget.h
 
 FORMS    += mainwindow.ui
 
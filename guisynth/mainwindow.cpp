@@ -20,7 +20,10 @@
 #include <QDebug>
 #include <QFileDialog>
 #include <QMimeData>
+#include <QStatusBar>
 
+#include "libraryscanner.h"
+#include "loadgovernor.h"
 #include "mainwindow.h"
 #include "programsettings.h"
 #include "ui_mainwindow.h"
@@ -30,6 +33,7 @@ MainWindow::MainWindow(QWidget *parent) :
     ui(new Ui::MainWindow),
     m_state(InitialState)
 {
+    SynthEngine::setCompactSongs(ProgramSettings::instance()->compactSongs());
     m_synth = new SynthController(ProgramSettings::instance()->bufferTime(), this);
 
     ui->setupUi(this);
@@ -66,6 +70,30 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->playButton, &QToolButton::clicked, this, &MainWindow::playSong);
     connect(ui->stopButton, &QToolButton::clicked, this, &MainWindow::stopSong);
     connect(m_synth->renderer(), &SynthRenderer::playbackStopped, this, &MainWindow::songStopped);
+    connect(m_synth->renderer(), &SynthRenderer::governorLevelChanged, this, &MainWindow::governorChanged);
+    /* a new preset reports its own level from the render thread */
+    connect(m_synth->renderer(), &SynthRenderer::reverbWetChanged, ui->dial_Reverb, &QDial::setValue);
+    connect(m_synth->renderer(), &SynthRenderer::chorusLevelChanged, ui->dial_Chorus, &QDial::setValue);
+    connect(&m_statsTimer, &QTimer::timeout, this, &MainWindow::updateStatistics);
+
+    m_statsLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(m_statsLabel);
+
+    /* the song position in milliseconds; a position set while stopped is where playback starts */
+    m_position = new QSlider(Qt::Horizontal, this);
+    m_position->setEnabled(false);
+    m_position->setPageStep(10000);
+    ui->gridLayout->addWidget(m_position, 4, 0, 1, 3);
+    connect(m_position, &QSlider::sliderReleased, this, &MainWindow::seekSong);
+    connect(m_position, &QSlider::actionTriggered, this, [this](int action) {
+        if (action != QAbstractSlider::SliderMove) {
+            seekSong();
+        }
+    });
+
+    m_scope = new ScopeWidget(this);
+    m_scope->setRenderer(m_synth->renderer());
+    ui->gridLayout->addWidget(m_scope, 7, 0, 1, 3);
 
     m_songFile = QString();
     updateState(EmptyState);
@@ -97,7 +125,37 @@ MainWindow::initialize()
     int chorus = ui->combo_Chorus->findData(ProgramSettings::instance()->chorusType());
     ui->combo_Chorus->setCurrentIndex(chorus);
     ui->dial_Chorus->setValue(ProgramSettings::instance()->chorusLevel());
+    m_synth->renderer()->setGovernorEnabled(ProgramSettings::instance()->loadGovernor());
+    m_synth->renderer()->setRenderCacheEnabled(ProgramSettings::instance()->renderCache());
+    m_synth->renderer()->setRenderCacheSize(ProgramSettings::instance()->renderCacheSize());
+    m_synth->renderer()->setRenderAhead(ProgramSettings::instance()->renderAhead());
+    m_synth->renderer()->setAdaptiveLatency(ProgramSettings::instance()->adaptiveLatency(),
+                                            ProgramSettings::instance()->latencyFloor(),
+                                            ProgramSettings::instance()->latencyCeiling());
+    m_synth->renderer()->setIdleSuspend(ProgramSettings::instance()->idleSuspend());
+    m_synth->renderer()->setScheduling(ProgramSettings::instance()->renderSchedule(),
+                                       ProgramSettings::instance()->workerSchedule());
+    m_synth->renderer()->setDspParameter(DspChain::HighPassFrequency, ProgramSettings::instance()->highPass());
+    QList<int> equalizer = ProgramSettings::instance()->equalizer();
+    m_synth->renderer()->setDspParameter(DspChain::LowShelfGain, equalizer.value(0));
+    m_synth->renderer()->setDspParameter(DspChain::PeakGain, equalizer.value(1));
+    m_synth->renderer()->setDspParameter(DspChain::HighShelfGain, equalizer.value(2));
+    m_synth->renderer()->setDspParameter(DspChain::LimiterThreshold, ProgramSettings::instance()->limiter());
+    QStringList portSoundfonts;
+    for (int port = 2; port <= ProgramSettings::instance()->inputPorts(); ++port) {
+        portSoundfonts << ProgramSettings::instance()->portSoundfont(port);
+    }
+    m_synth->renderer()->setInputPorts(ProgramSettings::instance()->inputPorts(), portSoundfonts,
+                                       ProgramSettings::instance()->separateOutputs());
+    m_library.load();
+    m_synth->renderer()->setLibraryIndex(m_library);
+    QFileInfo lastSong(ProgramSettings::instance()->lastSong());
+    if (!lastSong.filePath().isEmpty() && lastSong.exists()) {
+        readSongFile(lastSong);
+        m_position->setValue(ProgramSettings::instance()->lastPosition());
+    }
     m_synth->start();
+    m_statsTimer.start(500);
 
     ui->combo_ALSAConn->blockSignals(true);
     ui->combo_ALSAConn->clear();
@@ -115,7 +173,13 @@ MainWindow::showEvent(QShowEvent* ev)
 void
 MainWindow::closeEvent(QCloseEvent* ev)
 {
+    m_statsTimer.stop();
+    ProgramSettings::instance()->setLastSong(m_songFile);
+    ProgramSettings::instance()->setLastPosition(m_state == PlayingState
+                                                     ? m_synth->renderer()->playbackPosition()
+                                                     : m_position->value());
     m_synth->stop();
+    m_library.save();
     ProgramSettings::instance()->SaveToNativeStorage();
     ev->accept();
 }
@@ -140,10 +204,6 @@ MainWindow::reverbTypeChanged(int index)
     if (value < 0) {
         ui->dial_Reverb->setValue(0);
         ProgramSettings::instance()->setReverbWet(0);
-    } else {
-        int wet = m_synth->renderer()->reverbWet();
-        ui->dial_Reverb->setValue(wet);
-        ProgramSettings::instance()->setReverbWet(wet);
     }
 }
 
@@ -164,10 +224,6 @@ MainWindow::chorusTypeChanged(int index)
     if (value < 0) {
         ui->dial_Chorus->setValue(0);
         ProgramSettings::instance()->setChorusLevel(0);
-    } else {
-        int level = m_synth->renderer()->chorusLevel();
-        ui->dial_Chorus->setValue(level);
-        ProgramSettings::instance()->setChorusLevel(level);
     }
 }
 
@@ -179,12 +235,53 @@ MainWindow::chorusChanged(int value)
     ProgramSettings::instance()->setChorusLevel(value);
 }
 
+void
+MainWindow::governorChanged(int level)
+{
+    if (level == LoadGovernor::FullQuality) {
+        statusBar()->clearMessage();
+    } else {
+        statusBar()->showMessage(tr("High CPU load: %1").arg(LoadGovernor::levelName(level)));
+    }
+}
+
+void
+MainWindow::updateStatistics()
+{
+    SynthStatistics stats = m_synth->renderer()->statistics();
+    m_statsLabel->setText(tr("Voices: %1/%2 Peak: %3 Steals: %4 Buffer: %5 ms")
+                              .arg(stats.activeVoices)
+                              .arg(stats.polyphony)
+                              .arg(stats.peakVoices)
+                              .arg(stats.voiceSteals)
+                              .arg(m_synth->renderer()->bufferTime()));
+    if (m_state == PlayingState && !m_position->isSliderDown()) {
+        m_position->setValue(m_synth->renderer()->playbackPosition());
+    }
+}
+
 void
 MainWindow::readSongFile(const QFileInfo &file)
 {
     if (file.exists() && file.isReadable()) {
         m_songFile = file.absoluteFilePath();
-        ui->lblSong->setText(file.fileName());
+        LibraryEntry entry;
+        if (!m_library.lookup(m_songFile, entry)) {
+            entry = LibraryScanner::scanFile(m_songFile);
+            m_library.insert(entry);
+        }
+        m_position->setRange(0, entry.valid ? entry.duration : 0);
+        m_position->setValue(0);
+        m_position->setEnabled(entry.valid);
+        if (entry.valid) {
+            int seconds = entry.duration / 1000;
+            ui->lblSong->setText(QString("%1 (%2:%3)").arg(file.fileName())
+                                     .arg(seconds / 60).arg(seconds % 60, 2, 10, QChar('0')));
+            ui->lblSong->setToolTip(entry.title);
+        } else {
+            ui->lblSong->setText(file.fileName());
+            ui->lblSong->setToolTip(QString());
+        }
         updateState(StoppedState);
     }
 }
@@ -238,7 +335,7 @@ void
 MainWindow::playSong()
 {
     if (m_state == StoppedState) {
-        m_synth->renderer()->startPlayback(m_songFile);
+        m_synth->renderer()->startPlayback(m_songFile, m_position->value());
         updateState(PlayingState);
     }
 }
@@ -248,6 +345,7 @@ MainWindow::stopSong()
 {
     if (m_state == PlayingState) {
         m_synth->renderer()->stopPlayback();
+        m_position->setValue(0);
         updateState(StoppedState);
     }
 }
@@ -256,10 +354,19 @@ void
 MainWindow::songStopped()
 {
     if (m_state != StoppedState) {
+        m_position->setValue(0);
         updateState(StoppedState);
     }
 }
 
+void
+MainWindow::seekSong()
+{
+    if (m_state == PlayingState) {
+        m_synth->renderer()->seekPlayback(m_position->sliderPosition());
+    }
+}
+
 void
 MainWindow::updateState(PlayerState newState)
 {
@@ -21,6 +21,11 @@
 
 #include <QMainWindow>
 #include <QFileInfo>
+#include <QLabel>
+#include <QSlider>
+#include <QTimer>
+#include "libraryindex.h"
+#include "scopewidget.h"
 #include "synthcontroller.h"
 
 enum PlayerState {
@@ -59,11 +64,14 @@ private slots:
     void reverbChanged(int value);
     void chorusChanged(int value);
     void songStopped();
+    void governorChanged(int level);
+    void updateStatistics();
 
     void openMIDIFile();
     void openDLSFile();
     void playSong();
     void stopSong();
+    void seekSong();
 
 private:
     Ui::MainWindow *ui;
@@ -72,6 +80,11 @@ private:
     QString m_dlsFile;
     PlayerState m_state;
     QString m_subscription;
+    QLabel *m_statsLabel;
+    QSlider *m_position;
+    ScopeWidget *m_scope;
+    QTimer m_statsTimer;
+    LibraryIndex m_library;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,148 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QPainter>
+#include <QPainterPath>
+#include <cmath>
+
+#include "scopewidget.h"
+
+static const int SCOPE_FRAMES = 512;
+static const int SCOPE_DECIMATION = 2;
+static const int METER_WIDTH = 10;
+static const float METER_RANGE_DB = 60.0f;
+static const float PEAK_DECAY = 0.85f;
+
+static float meterFraction(float level)
+{
+    if (level <= 0.0f) {
+        return 0.0f;
+    }
+    float db = 20.0f * std::log10(level);
+    return qBound(0.0f, (db + METER_RANGE_DB) / METER_RANGE_DB, 1.0f);
+}
+
+ScopeWidget::ScopeWidget(QWidget *parent) : QWidget(parent),
+    m_renderer(nullptr),
+    m_channels(LevelMeter::MAX_CHANNELS)
+{
+    for (int ch = 0; ch < LevelMeter::MAX_CHANNELS; ++ch) {
+        m_peak[ch] = m_rms[ch] = 0.0f;
+    }
+    m_history.fill(0, SCOPE_FRAMES * m_channels);
+    m_chunk.resize(SCOPE_FRAMES * LevelMeter::MAX_CHANNELS);
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    connect(&m_timer, &QTimer::timeout, this, &ScopeWidget::refresh);
+}
+
+void ScopeWidget::setRenderer(SynthRenderer *renderer)
+{
+    m_renderer = renderer;
+    if (m_renderer != nullptr) {
+        m_renderer->audioTap()->setDecimation(SCOPE_DECIMATION);
+        m_renderer->audioTap()->setEnabled(isVisible());
+    }
+}
+
+QSize ScopeWidget::sizeHint() const
+{
+    return QSize(SCOPE_FRAMES / 2, 64);
+}
+
+void ScopeWidget::showEvent(QShowEvent *ev)
+{
+    QWidget::showEvent(ev);
+    if (m_renderer != nullptr) {
+        m_renderer->audioTap()->setEnabled(true);
+    }
+    m_timer.start(33);
+}
+
+void ScopeWidget::hideEvent(QHideEvent *ev)
+{
+    m_timer.stop();
+    if (m_renderer != nullptr) {
+        m_renderer->audioTap()->setEnabled(false);
+    }
+    QWidget::hideEvent(ev);
+}
+
+void ScopeWidget::refresh()
+{
+    if (m_renderer == nullptr) {
+        return;
+    }
+    AudioTap *tap = m_renderer->audioTap();
+    int channels = qMax(1, tap->channels());
+    if (channels != m_channels) {
+        m_channels = channels;
+        m_history.fill(0, SCOPE_FRAMES * m_channels);
+    }
+    int frames;
+    while ((frames = tap->read(m_chunk.data(), SCOPE_FRAMES)) > 0) {
+        int samples = frames * m_channels;
+        m_history.remove(0, samples);
+        m_history.append(m_chunk.mid(0, samples));
+    }
+    for (int ch = 0; ch < LevelMeter::MAX_CHANNELS; ++ch) {
+        m_peak[ch] = qMax(m_renderer->peakLevel(ch), m_peak[ch] * PEAK_DECAY);
+        m_rms[ch] = m_renderer->rmsLevel(ch);
+    }
+    update();
+}
+
+void ScopeWidget::paintEvent(QPaintEvent *ev)
+{
+    Q_UNUSED(ev)
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::black);
+
+    int meters = LevelMeter::MAX_CHANNELS * (METER_WIDTH + 2);
+    QRectF scope(0, 0, width() - meters - 2, height());
+    painter.setPen(Qt::darkGray);
+    painter.drawLine(QPointF(scope.left(), scope.center().y()), QPointF(scope.right(), scope.center().y()));
+
+    static const QColor colors[] = {Qt::green, Qt::yellow};
+    painter.setRenderHint(QPainter::Antialiasing);
+    for (int ch = 0; ch < m_channels; ++ch) {
+        QPainterPath path;
+        for (int i = 0; i < SCOPE_FRAMES; ++i) {
+            qreal x = scope.left() + scope.width() * i / (SCOPE_FRAMES - 1);
+            qreal y = scope.center().y() - scope.height() / 2 * m_history[i * m_channels + ch] / 32768.0;
+            if (i == 0) {
+                path.moveTo(x, y);
+            } else {
+                path.lineTo(x, y);
+            }
+        }
+        painter.setPen(colors[ch]);
+        painter.drawPath(path);
+    }
+    painter.setRenderHint(QPainter::Antialiasing, false);
+
+    for (int ch = 0; ch < LevelMeter::MAX_CHANNELS; ++ch) {
+        QRectF bar(width() - meters + ch * (METER_WIDTH + 2), 0, METER_WIDTH, height());
+        painter.fillRect(bar, Qt::darkGray);
+        qreal rms = bar.height() * meterFraction(m_rms[ch]);
+        painter.fillRect(QRectF(bar.left(), bar.bottom() - rms, bar.width(), rms), Qt::green);
+        qreal peak = bar.bottom() - bar.height() * meterFraction(m_peak[ch]);
+        painter.setPen(m_peak[ch] >= 0.999f ? Qt::red : Qt::white);
+        painter.drawLine(QPointF(bar.left(), peak), QPointF(bar.right(), peak));
+    }
+}
@@ -0,0 +1,55 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SCOPEWIDGET_H
+#define SCOPEWIDGET_H
+
+#include <QTimer>
+#include <QVector>
+#include <QWidget>
+#include "synthrenderer.h"
+
+class ScopeWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ScopeWidget(QWidget *parent = nullptr);
+    void setRenderer(SynthRenderer *renderer);
+    QSize sizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent *ev) override;
+    void showEvent(QShowEvent *ev) override;
+    void hideEvent(QHideEvent *ev) override;
+
+private slots:
+    void refresh();
+
+private:
+    SynthRenderer *m_renderer;
+    QTimer m_timer;
+    QVector<qint16> m_history;
+    QVector<qint16> m_chunk;
+    int m_channels;
+    float m_peak[LevelMeter::MAX_CHANNELS];
+    float m_rms[LevelMeter::MAX_CHANNELS];
+};
+
+#endif // SCOPEWIDGET_H
@@ -0,0 +1,111 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "audiotap.h"
+
+/* about 1.5 seconds of undecimated audio at 44100 Hz */
+static const int TAP_SAMPLES = 65536 * 2;
+
+AudioTap::AudioTap()
+    : m_enabled(false)
+    , m_decimation(1)
+    , m_sampleRate(0)
+    , m_channels(0)
+    , m_count(0)
+{
+    m_sum[0] = m_sum[1] = 0;
+    m_ring.resize(TAP_SAMPLES);
+}
+
+void AudioTap::reset(int sampleRate, int channels)
+{
+    m_sampleRate = sampleRate;
+    m_channels = qBound(1, channels, 2);
+    m_count = 0;
+    m_sum[0] = m_sum[1] = 0;
+}
+
+void AudioTap::write(const EAS_PCM *buffer, int frames)
+{
+    if (!m_enabled.load(std::memory_order_relaxed)) {
+        m_count = 0;
+        m_sum[0] = m_sum[1] = 0;
+        return;
+    }
+    int factor = m_decimation.load(std::memory_order_relaxed);
+    for (int i = 0; i < frames; ++i) {
+        for (int ch = 0; ch < m_channels; ++ch) {
+            m_sum[ch] += buffer[i * m_channels + ch];
+        }
+        if (++m_count >= factor) {
+            qint16 frame[2];
+            for (int ch = 0; ch < m_channels; ++ch) {
+                frame[ch] = qint16(m_sum[ch] / m_count);
+                m_sum[ch] = 0;
+            }
+            m_count = 0;
+            if (m_ring.writeAvailable() >= size_t(m_channels)) {
+                m_ring.write(frame, m_channels);
+            }
+        }
+    }
+}
+
+void AudioTap::setEnabled(bool enabled)
+{
+    if (!enabled) {
+        m_ring.clear();
+    }
+    m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool AudioTap::isEnabled() const
+{
+    return m_enabled.load(std::memory_order_relaxed);
+}
+
+void AudioTap::setDecimation(int factor)
+{
+    m_decimation.store(qMax(1, factor), std::memory_order_relaxed);
+}
+
+int AudioTap::decimation() const
+{
+    return m_decimation.load(std::memory_order_relaxed);
+}
+
+int AudioTap::sampleRate() const
+{
+    return m_sampleRate / decimation();
+}
+
+int AudioTap::channels() const
+{
+    return m_channels;
+}
+
+int AudioTap::read(qint16 *buffer, int frames)
+{
+    if (m_channels == 0) {
+        return 0;
+    }
+    size_t available = m_ring.readAvailable() / m_channels;
+    size_t count = qMin(size_t(frames), available);
+    return int(m_ring.read(buffer, count * m_channels) / m_channels);
+}
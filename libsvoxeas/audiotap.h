@@ -0,0 +1,62 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef AUDIOTAP_H
+#define AUDIOTAP_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <eas_types.h>
+#include "spscring.h"
+
+/*
+ * Optional copy of the rendered audio for visualizers. The render thread
+ * writes decimated frames into a lock-free ring, dropping them when the
+ * reader is late, and the consumer thread reads them at its own pace. The
+ * decimation averages consecutive frames, which is a crude low pass filter
+ * but good enough for scopes and spectrum views.
+ */
+class AudioTap
+{
+public:
+    AudioTap();
+
+    void reset(int sampleRate, int channels);
+    void write(const EAS_PCM *buffer, int frames);
+
+    /* consumer side */
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+    void setDecimation(int factor);
+    int decimation() const;
+    int sampleRate() const;
+    int channels() const;
+    int read(qint16 *buffer, int frames);
+
+private:
+    std::atomic<bool> m_enabled;
+    std::atomic<int> m_decimation;
+    int m_sampleRate;
+    int m_channels;
+    int m_count;
+    int m_sum[2];
+    SpscRing<qint16> m_ring;
+};
+
+#endif // AUDIOTAP_H
@@ -0,0 +1,370 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtDebug>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include "compactsong.h"
+#include "smfreader.h"
+
+/* compiled songs are written in the byte order of the host: a file from
+   another architecture fails the magic check and is compiled again */
+static const quint32 COMPILED_MAGIC = 0x31535653; /* "SVS1" */
+static const quint16 COMPILED_VERSION = 1;
+static const char *COMPILED_SUFFIX = ".svs";
+static const qint32 DEFAULT_TEMPO = 500000;
+/* time covered by each entry of the seek index, in microseconds */
+static const qint64 INDEX_INTERVAL = 1000000;
+/* longer songs are damaged files: the seek index would not fit in memory */
+static const qint64 MAX_DURATION = qint64(24) * 3600 * 1000000;
+
+struct CompiledHeader {
+    quint32 magic;
+    quint16 version;
+    quint16 eventSize;
+    qint64 sourceSize;
+    qint64 sourceModified;
+    quint32 events;
+    quint32 tempos;
+    quint32 sysex;
+    quint32 title;
+};
+
+static_assert(sizeof(CompactSong::Event) == 16, "CompactSong::Event must be 16 bytes");
+static_assert(sizeof(CompactSong::Tempo) == 16, "CompactSong::Tempo must be 16 bytes");
+
+CompactSong::CompactSong()
+{}
+
+/* reads the compiled song of this MIDI file, compiling it first if it is missing or stale and compileStale is set */
+bool
+CompactSong::load(const QString &fileName, bool compileStale)
+{
+    QFileInfo info(fileName);
+    if (!info.exists()) {
+        clear();
+        m_error = QStringLiteral("File not found");
+        return false;
+    }
+    if (readCompiled(compiledFileName(fileName), info.size(), info.lastModified().toMSecsSinceEpoch())) {
+        return true;
+    }
+    if (!compileStale) {
+        clear();
+        m_error = QStringLiteral("The song is not compiled");
+        return false;
+    }
+    return compile(fileName);
+}
+
+/* parses the MIDI file and stores the compiled song; it is usable even if storing fails */
+bool
+CompactSong::compile(const QString &fileName)
+{
+    SmfReader reader;
+    if (!reader.load(fileName)) {
+        clear();
+        m_error = reader.errorString();
+        return false;
+    }
+    build(reader);
+    QFileInfo info(fileName);
+    QString compiled = compiledFileName(fileName);
+    if (!writeCompiled(compiled, info.size(), info.lastModified().toMSecsSinceEpoch())) {
+        qWarning() << "Failed to store the compiled song" << compiled;
+    }
+    return true;
+}
+
+void
+CompactSong::build(const SmfReader &reader)
+{
+    clear();
+    m_events.reserve(reader.events().count());
+    for (const SmfReader::Event &source : reader.events()) {
+        const quint8 *message = reader.data(source);
+        Event event;
+        memset(&event, 0, sizeof(event));
+        event.time = source.time;
+        if (source.length <= 3 && message[0] >= 0x80 && message[0] < 0xf0) {
+            event.kind = ChannelMessage;
+            memcpy(event.bytes, message, size_t(source.length));
+        } else if (source.length <= 0xffff) {
+            event.kind = SystemExclusive;
+            event.offset = quint32(m_sysex.size());
+            m_sysex.append(reinterpret_cast<const char *>(message), source.length);
+        } else {
+            qWarning() << Q_FUNC_INFO << "dropping a system exclusive message of" << source.length << "bytes";
+            continue;
+        }
+        event.length = quint16(source.length);
+        m_events.append(event);
+    }
+    m_tempoMap.reserve(reader.tempoMap().count());
+    for (const SmfReader::Tempo &source : reader.tempoMap()) {
+        Tempo tempo = { source.time, source.tempo, 0 };
+        m_tempoMap.append(tempo);
+    }
+    m_title = reader.title();
+    buildIndex();
+}
+
+void
+CompactSong::clear()
+{
+    m_events.clear();
+    m_tempoMap.clear();
+    m_index.clear();
+    m_sysex.clear();
+    m_title.clear();
+    m_error.clear();
+}
+
+QString
+CompactSong::errorString() const
+{
+    return m_error;
+}
+
+QString
+CompactSong::compiledFileName(const QString &fileName)
+{
+    QByteArray path = QFileInfo(fileName).absoluteFilePath().toUtf8();
+    QByteArray digest = QCryptographicHash::hash(path, QCryptographicHash::Sha1).toHex();
+    return defaultDirectory() + QLatin1Char('/') + QString::fromLatin1(digest) + QLatin1String(COMPILED_SUFFIX);
+}
+
+QString
+CompactSong::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+           + QStringLiteral("/sonivoxeas/songs");
+}
+
+bool
+CompactSong::isEmpty() const
+{
+    return m_events.isEmpty();
+}
+
+int
+CompactSong::count() const
+{
+    return m_events.count();
+}
+
+const CompactSong::Event &
+CompactSong::event(int index) const
+{
+    return m_events.at(index);
+}
+
+/* the message bytes of an event of this song, length bytes long */
+const quint8 *
+CompactSong::data(const Event &event) const
+{
+    if (event.kind == SystemExclusive) {
+        return reinterpret_cast<const quint8 *>(m_sysex.constData()) + event.offset;
+    }
+    return event.bytes;
+}
+
+/* the index of the first event at or after this time, or count() past the end */
+int
+CompactSong::locate(qint64 time) const
+{
+    if (m_index.isEmpty() || time <= 0) {
+        return 0;
+    }
+    const int slot = int(qMin(time / INDEX_INTERVAL, qint64(m_index.count() - 1)));
+    const int first = m_index.at(slot);
+    const int last = slot + 1 < m_index.count() ? m_index.at(slot + 1) : m_events.count();
+    auto it = std::lower_bound(m_events.constBegin() + first, m_events.constBegin() + last, time,
+                               [](const Event &event, qint64 t) { return event.time < t; });
+    return int(it - m_events.constBegin());
+}
+
+const QVector<CompactSong::Tempo> &
+CompactSong::tempoMap() const
+{
+    return m_tempoMap;
+}
+
+/* microseconds per quarter note at this time of the song */
+qint32
+CompactSong::tempoAt(qint64 time) const
+{
+    auto it = std::upper_bound(m_tempoMap.constBegin(), m_tempoMap.constEnd(), time,
+                               [](qint64 t, const Tempo &tempo) { return t < tempo.time; });
+    return it == m_tempoMap.constBegin() ? DEFAULT_TEMPO : (it - 1)->tempo;
+}
+
+qint64
+CompactSong::duration() const
+{
+    return m_events.isEmpty() ? 0 : m_events.last().time;
+}
+
+QString
+CompactSong::title() const
+{
+    return m_title;
+}
+
+bool
+CompactSong::readCompiled(const QString &fileName, qint64 size, qint64 modified)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    CompiledHeader header;
+    if (file.read(reinterpret_cast<char *>(&header), sizeof(header)) != qint64(sizeof(header))
+            || header.magic != COMPILED_MAGIC || header.version != COMPILED_VERSION
+            || header.eventSize != sizeof(Event)) {
+        qWarning() << "Ignoring incompatible compiled song" << fileName;
+        return false;
+    }
+    if (header.sourceSize != size || header.sourceModified != modified) {
+        return false;
+    }
+    const qint64 expected = qint64(sizeof(header)) + qint64(header.events) * qint64(sizeof(Event))
+                            + qint64(header.tempos) * qint64(sizeof(Tempo)) + header.sysex + header.title;
+    if (file.size() != expected || header.events > INT_MAX / sizeof(Event)
+            || header.tempos > INT_MAX / sizeof(Tempo) || header.sysex > quint32(INT_MAX)
+            || header.title > quint32(INT_MAX)) {
+        qWarning() << "Ignoring truncated compiled song" << fileName;
+        return false;
+    }
+    clear();
+    m_events.resize(int(header.events));
+    m_tempoMap.resize(int(header.tempos));
+    m_sysex.resize(int(header.sysex));
+    QByteArray title(int(header.title), Qt::Uninitialized);
+    const qint64 eventBytes = qint64(header.events) * qint64(sizeof(Event));
+    const qint64 tempoBytes = qint64(header.tempos) * qint64(sizeof(Tempo));
+    if (file.read(reinterpret_cast<char *>(m_events.data()), eventBytes) != eventBytes
+            || file.read(reinterpret_cast<char *>(m_tempoMap.data()), tempoBytes) != tempoBytes
+            || file.read(m_sysex.data(), header.sysex) != header.sysex
+            || file.read(title.data(), header.title) != header.title) {
+        qWarning() << "Failed to read the compiled song" << fileName << file.errorString();
+        clear();
+        return false;
+    }
+    /* a damaged file is stale: the song is compiled again from the MIDI file */
+    if (!isConsistent()) {
+        qWarning() << "Ignoring damaged compiled song" << fileName;
+        clear();
+        return false;
+    }
+    m_title = QString::fromUtf8(title);
+    buildIndex();
+    return true;
+}
+
+/* every event and tempo change is in order, and every message is within its storage */
+bool
+CompactSong::isConsistent() const
+{
+    qint64 time = 0;
+    for (const Event &event : m_events) {
+        if (event.time < time) {
+            return false;
+        }
+        time = event.time;
+        if (time > MAX_DURATION) {
+            return false;
+        }
+        if (event.kind == ChannelMessage) {
+            if (event.length < 1 || event.length > 3 || event.bytes[0] < 0x80 || event.bytes[0] >= 0xf0) {
+                return false;
+            }
+        } else if (event.kind == SystemExclusive) {
+            if (event.length < 1 || qint64(event.offset) + event.length > m_sysex.size()) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    time = 0;
+    for (const Tempo &tempo : m_tempoMap) {
+        if (tempo.time < time || tempo.tempo <= 0) {
+            return false;
+        }
+        time = tempo.time;
+    }
+    return true;
+}
+
+bool
+CompactSong::writeCompiled(const QString &fileName, qint64 size, qint64 modified) const
+{
+    if (!QDir().mkpath(QFileInfo(fileName).absolutePath())) {
+        return false;
+    }
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QByteArray title = m_title.toUtf8();
+    CompiledHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = COMPILED_MAGIC;
+    header.version = COMPILED_VERSION;
+    header.eventSize = sizeof(Event);
+    header.sourceSize = size;
+    header.sourceModified = modified;
+    header.events = quint32(m_events.count());
+    header.tempos = quint32(m_tempoMap.count());
+    header.sysex = quint32(m_sysex.size());
+    header.title = quint32(title.size());
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(m_events.constData()), qint64(m_events.count()) * qint64(sizeof(Event)));
+    file.write(reinterpret_cast<const char *>(m_tempoMap.constData()), qint64(m_tempoMap.count()) * qint64(sizeof(Tempo)));
+    file.write(m_sysex);
+    file.write(title);
+    return file.commit();
+}
+
+/* entry n is the first event at or after n seconds, so a seek only searches one second of events */
+void
+CompactSong::buildIndex()
+{
+    m_index.clear();
+    const int slots = m_events.isEmpty() ? 0 : int(duration() / INDEX_INTERVAL) + 1;
+    m_index.reserve(slots);
+    int i = 0;
+    for (int slot = 0; slot < slots; ++slot) {
+        const qint64 start = qint64(slot) * INDEX_INTERVAL;
+        while (i < m_events.count() && m_events.at(i).time < start) {
+            ++i;
+        }
+        m_index.append(i);
+    }
+}
@@ -0,0 +1,98 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef COMPACTSONG_H
+#define COMPACTSONG_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+class SmfReader;
+
+/*
+ * A MIDI file compiled for playback: the events of all the tracks merged
+ * into one time sorted array of fixed size records, so a player takes the
+ * next event at constant cost, and finds any position with a lookup in a
+ * coarse time index followed by a binary search. Channel messages are
+ * stored in the record itself, system exclusive messages in a separate
+ * blob. Compiled songs are kept in the cache directory and compiled again
+ * when the MIDI file changes.
+ */
+class CompactSong
+{
+public:
+    enum Kind {
+        ChannelMessage,
+        SystemExclusive
+    };
+
+    struct Event {
+        qint64 time;  /* microseconds from the start of the song */
+        union {
+            quint8 bytes[4];  /* a channel message */
+            quint32 offset;   /* a system exclusive message, in the sysex blob */
+        };
+        quint16 length;
+        quint8 kind;
+        quint8 reserved;
+    };
+
+    struct Tempo {
+        qint64 time;   /* microseconds from the start of the song */
+        qint32 tempo;  /* microseconds per quarter note */
+        qint32 reserved;
+    };
+
+    CompactSong();
+
+    bool load(const QString &fileName, bool compileStale = true);
+    bool compile(const QString &fileName);
+    void build(const SmfReader &reader);
+    void clear();
+    QString errorString() const;
+    static QString compiledFileName(const QString &fileName);
+    static QString defaultDirectory();
+
+    bool isEmpty() const;
+    int count() const;
+    const Event &event(int index) const;
+    const quint8 *data(const Event &event) const;
+    int locate(qint64 time) const;
+    const QVector<Tempo> &tempoMap() const;
+    qint32 tempoAt(qint64 time) const;
+    qint64 duration() const;
+    QString title() const;
+
+private:
+    bool readCompiled(const QString &fileName, qint64 size, qint64 modified);
+    bool writeCompiled(const QString &fileName, qint64 size, qint64 modified) const;
+    void buildIndex();
+    bool isConsistent() const;
+
+    QVector<Event> m_events;
+    QVector<Tempo> m_tempoMap;
+    QVector<int> m_index;
+    QByteArray m_sysex;
+    QString m_title;
+    QString m_error;
+};
+
+#endif // COMPACTSONG_H
@@ -0,0 +1,163 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CONTROLQUEUE_H
+#define CONTROLQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/*
+ * Bounded lock-free queue after Dmitry Vyukov's design. Any number of threads
+ * may push, one thread pops. Each cell carries a sequence number telling
+ * whether it is free for the next producer lap or holds data for the
+ * consumer, so no operation ever blocks; push() fails when the queue is full.
+ */
+template<typename T>
+class MpscQueue
+{
+public:
+    explicit MpscQueue(size_t capacity)
+        : m_enqueuePos(0)
+        , m_dequeuePos(0)
+    {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        m_mask = size - 1;
+        m_cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(const T &value)
+    {
+        Cell *cell;
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = std::ptrdiff_t(seq) - std::ptrdiff_t(pos);
+            if (diff == 0) {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &value)
+    {
+        size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        Cell *cell = &m_cells[pos & m_mask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        if (std::ptrdiff_t(seq) - std::ptrdiff_t(pos + 1) < 0) {
+            return false;
+        }
+        m_dequeuePos.store(pos + 1, std::memory_order_relaxed);
+        value = cell->data;
+        cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    struct Cell {
+        Cell() : sequence(0), data() {}
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask;
+    std::atomic<size_t> m_enqueuePos;
+    std::atomic<size_t> m_dequeuePos;
+};
+
+/*
+ * Integer parameters changed from any thread and applied by the render
+ * thread at block boundaries. set() stores the latest value and queues the
+ * parameter only when it is not already pending, so a burst of changes to
+ * the same parameter costs one queue slot and the render thread applies just
+ * the most recent value. Different parameters are applied in the order they
+ * were first changed.
+ */
+class ControlQueue
+{
+public:
+    explicit ControlQueue(int parameters)
+        : m_queue(parameters)
+        , m_values(parameters)
+        , m_pending(parameters)
+    {
+        for (int i = 0; i < parameters; ++i) {
+            m_values[i].store(0, std::memory_order_relaxed);
+            m_pending[i].store(false, std::memory_order_relaxed);
+        }
+    }
+
+    /* sets the value without notifying the render thread */
+    void init(int parameter, int value)
+    {
+        m_values[parameter].store(value, std::memory_order_relaxed);
+    }
+
+    void set(int parameter, int value)
+    {
+        m_values[parameter].store(value, std::memory_order_release);
+        if (!m_pending[parameter].exchange(true, std::memory_order_acq_rel)) {
+            /* at most one slot per parameter is in use, so this never fails */
+            m_queue.push(parameter);
+        }
+    }
+
+    int value(int parameter) const
+    {
+        return m_values[parameter].load(std::memory_order_acquire);
+    }
+
+    /* render thread only */
+    bool next(int &parameter, int &value)
+    {
+        if (!m_queue.pop(parameter)) {
+            return false;
+        }
+        /* cleared before reading, so a concurrent set() queues the parameter again */
+        m_pending[parameter].exchange(false, std::memory_order_acq_rel);
+        value = m_values[parameter].load(std::memory_order_acquire);
+        return true;
+    }
+
+private:
+    MpscQueue<int> m_queue;
+    std::vector<std::atomic<int> > m_values;
+    std::vector<std::atomic<bool> > m_pending;
+};
+
+#endif // CONTROLQUEUE_H
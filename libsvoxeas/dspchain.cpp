@@ -0,0 +1,139 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "dspchain.h"
+#include "dspstages.h"
+#include "tracer.h"
+
+DspChain::DspChain()
+    : m_parameters(ParameterCount)
+    , m_sampleRate(0)
+    , m_channels(0)
+    , m_blockSize(0)
+    , m_active(false)
+{
+    m_stages << new HighPassStage << new EqualizerStage << new LimiterStage;
+}
+
+DspChain::~DspChain()
+{
+    qDeleteAll(m_stages);
+}
+
+/* must be called before the render thread starts */
+void
+DspChain::setup(int sampleRate, int channels, int blockSize)
+{
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+    m_blockSize = blockSize;
+    m_buffer.resize(blockSize * channels);
+    for (DspStage *stage : m_stages) {
+        stage->setup(sampleRate, channels);
+    }
+    for (int parameter = 0; parameter < ParameterCount; ++parameter) {
+        dispatch(parameter, m_parameters.value(parameter));
+    }
+    updateActive();
+}
+
+/* takes ownership of the stage, which runs after the existing ones */
+void
+DspChain::addStage(DspStage *stage)
+{
+    if (m_sampleRate > 0) {
+        stage->setup(m_sampleRate, m_channels);
+    }
+    m_stages.append(stage);
+}
+
+void
+DspChain::setParameter(Parameter parameter, int value)
+{
+    m_parameters.set(parameter, value);
+}
+
+int
+DspChain::parameter(Parameter parameter) const
+{
+    return m_parameters.value(parameter);
+}
+
+void
+DspChain::dispatch(int parameter, int value)
+{
+    for (DspStage *stage : m_stages) {
+        if (stage->setParameter(parameter, value)) {
+            break;
+        }
+    }
+}
+
+void
+DspChain::updateActive()
+{
+    m_active = false;
+    for (DspStage *stage : m_stages) {
+        m_active = m_active || stage->isActive();
+    }
+}
+
+void
+DspChain::applyParameters()
+{
+    int parameter, value;
+    bool changed = false;
+    while (m_parameters.next(parameter, value)) {
+        dispatch(parameter, value);
+        changed = true;
+    }
+    if (changed) {
+        updateActive();
+    }
+}
+
+void
+DspChain::process(EAS_PCM *buffer, int frames)
+{
+    applyParameters();
+    if (!m_active || m_blockSize == 0) {
+        return;
+    }
+    TRACE_SCOPE("DspChain::process");
+    const float toFloat = 1.0f / 32768.0f;
+    while (frames > 0) {
+        const int count = qMin(frames, m_blockSize);
+        const int samples = count * m_channels;
+        float *data = m_buffer.data();
+        for (int i = 0; i < samples; ++i) {
+            data[i] = buffer[i] * toFloat;
+        }
+        for (DspStage *stage : m_stages) {
+            if (stage->isActive()) {
+                stage->process(data, count);
+            }
+        }
+        for (int i = 0; i < samples; ++i) {
+            int sample = qRound(data[i] * 32768.0f);
+            buffer[i] = EAS_PCM(qBound(-32768, sample, 32767));
+        }
+        buffer += samples;
+        frames -= count;
+    }
+}
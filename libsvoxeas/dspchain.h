@@ -0,0 +1,88 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DSPCHAIN_H
+#define DSPCHAIN_H
+
+#include <QVector>
+#include "controlqueue.h"
+#include "eas.h"
+
+/*
+ * A processing stage of the DspChain. Stages work in place on interleaved
+ * float samples in the -1..1 range, one rendered block at a time, and must
+ * not allocate memory in process(). setParameter() is called on the render
+ * thread with every parameter of the chain, and returns true for its own.
+ */
+class DspStage
+{
+public:
+    virtual ~DspStage() {}
+
+    virtual void setup(int sampleRate, int channels) = 0;
+    virtual bool setParameter(int parameter, int value) = 0;
+    virtual bool isActive() const = 0;
+    virtual void process(float *buffer, int frames) = 0;
+};
+
+/*
+ * Post processing of the synthesizer output in the render thread. The
+ * parameters may be changed from any thread, and are applied at the start
+ * of the next block. When no stage is active the samples are not touched.
+ */
+class DspChain
+{
+public:
+    enum Parameter {
+        HighPassFrequency = 0,  /* Hz, 0 disables the filter */
+        LowShelfGain,           /* dB */
+        PeakGain,               /* dB */
+        HighShelfGain,          /* dB */
+        LimiterThreshold,       /* dBFS, 0 disables the limiter */
+        ParameterCount
+    };
+
+    DspChain();
+    ~DspChain();
+
+    void setup(int sampleRate, int channels, int blockSize);
+    void addStage(DspStage *stage);
+
+    void setParameter(Parameter parameter, int value);
+    int parameter(Parameter parameter) const;
+
+    void process(EAS_PCM *buffer, int frames);
+
+private:
+    Q_DISABLE_COPY(DspChain)
+
+    void dispatch(int parameter, int value);
+    void updateActive();
+    void applyParameters();
+
+    QVector<DspStage*> m_stages;
+    ControlQueue m_parameters;
+    QVector<float> m_buffer;
+    int m_sampleRate;
+    int m_channels;
+    int m_blockSize;
+    bool m_active;
+};
+
+#endif // DSPCHAIN_H
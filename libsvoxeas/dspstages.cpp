@@ -0,0 +1,342 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QtGlobal>
+#include <cmath>
+#include <cstring>
+
+#include "dspstages.h"
+
+/* Butterworth response for the high pass filter */
+static const double HIGHPASS_Q = 0.7071;
+/* equalizer band frequencies in Hz */
+static const double EQ_LOW_FREQUENCY = 200.0;
+static const double EQ_MID_FREQUENCY = 1000.0;
+static const double EQ_MID_Q = 1.0;
+static const double EQ_HIGH_FREQUENCY = 5000.0;
+static const int EQ_MAX_GAIN = 24;
+/* limiter release time in seconds */
+static const double LIMITER_RELEASE_TIME = 0.1;
+/* filter states below this are flushed, denormals are very slow on x86 */
+static const float DENORMAL_LIMIT = 1e-20f;
+
+static inline DspVector
+broadcast(float value)
+{
+    DspVector v = { value, value, value, value };
+    return v;
+}
+
+Biquad::Biquad()
+{
+    setIdentity();
+    reset();
+}
+
+void
+Biquad::setIdentity()
+{
+    setCoefficients(1.0, 0.0, 0.0, 1.0, 0.0, 0.0);
+}
+
+void
+Biquad::setHighPass(int sampleRate, double frequency, double q)
+{
+    const double w0 = 2.0 * M_PI * frequency / sampleRate;
+    const double cosw0 = std::cos(w0);
+    const double alpha = std::sin(w0) / (2.0 * q);
+    setCoefficients((1.0 + cosw0) / 2.0, -(1.0 + cosw0), (1.0 + cosw0) / 2.0,
+                    1.0 + alpha, -2.0 * cosw0, 1.0 - alpha);
+}
+
+void
+Biquad::setLowShelf(int sampleRate, double frequency, double gain)
+{
+    const double A = std::pow(10.0, gain / 40.0);
+    const double w0 = 2.0 * M_PI * frequency / sampleRate;
+    const double cosw0 = std::cos(w0);
+    const double beta = 2.0 * std::sqrt(A) * std::sin(w0) / 2.0 * M_SQRT2;
+    setCoefficients(A * ((A + 1.0) - (A - 1.0) * cosw0 + beta),
+                    2.0 * A * ((A - 1.0) - (A + 1.0) * cosw0),
+                    A * ((A + 1.0) - (A - 1.0) * cosw0 - beta),
+                    (A + 1.0) + (A - 1.0) * cosw0 + beta,
+                    -2.0 * ((A - 1.0) + (A + 1.0) * cosw0),
+                    (A + 1.0) + (A - 1.0) * cosw0 - beta);
+}
+
+void
+Biquad::setPeak(int sampleRate, double frequency, double q, double gain)
+{
+    const double A = std::pow(10.0, gain / 40.0);
+    const double w0 = 2.0 * M_PI * frequency / sampleRate;
+    const double cosw0 = std::cos(w0);
+    const double alpha = std::sin(w0) / (2.0 * q);
+    setCoefficients(1.0 + alpha * A, -2.0 * cosw0, 1.0 - alpha * A,
+                    1.0 + alpha / A, -2.0 * cosw0, 1.0 - alpha / A);
+}
+
+void
+Biquad::setHighShelf(int sampleRate, double frequency, double gain)
+{
+    const double A = std::pow(10.0, gain / 40.0);
+    const double w0 = 2.0 * M_PI * frequency / sampleRate;
+    const double cosw0 = std::cos(w0);
+    const double beta = 2.0 * std::sqrt(A) * std::sin(w0) / 2.0 * M_SQRT2;
+    setCoefficients(A * ((A + 1.0) + (A - 1.0) * cosw0 + beta),
+                    -2.0 * A * ((A - 1.0) + (A + 1.0) * cosw0),
+                    A * ((A + 1.0) + (A - 1.0) * cosw0 - beta),
+                    (A + 1.0) - (A - 1.0) * cosw0 + beta,
+                    2.0 * ((A - 1.0) - (A + 1.0) * cosw0),
+                    (A + 1.0) - (A - 1.0) * cosw0 - beta);
+}
+
+void
+Biquad::setCoefficients(double b0, double b1, double b2, double a0, double a1, double a2)
+{
+    m_b0 = float(b0 / a0);
+    m_b1 = float(b1 / a0);
+    m_b2 = float(b2 / a0);
+    m_a1 = float(a1 / a0);
+    m_a2 = float(a2 / a0);
+}
+
+void
+Biquad::reset()
+{
+    std::memset(m_z1, 0, sizeof(m_z1));
+    std::memset(m_z2, 0, sizeof(m_z2));
+}
+
+void
+Biquad::process(float *buffer, int frames, int channels)
+{
+    const size_t frameBytes = sizeof(float) * channels;
+    const DspVector b0 = broadcast(m_b0);
+    const DspVector b1 = broadcast(m_b1);
+    const DspVector b2 = broadcast(m_b2);
+    const DspVector a1 = broadcast(m_a1);
+    const DspVector a2 = broadcast(m_a2);
+    DspVector z1, z2;
+    std::memcpy(&z1, m_z1, sizeof(z1));
+    std::memcpy(&z2, m_z2, sizeof(z2));
+    for (int i = 0; i < frames; ++i, buffer += channels) {
+        DspVector x = broadcast(0.0f);
+        std::memcpy(&x, buffer, frameBytes);
+        const DspVector y = b0 * x + z1;
+        z1 = b1 * x - a1 * y + z2;
+        z2 = b2 * x - a2 * y;
+        std::memcpy(buffer, &y, frameBytes);
+    }
+    std::memcpy(m_z1, &z1, sizeof(z1));
+    std::memcpy(m_z2, &z2, sizeof(z2));
+    for (int c = 0; c < DSP_MAX_CHANNELS; ++c) {
+        if (std::fabs(m_z1[c]) < DENORMAL_LIMIT) {
+            m_z1[c] = 0.0f;
+        }
+        if (std::fabs(m_z2[c]) < DENORMAL_LIMIT) {
+            m_z2[c] = 0.0f;
+        }
+    }
+}
+
+HighPassStage::HighPassStage()
+    : m_sampleRate(0)
+    , m_channels(0)
+    , m_frequency(0)
+{
+}
+
+void
+HighPassStage::setup(int sampleRate, int channels)
+{
+    m_sampleRate = sampleRate;
+    m_channels = qMin(channels, DSP_MAX_CHANNELS);
+    update();
+    m_filter.reset();
+}
+
+bool
+HighPassStage::setParameter(int parameter, int value)
+{
+    if (parameter != DspChain::HighPassFrequency) {
+        return false;
+    }
+    if (m_frequency == 0) {
+        m_filter.reset();
+    }
+    m_frequency = qMax(0, value);
+    update();
+    return true;
+}
+
+bool
+HighPassStage::isActive() const
+{
+    return m_frequency > 0 && m_sampleRate > 0;
+}
+
+void
+HighPassStage::update()
+{
+    if (isActive()) {
+        m_filter.setHighPass(m_sampleRate, qMin(m_frequency, m_sampleRate / 4), HIGHPASS_Q);
+    }
+}
+
+void
+HighPassStage::process(float *buffer, int frames)
+{
+    m_filter.process(buffer, frames, m_channels);
+}
+
+EqualizerStage::EqualizerStage()
+    : m_sampleRate(0)
+    , m_channels(0)
+{
+    for (int band = 0; band < BandCount; ++band) {
+        m_gains[band] = 0;
+    }
+}
+
+void
+EqualizerStage::setup(int sampleRate, int channels)
+{
+    m_sampleRate = sampleRate;
+    m_channels = qMin(channels, DSP_MAX_CHANNELS);
+    for (int band = 0; band < BandCount; ++band) {
+        update(band);
+        m_bands[band].reset();
+    }
+}
+
+bool
+EqualizerStage::setParameter(int parameter, int value)
+{
+    int band;
+    switch (parameter) {
+    case DspChain::LowShelfGain:
+        band = LowBand;
+        break;
+    case DspChain::PeakGain:
+        band = MidBand;
+        break;
+    case DspChain::HighShelfGain:
+        band = HighBand;
+        break;
+    default:
+        return false;
+    }
+    if (m_gains[band] == 0) {
+        m_bands[band].reset();
+    }
+    m_gains[band] = qBound(-EQ_MAX_GAIN, value, EQ_MAX_GAIN);
+    update(band);
+    return true;
+}
+
+bool
+EqualizerStage::isActive() const
+{
+    return m_sampleRate > 0 && (m_gains[LowBand] != 0 || m_gains[MidBand] != 0 || m_gains[HighBand] != 0);
+}
+
+void
+EqualizerStage::update(int band)
+{
+    if (m_sampleRate == 0) {
+        return;
+    }
+    switch (band) {
+    case LowBand:
+        m_bands[band].setLowShelf(m_sampleRate, EQ_LOW_FREQUENCY, m_gains[band]);
+        break;
+    case MidBand:
+        m_bands[band].setPeak(m_sampleRate, EQ_MID_FREQUENCY, EQ_MID_Q, m_gains[band]);
+        break;
+    case HighBand:
+        m_bands[band].setHighShelf(m_sampleRate, qMin(EQ_HIGH_FREQUENCY, m_sampleRate / 4.0), m_gains[band]);
+        break;
+    }
+}
+
+void
+EqualizerStage::process(float *buffer, int frames)
+{
+    for (int band = 0; band < BandCount; ++band) {
+        if (m_gains[band] != 0) {
+            m_bands[band].process(buffer, frames, m_channels);
+        }
+    }
+}
+
+LimiterStage::LimiterStage()
+    : m_channels(0)
+    , m_thresholdDb(0)
+    , m_threshold(1.0f)
+    , m_release(0.0f)
+    , m_gain(1.0f)
+{
+}
+
+void
+LimiterStage::setup(int sampleRate, int channels)
+{
+    m_channels = qMin(channels, DSP_MAX_CHANNELS);
+    m_release = float(std::exp(-1.0 / (LIMITER_RELEASE_TIME * sampleRate)));
+    m_gain = 1.0f;
+}
+
+bool
+LimiterStage::setParameter(int parameter, int value)
+{
+    if (parameter != DspChain::LimiterThreshold) {
+        return false;
+    }
+    m_thresholdDb = qMin(0, value);
+    m_threshold = float(std::pow(10.0, m_thresholdDb / 20.0));
+    return true;
+}
+
+bool
+LimiterStage::isActive() const
+{
+    return m_thresholdDb < 0 && m_channels > 0;
+}
+
+void
+LimiterStage::process(float *buffer, int frames)
+{
+    const size_t frameBytes = sizeof(float) * m_channels;
+    const DspVector zero = broadcast(0.0f);
+    float gain = m_gain;
+    for (int i = 0; i < frames; ++i, buffer += m_channels) {
+        DspVector x = zero;
+        std::memcpy(&x, buffer, frameBytes);
+        const DspVector magnitude = x < zero ? -x : x;
+        float peak = magnitude[0];
+        for (int c = 1; c < m_channels; ++c) {
+            peak = qMax(peak, float(magnitude[c]));
+        }
+        const float target = peak > m_threshold ? m_threshold / peak : 1.0f;
+        gain = target < gain ? target : target + (gain - target) * m_release;
+        x *= broadcast(gain);
+        std::memcpy(buffer, &x, frameBytes);
+    }
+    m_gain = gain;
+}
@@ -0,0 +1,119 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DSPSTAGES_H
+#define DSPSTAGES_H
+
+#include "dspchain.h"
+
+/* one lane per channel, so that all the channels of a frame are filtered at once */
+typedef float DspVector __attribute__((vector_size(16)));
+static const int DSP_MAX_CHANNELS = 4;
+
+/*
+ * Second order section in transposed direct form II, with the coefficients
+ * of the Audio EQ Cookbook (R. Bristow-Johnson).
+ */
+class Biquad
+{
+public:
+    Biquad();
+
+    void setIdentity();
+    void setHighPass(int sampleRate, double frequency, double q);
+    void setLowShelf(int sampleRate, double frequency, double gain);
+    void setPeak(int sampleRate, double frequency, double q, double gain);
+    void setHighShelf(int sampleRate, double frequency, double gain);
+    void reset();
+
+    void process(float *buffer, int frames, int channels);
+
+private:
+    void setCoefficients(double b0, double b1, double b2, double a0, double a1, double a2);
+
+    float m_b0, m_b1, m_b2, m_a1, m_a2;
+    float m_z1[DSP_MAX_CHANNELS];
+    float m_z2[DSP_MAX_CHANNELS];
+};
+
+/* removes rumble and DC below the DspChain::HighPassFrequency */
+class HighPassStage : public DspStage
+{
+public:
+    HighPassStage();
+
+    void setup(int sampleRate, int channels) override;
+    bool setParameter(int parameter, int value) override;
+    bool isActive() const override;
+    void process(float *buffer, int frames) override;
+
+private:
+    void update();
+
+    Biquad m_filter;
+    int m_sampleRate;
+    int m_channels;
+    int m_frequency;
+};
+
+/* low shelf, mid peak and high shelf bands at fixed frequencies */
+class EqualizerStage : public DspStage
+{
+public:
+    EqualizerStage();
+
+    void setup(int sampleRate, int channels) override;
+    bool setParameter(int parameter, int value) override;
+    bool isActive() const override;
+    void process(float *buffer, int frames) override;
+
+private:
+    enum Band { LowBand = 0, MidBand, HighBand, BandCount };
+
+    void update(int band);
+
+    Biquad m_bands[BandCount];
+    int m_gains[BandCount];
+    int m_sampleRate;
+    int m_channels;
+};
+
+/*
+ * Peak limiter without look ahead: the gain drops at once when a frame
+ * exceeds the threshold, and recovers with an exponential release.
+ */
+class LimiterStage : public DspStage
+{
+public:
+    LimiterStage();
+
+    void setup(int sampleRate, int channels) override;
+    bool setParameter(int parameter, int value) override;
+    bool isActive() const override;
+    void process(float *buffer, int frames) override;
+
+private:
+    int m_channels;
+    int m_thresholdDb;
+    float m_threshold;
+    float m_release;
+    float m_gain;
+};
+
+#endif // DSPSTAGES_H
@@ -0,0 +1,272 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cstdlib>
+#include <cstring>
+
+#include "easarena.h"
+#include "eas_types.h"
+
+/* the smallest block, and the largest one kept in a power of two free list */
+static const size_t MIN_BLOCK_SIZE = 32;
+static const size_t MAX_SMALL_BLOCK_SIZE = MIN_BLOCK_SIZE << 11;
+
+static thread_local EasArena *t_currentArena = nullptr;
+
+EasArena::EasArena()
+    : m_storage(nullptr)
+    , m_capacity(0)
+    , m_top(0)
+    , m_large(nullptr)
+    , m_inUse(0)
+    , m_peak(0)
+    , m_blocks(0)
+    , m_overflows(0)
+{
+    std::memset(m_free, 0, sizeof(m_free));
+}
+
+EasArena::~EasArena()
+{
+    release();
+}
+
+/* grows the storage, only possible while no block is allocated */
+bool
+EasArena::reserve(size_t bytes)
+{
+    bytes = (bytes + 15) & ~size_t(15);
+    if (bytes <= m_capacity) {
+        return true;
+    }
+    if (m_blocks > 0) {
+        return false;
+    }
+    release();
+    m_storage = static_cast<char *>(std::malloc(bytes));
+    if (m_storage == nullptr) {
+        return false;
+    }
+    /* fault the pages in now rather than on the first render */
+    std::memset(m_storage, 0, bytes);
+    m_capacity = bytes;
+    m_peak = 0;
+    m_overflows = 0;
+    rewind();
+    return true;
+}
+
+void
+EasArena::release()
+{
+    if (m_blocks > 0) {
+        return;
+    }
+    std::free(m_storage);
+    m_storage = nullptr;
+    m_capacity = 0;
+    rewind();
+}
+
+size_t
+EasArena::capacity() const
+{
+    return m_capacity;
+}
+
+size_t
+EasArena::bytesInUse() const
+{
+    return m_inUse;
+}
+
+size_t
+EasArena::peakBytes() const
+{
+    return m_peak;
+}
+
+int
+EasArena::blocks() const
+{
+    return m_blocks;
+}
+
+int
+EasArena::overflows() const
+{
+    return m_overflows;
+}
+
+void *
+EasArena::allocate(size_t size)
+{
+    size_t blockSize = size + sizeof(Header);
+    int sizeClass = -1;
+    if (blockSize <= MAX_SMALL_BLOCK_SIZE) {
+        sizeClass = 0;
+        size_t classSize = MIN_BLOCK_SIZE;
+        while (classSize < blockSize) {
+            classSize <<= 1;
+            ++sizeClass;
+        }
+        blockSize = classSize;
+    } else {
+        blockSize = (blockSize + 15) & ~size_t(15);
+    }
+
+    Header *block = nullptr;
+    if (sizeClass >= 0) {
+        block = m_free[sizeClass];
+        if (block != nullptr) {
+            m_free[sizeClass] = nextFree(block);
+        }
+    } else {
+        /* large blocks are few, first fit without splitting */
+        Header **link = &m_large;
+        while (*link != nullptr && (*link)->size < blockSize) {
+            link = &nextFree(*link);
+        }
+        block = *link;
+        if (block != nullptr) {
+            *link = nextFree(block);
+            blockSize = block->size;
+        }
+    }
+    if (block == nullptr) {
+        if (m_capacity - m_top < blockSize) {
+            return nullptr;
+        }
+        block = reinterpret_cast<Header *>(m_storage + m_top);
+        m_top += blockSize;
+    }
+    block->owner = this;
+    block->size = blockSize;
+    m_inUse += blockSize;
+    m_peak = qMax(m_peak, m_inUse);
+    ++m_blocks;
+    return block + 1;
+}
+
+void
+EasArena::free(Header *block)
+{
+    m_inUse -= block->size;
+    if (--m_blocks == 0) {
+        rewind();
+        return;
+    }
+    if (block->size <= MAX_SMALL_BLOCK_SIZE) {
+        int sizeClass = 0;
+        for (size_t classSize = MIN_BLOCK_SIZE; classSize < block->size; classSize <<= 1) {
+            ++sizeClass;
+        }
+        nextFree(block) = m_free[sizeClass];
+        m_free[sizeClass] = block;
+    } else {
+        nextFree(block) = m_large;
+        m_large = block;
+    }
+}
+
+/* a free block keeps the link to the next one in its payload */
+EasArena::Header *&
+EasArena::nextFree(Header *block)
+{
+    return *reinterpret_cast<Header **>(block + 1);
+}
+
+void
+EasArena::rewind()
+{
+    m_top = 0;
+    m_inUse = 0;
+    std::memset(m_free, 0, sizeof(m_free));
+    m_large = nullptr;
+}
+
+void *
+EasArena::allocateCurrent(size_t size)
+{
+    EasArena *arena = t_currentArena;
+    if (arena != nullptr) {
+        void *p = arena->allocate(size);
+        if (p != nullptr) {
+            return p;
+        }
+        ++arena->m_overflows;
+    }
+    Header *block = static_cast<Header *>(std::malloc(size + sizeof(Header)));
+    if (block == nullptr) {
+        return nullptr;
+    }
+    block->owner = nullptr;
+    block->size = size + sizeof(Header);
+    return block + 1;
+}
+
+void
+EasArena::deallocate(void *p)
+{
+    if (p == nullptr) {
+        return;
+    }
+    Header *block = static_cast<Header *>(p) - 1;
+    if (block->owner == nullptr) {
+        std::free(block);
+    } else {
+        block->owner->free(block);
+    }
+}
+
+EasArena::Scope::Scope(EasArena *arena)
+    : m_previous(t_currentArena)
+{
+    t_currentArena = arena;
+}
+
+EasArena::Scope::~Scope()
+{
+    t_currentArena = m_previous;
+}
+
+#ifdef SVOXEAS_ARENA
+/*
+ * Replacements for the host memory functions of sonivox (host_src/eas_host.h).
+ * They take effect when the library exports these symbols, so that the
+ * dynamic linker binds its own calls to the first definition it finds.
+ */
+extern "C" {
+
+void *
+EAS_HWMalloc(void *hwInstData, EAS_I32 size)
+{
+    Q_UNUSED(hwInstData)
+    return EasArena::allocateCurrent(size_t(size));
+}
+
+void
+EAS_HWFree(void *hwInstData, void *p)
+{
+    Q_UNUSED(hwInstData)
+    EasArena::deallocate(p);
+}
+
+}
+#endif
@@ -0,0 +1,92 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef EASARENA_H
+#define EASARENA_H
+
+#include <QtGlobal>
+#include <cstddef>
+
+/*
+ * Preallocated memory for one EAS instance. When the library is built with
+ * SVOXEAS_ARENA it replaces the EAS host memory functions, and allocations
+ * made while a Scope is active on the calling thread are served from the
+ * arena of that scope. Blocks are recycled through power of two free lists,
+ * and the whole arena rewinds when its last block is freed, so an engine can
+ * be shut down and initialized again without calling the system allocator.
+ * Requests that do not fit fall back to malloc and are counted as overflows.
+ * An arena must not be used by two threads at the same time.
+ */
+class EasArena
+{
+public:
+    EasArena();
+    ~EasArena();
+
+    bool reserve(size_t bytes);
+    void release();
+
+    size_t capacity() const;
+    size_t bytesInUse() const;
+    size_t peakBytes() const;
+    int blocks() const;
+    int overflows() const;
+
+    void *allocate(size_t size);
+
+    static void *allocateCurrent(size_t size);
+    static void deallocate(void *p);
+
+    class Scope
+    {
+    public:
+        explicit Scope(EasArena *arena);
+        ~Scope();
+
+    private:
+        Q_DISABLE_COPY(Scope)
+        EasArena *m_previous;
+    };
+
+private:
+    Q_DISABLE_COPY(EasArena)
+
+    struct alignas(16) Header {
+        EasArena *owner;
+        size_t size;
+    };
+
+    static const int SIZE_CLASSES = 12;
+
+    static Header *&nextFree(Header *block);
+    void free(Header *block);
+    void rewind();
+
+    char *m_storage;
+    size_t m_capacity;
+    size_t m_top;
+    Header *m_free[SIZE_CLASSES];
+    Header *m_large;
+    size_t m_inUse;
+    size_t m_peak;
+    int m_blocks;
+    int m_overflows;
+};
+
+#endif // EASARENA_H
@@ -0,0 +1,93 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "enginecontrols.h"
+
+EngineControls::EngineControls()
+    : m_controls(ControlCount)
+{
+}
+
+void
+EngineControls::setup(SynthEngine &engine)
+{
+    m_reverbWet.setup(engine.sampleRate(), engine.bufferSize());
+    m_chorusLevel.setup(engine.sampleRate(), engine.bufferSize());
+    m_reverbWet.reset(engine.reverbWet());
+    m_chorusLevel.reset(engine.chorusLevel());
+}
+
+void
+EngineControls::initReverb(int reverb_type)
+{
+    m_controls.set(ReverbTypeControl, reverb_type);
+}
+
+void
+EngineControls::setReverbWet(int amount)
+{
+    m_controls.set(ReverbWetControl, amount);
+}
+
+void
+EngineControls::initChorus(int chorus_type)
+{
+    m_controls.set(ChorusTypeControl, chorus_type);
+}
+
+void
+EngineControls::setChorusLevel(int amount)
+{
+    m_controls.set(ChorusLevelControl, amount);
+}
+
+void
+EngineControls::apply(SynthEngine &engine)
+{
+    int parameter, value;
+    while (m_controls.next(parameter, value)) {
+        switch (parameter) {
+        case ReverbTypeControl:
+            engine.initReverb(value);
+            /* like the live engine, the level starts from the preset level */
+            if (value >= 0) {
+                m_reverbWet.reset(engine.reverbWet());
+            }
+            break;
+        case ReverbWetControl:
+            m_reverbWet.setTarget(value);
+            break;
+        case ChorusTypeControl:
+            engine.initChorus(value);
+            if (value >= 0) {
+                m_chorusLevel.reset(engine.chorusLevel());
+            }
+            break;
+        case ChorusLevelControl:
+            m_chorusLevel.setTarget(value);
+            break;
+        }
+    }
+    if (m_reverbWet.next()) {
+        engine.setReverbWet(m_reverbWet.value());
+    }
+    if (m_chorusLevel.next()) {
+        engine.setChorusLevel(m_chorusLevel.value());
+    }
+}
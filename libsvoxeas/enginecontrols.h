@@ -0,0 +1,60 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef ENGINECONTROLS_H
+#define ENGINECONTROLS_H
+
+#include "controlqueue.h"
+#include "gainsmoother.h"
+#include "synthengine.h"
+
+/*
+ * Effect settings for an engine owned by a worker thread. The setters may
+ * be called from any thread; apply() is called by the worker before each
+ * block and ramps the levels with a GainSmoother.
+ */
+class EngineControls
+{
+public:
+    EngineControls();
+
+    void setup(SynthEngine &engine);
+
+    void initReverb(int reverb_type);
+    void setReverbWet(int amount);
+    void initChorus(int chorus_type);
+    void setChorusLevel(int amount);
+
+    void apply(SynthEngine &engine);
+
+private:
+    enum ControlParameter {
+        ReverbTypeControl = 0,
+        ReverbWetControl,
+        ChorusTypeControl,
+        ChorusLevelControl,
+        ControlCount
+    };
+
+    ControlQueue m_controls;
+    GainSmoother m_reverbWet;
+    GainSmoother m_chorusLevel;
+};
+
+#endif // ENGINECONTROLS_H
@@ -0,0 +1,393 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QtDebug>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "filestreamer.h"
+#include "tracer.h"
+
+/* nice value of the streaming thread, below the render thread */
+static const int STREAMER_NICE = 10;
+/* milliseconds between checks for free space while the ring is full */
+static const int STREAMER_POLL_TIME = 10;
+/* commands waiting for the streaming thread */
+static const size_t STREAMER_COMMANDS = 16;
+
+FileStreamer::FileStreamer()
+    : m_commands(STREAMER_COMMANDS)
+    , m_sampleRate(0)
+    , m_channels(0)
+    , m_session(0)
+    , m_open(false)
+    , m_synced(false)
+    , m_start(0)
+    , m_consumed(0)
+    , m_underruns(0)
+    , m_duration(-1)
+    , m_playing(false)
+    , m_activeSession(0)
+    , m_sessionStart(0)
+    , m_finishedSession(0)
+    , m_stopped(true)
+{
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wakeFd < 0) {
+        qWarning() << "eventfd error:" << strerror(errno);
+    }
+}
+
+FileStreamer::~FileStreamer()
+{
+    stop();
+    m_engine.uninit();
+    if (m_wakeFd >= 0) {
+        ::close(m_wakeFd);
+    }
+}
+
+/* must not be called while the streaming thread runs */
+void
+FileStreamer::setup(int sampleRate, int channels, int milliseconds)
+{
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+    m_ring.resize(milliseconds > 0 ? size_t(sampleRate) * milliseconds / 1000 * channels : 0);
+}
+
+bool
+FileStreamer::isEnabled() const
+{
+    return m_ring.capacity() > 0;
+}
+
+/* the streaming thread always uses the normal policy, only its CPUs can be chosen */
+void
+FileStreamer::setCpus(const QList<int> &cpus)
+{
+    m_schedule.setCpus(cpus);
+}
+
+/* called when the render thread starts and stops, not while it renders */
+void
+FileStreamer::start()
+{
+    if (!isEnabled() || m_thread.joinable()) {
+        return;
+    }
+    m_stopped = false;
+    m_thread = std::thread(&FileStreamer::run, this);
+}
+
+void
+FileStreamer::stop()
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+    m_stopped = true;
+    notify();
+    m_thread.join();
+    Command command;
+    while (m_commands.take(command)) { }
+    m_open = false;
+}
+
+bool
+FileStreamer::post(Command &&command)
+{
+    if (!m_thread.joinable()) {
+        return false;
+    }
+    const quint32 session = m_session + 1;
+    command.session = session;
+    if (!m_commands.push(std::move(command))) {
+        qWarning() << Q_FUNC_INFO << "command queue full";
+        return false;
+    }
+    m_session = session;
+    m_synced = false;
+    notify();
+    return true;
+}
+
+void
+FileStreamer::notify()
+{
+    quint64 one = 1;
+    if (::write(m_wakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        qWarning() << "eventfd write error:" << strerror(errno);
+    }
+}
+
+bool
+FileStreamer::open(const QString &fileName, const QString &soundfont, int duration, int start)
+{
+    Command command;
+    command.type = Command::Open;
+    command.fileName = fileName;
+    command.soundfont = soundfont;
+    command.duration = duration;
+    command.start = start;
+    if (!post(std::move(command))) {
+        return false;
+    }
+    m_open = true;
+    m_start = start;
+    m_consumed = 0;
+    m_underruns = 0;
+    return true;
+}
+
+void
+FileStreamer::close()
+{
+    if (!m_open) {
+        return;
+    }
+    Command command;
+    command.type = Command::Close;
+    post(std::move(command));
+    m_open = false;
+}
+
+/* the audio rendered ahead is dropped, and the streaming thread moves the file to the new time */
+void
+FileStreamer::seek(int milliseconds)
+{
+    if (!m_open) {
+        return;
+    }
+    Command command;
+    command.type = Command::Seek;
+    command.start = milliseconds;
+    if (post(std::move(command))) {
+        m_start = milliseconds;
+        m_consumed = 0;
+    }
+}
+
+bool
+FileStreamer::isOpen() const
+{
+    return m_open;
+}
+
+/* true once the streaming thread renders the last posted session; its older audio is dropped */
+bool
+FileStreamer::sync()
+{
+    if (!m_synced) {
+        if (m_activeSession.load(std::memory_order_acquire) != m_session) {
+            return false;
+        }
+        m_ring.skipTo(m_sessionStart.load(std::memory_order_acquire));
+        m_synced = true;
+    }
+    return true;
+}
+
+int
+FileStreamer::read(EAS_PCM *buffer, int frames)
+{
+    if (!m_open || !sync()) {
+        return 0;
+    }
+    /* the flag is read first, so that a finished stream has no more audio than counted here;
+       an empty ring before the first block is the file being opened, not an underrun */
+    bool finished = m_finishedSession.load(std::memory_order_acquire) == m_session;
+    int count = int(m_ring.read(buffer, size_t(frames) * m_channels) / m_channels);
+    if (count < frames && !finished && m_consumed > 0) {
+        ++m_underruns;
+    }
+    m_consumed += count;
+    return count;
+}
+
+bool
+FileStreamer::atEnd() const
+{
+    if (!m_open) {
+        return true;
+    }
+    return m_synced && m_finishedSession.load(std::memory_order_acquire) == m_session
+           && m_ring.readAvailable() == 0;
+}
+
+int
+FileStreamer::position() const
+{
+    return m_sampleRate > 0 ? m_start + int(m_consumed * 1000 / m_sampleRate) : m_start;
+}
+
+int
+FileStreamer::underruns() const
+{
+    return m_underruns;
+}
+
+void
+FileStreamer::initReverb(int reverb_type)
+{
+    m_controls.initReverb(reverb_type);
+}
+
+void
+FileStreamer::setReverbWet(int amount)
+{
+    m_controls.setReverbWet(amount);
+}
+
+void
+FileStreamer::initChorus(int chorus_type)
+{
+    m_controls.initChorus(chorus_type);
+}
+
+void
+FileStreamer::setChorusLevel(int amount)
+{
+    m_controls.setChorusLevel(amount);
+}
+
+/* the engine is kept between files, and only rebuilt when the soundfont changes */
+bool
+FileStreamer::prepareEngine()
+{
+    if (m_engine.isValid() && m_engineSoundfont == m_soundfont) {
+        return true;
+    }
+    m_engine.uninit();
+    if (!m_engine.init(m_soundfont)) {
+        return false;
+    }
+    if (m_engine.sampleRate() != m_sampleRate || m_engine.channels() != m_channels) {
+        qWarning() << Q_FUNC_INFO << "unexpected engine format";
+        m_engine.uninit();
+        return false;
+    }
+    m_engineSoundfont = m_soundfont;
+    m_buffer.resize(m_engine.bufferSize() * m_engine.channels());
+    m_controls.setup(m_engine);
+    return true;
+}
+
+bool
+FileStreamer::openFile(int start)
+{
+    closeFile();
+    if (!prepareEngine()) {
+        return false;
+    }
+    m_controls.apply(m_engine);
+    if (!m_engine.openFile(m_fileName, m_duration)) {
+        return false;
+    }
+    if (start > 0) {
+        m_engine.seek(start);
+    }
+    m_playing = true;
+    return true;
+}
+
+void
+FileStreamer::closeFile()
+{
+    if (m_playing) {
+        m_engine.closeFile();
+        m_playing = false;
+    }
+}
+
+/* nothing of the previous session is written after this */
+void
+FileStreamer::execute(const Command &command)
+{
+    TRACE_SCOPE("FileStreamer::execute");
+    switch (command.type) {
+    case Command::Open:
+        m_fileName = command.fileName;
+        m_soundfont = command.soundfont;
+        m_duration = command.duration;
+        openFile(command.start);
+        break;
+    case Command::Close:
+        closeFile();
+        if (m_underruns > 0) {
+            qDebug() << Q_FUNC_INFO << m_fileName << "underruns:" << m_underruns;
+        }
+        break;
+    case Command::Seek:
+        /* a finished file is opened again */
+        if (!m_playing || !m_engine.seek(command.start)) {
+            openFile(command.start);
+        }
+        break;
+    }
+    m_sessionStart.store(m_ring.written(), std::memory_order_release);
+    if (!m_playing) {
+        m_finishedSession.store(command.session, std::memory_order_release);
+    }
+    m_activeSession.store(command.session, std::memory_order_release);
+}
+
+void
+FileStreamer::run()
+{
+    m_schedule.apply("streamer", 0);
+    if (setpriority(PRIO_PROCESS, id_t(syscall(SYS_gettid)), STREAMER_NICE) < 0) {
+        qDebug() << Q_FUNC_INFO << "could not lower the thread priority";
+    }
+    while (!m_stopped) {
+        Command command;
+        while (m_commands.take(command)) {
+            execute(command);
+            /* the strings of the command are released here, not on the render thread */
+            command = Command();
+        }
+        if (m_playing && m_ring.writeAvailable() >= size_t(m_buffer.size())) {
+            if (m_engine.playbackCompleted()) {
+                closeFile();
+                m_finishedSession.store(m_activeSession.load(std::memory_order_relaxed),
+                                        std::memory_order_release);
+                continue;
+            }
+            TRACE_SCOPE("FileStreamer::render");
+            m_controls.apply(m_engine);
+            EAS_I32 frames = m_engine.render(m_buffer.data());
+            m_ring.write(m_buffer.constData(), size_t(frames) * m_channels);
+            continue;
+        }
+        /* idle until a command, or until the render thread makes room in the ring */
+        struct pollfd fd;
+        fd.fd = m_wakeFd;
+        fd.events = POLLIN;
+        fd.revents = 0;
+        while (poll(&fd, 1, m_playing ? STREAMER_POLL_TIME : -1) < 0 && errno == EINTR) { }
+        quint64 count;
+        while (::read(m_wakeFd, &count, sizeof(count)) > 0) { }
+    }
+    closeFile();
+}
@@ -0,0 +1,135 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef FILESTREAMER_H
+#define FILESTREAMER_H
+
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <thread>
+#include "enginecontrols.h"
+#include "spscring.h"
+#include "synthengine.h"
+#include "threadschedule.h"
+
+/*
+ * Plays a MIDI file with its own EAS instance on a low priority thread,
+ * rendering up to the buffer time ahead of the output into a ring. The
+ * render thread only copies the audio out, so a CPU spike in the file
+ * rendering does not reach the live MIDI path, and the live engine is not
+ * loaded by the file voices. Effect changes are heard on the file audio
+ * once the buffered part has been played.
+ *
+ * The streaming thread lives from start() to stop(). The render thread
+ * posts open, close and seek commands to it through a lock-free queue and
+ * never waits for them: each command starts a new session, and the audio
+ * of the previous sessions still in the ring is dropped unheard.
+ */
+class FileStreamer
+{
+public:
+    FileStreamer();
+    ~FileStreamer();
+
+    void setup(int sampleRate, int channels, int milliseconds);
+    bool isEnabled() const;
+    void setCpus(const QList<int> &cpus);
+    void start();
+    void stop();
+
+    /* called from the render thread, they never block */
+    bool open(const QString &fileName, const QString &soundfont, int duration = -1, int start = 0);
+    void close();
+    void seek(int milliseconds);
+    bool isOpen() const;
+    int read(EAS_PCM *buffer, int frames);
+    bool atEnd() const;
+    int position() const;
+    int underruns() const;
+
+    void initReverb(int reverb_type);
+    void setReverbWet(int amount);
+    void initChorus(int chorus_type);
+    void setChorusLevel(int amount);
+
+private:
+    Q_DISABLE_COPY(FileStreamer)
+
+    struct Command {
+        enum Type {
+            Open,
+            Close,
+            Seek
+        };
+        Type type;
+        quint32 session;
+        QString fileName;
+        QString soundfont;
+        int duration;
+        int start;
+    };
+
+    bool post(Command &&command);
+    bool sync();
+    void notify();
+
+    /* streaming thread */
+    void run();
+    void execute(const Command &command);
+    bool openFile(int start);
+    void closeFile();
+    bool prepareEngine();
+
+    SynthEngine m_engine;
+    QString m_engineSoundfont;
+    EngineControls m_controls;
+    QVector<EAS_PCM> m_buffer;
+    SpscRing<EAS_PCM> m_ring;
+    SpscRing<Command> m_commands;
+    int m_sampleRate;
+    int m_channels;
+    ThreadSchedule m_schedule;
+
+    /* render thread */
+    quint32 m_session;
+    bool m_open;
+    bool m_synced;
+    int m_start;
+    qint64 m_consumed;
+    std::atomic<int> m_underruns;
+
+    /* streaming thread: the file of the last open command */
+    QString m_fileName;
+    QString m_soundfont;
+    int m_duration;
+    bool m_playing;
+
+    /* published by the streaming thread: the session being rendered, where
+       its audio starts in the ring, and the last session rendered to the end */
+    std::atomic<quint32> m_activeSession;
+    std::atomic<size_t> m_sessionStart;
+    std::atomic<quint32> m_finishedSession;
+
+    std::thread m_thread;
+    std::atomic<bool> m_stopped;
+    int m_wakeFd;
+};
+
+#endif // FILESTREAMER_H
@@ -0,0 +1,84 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cmath>
+#include "gainsmoother.h"
+
+GainSmoother::GainSmoother()
+    : m_coefficient(1.0)
+    , m_current(0.0)
+    , m_value(0)
+    , m_target(0)
+{
+}
+
+void
+GainSmoother::setup(int sampleRate, int blockSize, double timeConstant)
+{
+    if (sampleRate > 0 && blockSize > 0 && timeConstant > 0.0) {
+        double blockTime = double(blockSize) / sampleRate;
+        m_coefficient = 1.0 - std::exp(-blockTime / timeConstant);
+    } else {
+        m_coefficient = 1.0;
+    }
+}
+
+void
+GainSmoother::reset(int value)
+{
+    m_current = value;
+    m_value = value;
+    m_target = value;
+}
+
+void
+GainSmoother::setTarget(int value)
+{
+    m_target = value;
+}
+
+/* advances one block, returns true when the value has changed */
+bool
+GainSmoother::next()
+{
+    if (m_value == m_target) {
+        return false;
+    }
+    m_current += (m_target - m_current) * m_coefficient;
+    int value = int(std::lround(m_current));
+    if (std::fabs(m_target - m_current) < 1.0 || value == m_value) {
+        /* the remaining steps would be smaller than one unit */
+        m_current = m_target;
+        value = m_target;
+    }
+    m_value = value;
+    return true;
+}
+
+int
+GainSmoother::value() const
+{
+    return m_value;
+}
+
+int
+GainSmoother::target() const
+{
+    return m_target;
+}
@@ -0,0 +1,48 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef GAINSMOOTHER_H
+#define GAINSMOOTHER_H
+
+/*
+ * One pole ramp for an integer gain parameter that can only be changed once
+ * per rendered block. Large jumps are spread over several blocks so that
+ * turning a dial quickly does not produce zipper noise.
+ */
+class GainSmoother
+{
+public:
+    GainSmoother();
+
+    void setup(int sampleRate, int blockSize, double timeConstant = 0.02);
+    void reset(int value);
+    void setTarget(int value);
+    bool next();
+
+    int value() const;
+    int target() const;
+
+private:
+    double m_coefficient;
+    double m_current;
+    int m_value;
+    int m_target;
+};
+
+#endif // GAINSMOOTHER_H
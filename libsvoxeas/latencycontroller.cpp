@@ -0,0 +1,155 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "latencycontroller.h"
+
+/* time without measurements after the stream is opened, while it fills up */
+static const int WARMUP_TIME = 1000;
+/* healthy time required for the first reduction, and its upper limit */
+static const int MIN_HOLD_TIME = 10000;
+static const int MAX_HOLD_TIME = 300000;
+/* a reduction waits for a silent block, but not longer than this */
+static const int SILENCE_WAIT_TIME = 30000;
+/* smallest change of the buffer time in milliseconds */
+static const int MIN_STEP = 5;
+
+LatencyController::LatencyController()
+    : m_blockTime(0)
+    , m_bufferTime(0)
+    , m_target(0)
+    , m_floor(0)
+    , m_ceiling(0)
+    , m_warmupBlocks(0)
+    , m_healthyBlocks(0)
+    , m_holdBlocks(0)
+    , m_waitBlocks(0)
+    , m_underruns(0)
+    , m_renderedBlocks(0)
+{
+}
+
+/* blockTime is the duration of a rendered block in nanoseconds */
+void
+LatencyController::reset(qint64 blockTime, int bufferTime, int floor, int ceiling)
+{
+    m_blockTime = blockTime;
+    m_floor = floor;
+    m_ceiling = qMax(floor, ceiling);
+    m_bufferTime = qBound(m_floor, bufferTime, m_ceiling);
+    m_target = m_bufferTime;
+    m_warmupBlocks = blocks(WARMUP_TIME);
+    m_healthyBlocks = 0;
+    m_holdBlocks = blocks(MIN_HOLD_TIME);
+    m_waitBlocks = 0;
+    m_underruns = 0;
+    m_renderedBlocks = 0;
+}
+
+int
+LatencyController::blocks(int milliseconds) const
+{
+    return m_blockTime > 0 ? int(qint64(milliseconds) * 1000000 / m_blockTime) : 0;
+}
+
+/* called after writing each block, underrun if the sink ran dry since the last one */
+void
+LatencyController::update(bool underrun)
+{
+    ++m_renderedBlocks;
+    if (m_warmupBlocks > 0) {
+        --m_warmupBlocks;
+        return;
+    }
+    if (underrun) {
+        ++m_underruns;
+        m_healthyBlocks = 0;
+        m_holdBlocks = qMin(m_holdBlocks * 2, blocks(MAX_HOLD_TIME));
+        m_target = qMin(m_ceiling, qMax(m_bufferTime * 2, m_bufferTime + MIN_STEP));
+        return;
+    }
+    if (m_target < m_bufferTime) {
+        ++m_waitBlocks;
+    } else if (m_target == m_bufferTime && m_bufferTime > m_floor && ++m_healthyBlocks >= m_holdBlocks) {
+        m_target = qMax(m_floor, m_bufferTime - qMax(MIN_STEP, m_bufferTime / 8));
+        m_healthyBlocks = 0;
+        m_waitBlocks = 0;
+    }
+}
+
+/* growing is urgent, shrinking is done in a silent block when possible */
+bool
+LatencyController::ready(bool silent)
+{
+    if (m_target > m_bufferTime) {
+        return true;
+    }
+    return m_target < m_bufferTime && (silent || m_waitBlocks >= blocks(SILENCE_WAIT_TIME));
+}
+
+void
+LatencyController::applied()
+{
+    m_bufferTime = m_target;
+    m_warmupBlocks = blocks(WARMUP_TIME);
+    m_healthyBlocks = 0;
+    m_waitBlocks = 0;
+}
+
+/* the output was starved on purpose, the next measurements are not underruns */
+void
+LatencyController::resume()
+{
+    m_warmupBlocks = blocks(WARMUP_TIME);
+}
+
+int
+LatencyController::bufferTime() const
+{
+    return m_bufferTime;
+}
+
+int
+LatencyController::target() const
+{
+    return m_target;
+}
+
+bool
+LatencyController::pending() const
+{
+    return m_target != m_bufferTime;
+}
+
+bool
+LatencyController::growing() const
+{
+    return m_target > m_bufferTime;
+}
+
+int
+LatencyController::underruns() const
+{
+    return m_underruns;
+}
+
+qint64
+LatencyController::elapsed() const
+{
+    return m_renderedBlocks * m_blockTime / 1000000;
+}
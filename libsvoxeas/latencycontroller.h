@@ -0,0 +1,76 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef LATENCYCONTROLLER_H
+#define LATENCYCONTROLLER_H
+
+#include <QtGlobal>
+
+/* a change of the output buffer time, for tuning the floor on each host */
+struct LatencyChange
+{
+    qint64 time;    /* milliseconds of audio rendered before the change */
+    int from;       /* buffer time in milliseconds */
+    int to;
+    bool underrun;  /* grown after an underrun, or shrunk after a healthy period */
+};
+
+/*
+ * Chooses the output buffer time from the underflows reported by the sink
+ * after each block. When the sink ran dry the buffer is doubled at once.
+ * After a period without underruns it is reduced by one eighth toward the
+ * floor, and each underrun doubles the length of the healthy period
+ * required for the next reduction, so the buffer settles just above the
+ * level where the host starts to fail.
+ */
+class LatencyController
+{
+public:
+    LatencyController();
+
+    void reset(qint64 blockTime, int bufferTime, int floor, int ceiling);
+    void update(bool underrun);
+    bool ready(bool silent);
+    void applied();
+    void resume();
+
+    int bufferTime() const;
+    int target() const;
+    bool pending() const;
+    bool growing() const;
+    int underruns() const;
+    qint64 elapsed() const;
+
+private:
+    int blocks(int milliseconds) const;
+
+    qint64 m_blockTime;
+    int m_bufferTime;
+    int m_target;
+    int m_floor;
+    int m_ceiling;
+    int m_warmupBlocks;
+    int m_healthyBlocks;
+    int m_holdBlocks;
+    int m_waitBlocks;
+    int m_underruns;
+    qint64 m_renderedBlocks;
+};
+
+#endif // LATENCYCONTROLLER_H
@@ -0,0 +1,190 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QtGlobal>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "levelmeter.h"
+
+/* integration time of the RMS level, in seconds */
+static const float RMS_TIME = 0.3f;
+static const float FULL_SCALE = 32768.0f;
+
+namespace {
+
+struct Levels
+{
+    int peak[LevelMeter::MAX_CHANNELS];
+    quint64 squares[LevelMeter::MAX_CHANNELS];
+};
+
+/* scalar tail, and the whole buffer on other architectures */
+void scalarLevels(const EAS_PCM *buffer, int samples, int channels, Levels &lv)
+{
+    for (int i = 0; i < samples; ++i) {
+        int ch = i % channels;
+        int s = buffer[i];
+        int a = s < 0 ? -s : s;
+        if (a > lv.peak[ch]) {
+            lv.peak[ch] = a;
+        }
+        lv.squares[ch] += quint64(s * s);
+    }
+}
+
+#if defined(__SSE2__)
+
+/* 8 samples per iteration: the even 16 bit lanes hold the left channel and
+   the odd lanes the right channel, or both the same channel when mono */
+int simdLevels(const EAS_PCM *buffer, int samples, Levels &lv, bool stereo)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i evenMask = _mm_set1_epi32(0x0000ffff);
+    __m128i peak = zero;
+    __m128i sumEven = zero;
+    __m128i sumOdd = zero;
+    int i = 0;
+    for (; i + 8 <= samples; i += 8) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buffer + i));
+        peak = _mm_max_epi16(peak, _mm_max_epi16(x, _mm_subs_epi16(zero, x)));
+        __m128i even = _mm_and_si128(x, evenMask);
+        __m128i odd = _mm_srli_epi32(x, 16);
+        __m128i sqEven = _mm_madd_epi16(even, even);
+        __m128i sqOdd = _mm_madd_epi16(odd, odd);
+        sumEven = _mm_add_epi64(sumEven, _mm_unpacklo_epi32(sqEven, zero));
+        sumEven = _mm_add_epi64(sumEven, _mm_unpackhi_epi32(sqEven, zero));
+        sumOdd = _mm_add_epi64(sumOdd, _mm_unpacklo_epi32(sqOdd, zero));
+        sumOdd = _mm_add_epi64(sumOdd, _mm_unpackhi_epi32(sqOdd, zero));
+    }
+    alignas(16) qint16 peaks[8];
+    alignas(16) quint64 even[2];
+    alignas(16) quint64 odd[2];
+    _mm_store_si128(reinterpret_cast<__m128i *>(peaks), peak);
+    _mm_store_si128(reinterpret_cast<__m128i *>(even), sumEven);
+    _mm_store_si128(reinterpret_cast<__m128i *>(odd), sumOdd);
+    int oddChannel = stereo ? 1 : 0;
+    for (int j = 0; j < 8; j += 2) {
+        lv.peak[0] = qMax<int>(lv.peak[0], peaks[j]);
+        lv.peak[oddChannel] = qMax<int>(lv.peak[oddChannel], peaks[j + 1]);
+    }
+    lv.squares[0] += even[0] + even[1];
+    lv.squares[oddChannel] += odd[0] + odd[1];
+    return i;
+}
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+
+int simdLevels(const EAS_PCM *buffer, int samples, Levels &lv, bool stereo)
+{
+    int16x8_t peakL = vdupq_n_s16(0);
+    int16x8_t peakR = vdupq_n_s16(0);
+    uint64x2_t sumL = vdupq_n_u64(0);
+    uint64x2_t sumR = vdupq_n_u64(0);
+    int i = 0;
+    /* 16 samples per iteration, deinterleaved by the load */
+    for (; i + 16 <= samples; i += 16) {
+        int16x8x2_t x = vld2q_s16(buffer + i);
+        peakL = vmaxq_s16(peakL, vqabsq_s16(x.val[0]));
+        peakR = vmaxq_s16(peakR, vqabsq_s16(x.val[1]));
+        int32x4_t lo = vmull_s16(vget_low_s16(x.val[0]), vget_low_s16(x.val[0]));
+        int32x4_t hi = vmull_s16(vget_high_s16(x.val[0]), vget_high_s16(x.val[0]));
+        sumL = vpadalq_u32(sumL, vreinterpretq_u32_s32(lo));
+        sumL = vpadalq_u32(sumL, vreinterpretq_u32_s32(hi));
+        lo = vmull_s16(vget_low_s16(x.val[1]), vget_low_s16(x.val[1]));
+        hi = vmull_s16(vget_high_s16(x.val[1]), vget_high_s16(x.val[1]));
+        sumR = vpadalq_u32(sumR, vreinterpretq_u32_s32(lo));
+        sumR = vpadalq_u32(sumR, vreinterpretq_u32_s32(hi));
+    }
+    int rightChannel = stereo ? 1 : 0;
+    lv.peak[0] = qMax<int>(lv.peak[0], vmaxvq_s16(peakL));
+    lv.peak[rightChannel] = qMax<int>(lv.peak[rightChannel], vmaxvq_s16(peakR));
+    lv.squares[0] += vgetq_lane_u64(sumL, 0) + vgetq_lane_u64(sumL, 1);
+    lv.squares[rightChannel] += vgetq_lane_u64(sumR, 0) + vgetq_lane_u64(sumR, 1);
+    return i;
+}
+
+#endif
+
+} // namespace
+
+LevelMeter::LevelMeter()
+{
+    reset(0);
+}
+
+void LevelMeter::reset(int sampleRate)
+{
+    m_rmsCoeff = sampleRate > 0 ? 1.0f / (RMS_TIME * sampleRate) : 1.0f;
+    for (int ch = 0; ch < MAX_CHANNELS; ++ch) {
+        m_meanSquare[ch] = 0.0f;
+        m_peak[ch].store(0.0f, std::memory_order_relaxed);
+        m_rms[ch].store(0.0f, std::memory_order_relaxed);
+    }
+}
+
+void LevelMeter::process(const EAS_PCM *buffer, int frames, int channels)
+{
+    if (frames <= 0 || channels < 1 || channels > MAX_CHANNELS) {
+        return;
+    }
+    Levels lv = {{0, 0}, {0, 0}};
+    int samples = frames * channels;
+    int done = 0;
+#if defined(__SSE2__) || (defined(__aarch64__) && defined(__ARM_NEON))
+    done = simdLevels(buffer, samples, lv, channels == 2);
+#endif
+    scalarLevels(buffer + done, samples - done, channels, lv);
+    /* the block is integrated into the RMS level as a single step */
+    float weight = qMin(1.0f, m_rmsCoeff * frames);
+    for (int ch = 0; ch < channels; ++ch) {
+        float ms = lv.squares[ch] / (FULL_SCALE * FULL_SCALE * frames);
+        m_meanSquare[ch] += weight * (ms - m_meanSquare[ch]);
+        m_rms[ch].store(std::sqrt(m_meanSquare[ch]), std::memory_order_relaxed);
+        float p = lv.peak[ch] / FULL_SCALE;
+        float held = m_peak[ch].load(std::memory_order_relaxed);
+        while (p > held && !m_peak[ch].compare_exchange_weak(held, p, std::memory_order_relaxed)) {
+        }
+    }
+    if (channels == 1) {
+        m_peak[1].store(m_peak[0].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        m_rms[1].store(m_rms[0].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+float LevelMeter::peak(int channel)
+{
+    if (channel < 0 || channel >= MAX_CHANNELS) {
+        return 0.0f;
+    }
+    return m_peak[channel].exchange(0.0f, std::memory_order_relaxed);
+}
+
+float LevelMeter::rms(int channel) const
+{
+    if (channel < 0 || channel >= MAX_CHANNELS) {
+        return 0.0f;
+    }
+    return m_rms[channel].load(std::memory_order_relaxed);
+}
@@ -0,0 +1,53 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef LEVELMETER_H
+#define LEVELMETER_H
+
+#include <atomic>
+#include <eas_types.h>
+
+/*
+ * Peak and RMS levels of the rendered audio. process() is called by the
+ * render thread for every buffer, and computes both values for each channel
+ * in a single SIMD pass over the interleaved samples. The levels are
+ * published in atomic variables, normalized to 0.0 .. 1.0 full scale. The
+ * peak is held until it is read, so slow readers do not miss short peaks.
+ */
+class LevelMeter
+{
+public:
+    static const int MAX_CHANNELS = 2;
+
+    LevelMeter();
+
+    void reset(int sampleRate);
+    void process(const EAS_PCM *buffer, int frames, int channels);
+
+    float peak(int channel);
+    float rms(int channel) const;
+
+private:
+    float m_rmsCoeff;
+    float m_meanSquare[MAX_CHANNELS];
+    std::atomic<float> m_peak[MAX_CHANNELS];
+    std::atomic<float> m_rms[MAX_CHANNELS];
+};
+
+#endif // LEVELMETER_H
@@ -0,0 +1,161 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtDebug>
+#include <algorithm>
+
+#include "libraryindex.h"
+
+static const quint32 INDEX_MAGIC = 0x494c5653; /* "SVLI" */
+static const quint16 INDEX_VERSION = 1;
+/* bytes of an entry with an empty path and title, to bound the entry count of a corrupt index */
+static const qint64 INDEX_MIN_ENTRY_SIZE = 4 + 8 + 8 + 4 + 2 + 1 + 4;
+
+LibraryEntry::LibraryEntry()
+    : size(-1)
+    , modified(0)
+    , duration(-1)
+    , tracks(0)
+    , valid(false)
+{}
+
+LibraryIndex::LibraryIndex(const QString &fileName)
+    : m_fileName(fileName.isEmpty() ? defaultFileName() : fileName)
+{}
+
+QString LibraryIndex::defaultFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+           + QStringLiteral("/sonivoxeas/library.idx");
+}
+
+QString LibraryIndex::fileName() const
+{
+    return m_fileName;
+}
+
+bool LibraryIndex::load()
+{
+    m_entries.clear();
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint32 magic, count;
+    quint16 version;
+    stream >> magic >> version >> count;
+    if (magic != INDEX_MAGIC || version != INDEX_VERSION) {
+        qWarning() << "Ignoring incompatible library index" << m_fileName;
+        return false;
+    }
+    if (qint64(count) > (file.size() - file.pos()) / INDEX_MIN_ENTRY_SIZE) {
+        qWarning() << "Ignoring corrupt library index" << m_fileName;
+        return false;
+    }
+    m_entries.reserve(int(count));
+    /* paths and titles are stored as UTF-8, about half the size of QString */
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        LibraryEntry entry;
+        QByteArray path, title;
+        quint8 valid;
+        stream >> path >> entry.size >> entry.modified >> entry.duration >> entry.tracks >> valid
+            >> title;
+        entry.path = QString::fromUtf8(path);
+        entry.title = QString::fromUtf8(title);
+        entry.valid = valid != 0;
+        if (stream.status() == QDataStream::Ok) {
+            m_entries.insert(entry.path, entry);
+        }
+    }
+    return stream.status() == QDataStream::Ok;
+}
+
+bool LibraryIndex::save() const
+{
+    QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Can't write the library index" << m_fileName << file.errorString();
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << INDEX_MAGIC << INDEX_VERSION << quint32(m_entries.count());
+    for (const LibraryEntry &entry : m_entries) {
+        stream << entry.path.toUtf8() << entry.size << entry.modified << entry.duration
+               << entry.tracks << quint8(entry.valid ? 1 : 0) << entry.title.toUtf8();
+    }
+    return file.commit();
+}
+
+/* finds the entry of a file, if the file has not changed since it was indexed */
+bool LibraryIndex::lookup(const QString &path, LibraryEntry &entry) const
+{
+    QFileInfo info(path);
+    if (!isCurrent(info.absoluteFilePath(), info.size(), info.lastModified().toMSecsSinceEpoch())) {
+        return false;
+    }
+    entry = m_entries.value(info.absoluteFilePath());
+    return true;
+}
+
+bool LibraryIndex::isCurrent(const QString &path, qint64 size, qint64 modified) const
+{
+    QHash<QString, LibraryEntry>::const_iterator it = m_entries.constFind(path);
+    return it != m_entries.constEnd() && it.value().size == size && it.value().modified == modified;
+}
+
+void LibraryIndex::insert(const LibraryEntry &entry)
+{
+    m_entries.insert(entry.path, entry);
+}
+
+void LibraryIndex::remove(const QString &path)
+{
+    m_entries.remove(path);
+}
+
+QList<LibraryEntry> LibraryIndex::entries(const QString &directory) const
+{
+    QList<LibraryEntry> result;
+    QString prefix = directory.isEmpty() ? QString() : QDir(directory).absolutePath() + QLatin1Char('/');
+    for (const LibraryEntry &entry : m_entries) {
+        if (prefix.isEmpty() || entry.path.startsWith(prefix)) {
+            result.append(entry);
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const LibraryEntry &a, const LibraryEntry &b) {
+        return a.path < b.path;
+    });
+    return result;
+}
+
+int LibraryIndex::count() const
+{
+    return m_entries.count();
+}
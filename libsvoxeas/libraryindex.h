@@ -0,0 +1,70 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef LIBRARYINDEX_H
+#define LIBRARYINDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QtGlobal>
+
+struct LibraryEntry
+{
+    LibraryEntry();
+
+    QString path;
+    qint64 size;
+    qint64 modified;  /* msecs since epoch */
+    qint32 duration;  /* milliseconds */
+    quint16 tracks;
+    bool valid;
+    QString title;
+};
+
+/*
+ * Metadata of the MIDI files in a music library, stored in a compact binary
+ * file. An entry stays valid as long as the size and modification time of
+ * its file do not change, so a library can be rescanned incrementally.
+ */
+class LibraryIndex
+{
+public:
+    explicit LibraryIndex(const QString &fileName = QString());
+
+    bool load();
+    bool save() const;
+    QString fileName() const;
+
+    bool lookup(const QString &path, LibraryEntry &entry) const;
+    bool isCurrent(const QString &path, qint64 size, qint64 modified) const;
+    void insert(const LibraryEntry &entry);
+    void remove(const QString &path);
+    /* the entries of the files in directory and its subdirectories, sorted by path */
+    QList<LibraryEntry> entries(const QString &directory = QString()) const;
+    int count() const;
+
+    static QString defaultFileName();
+
+private:
+    QString m_fileName;
+    QHash<QString, LibraryEntry> m_entries;
+};
+
+#endif // LIBRARYINDEX_H
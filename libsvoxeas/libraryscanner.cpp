@@ -0,0 +1,165 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QtDebug>
+
+#include "libraryscanner.h"
+#include "smfreader.h"
+
+/* files read and parsed by one task */
+static const int SCAN_BATCH_SIZE = 64;
+
+class ScanTask : public QRunnable
+{
+public:
+    ScanTask(LibraryScanner *scanner, const QStringList &paths)
+        : m_scanner(scanner)
+        , m_paths(paths)
+    {}
+
+    void run() override
+    {
+        QList<LibraryEntry> entries;
+        entries.reserve(m_paths.count());
+        for (const QString &path : m_paths) {
+            entries.append(LibraryScanner::scanFile(path));
+        }
+        m_scanner->addResults(entries);
+    }
+
+private:
+    LibraryScanner *m_scanner;
+    QStringList m_paths;
+};
+
+LibraryScanner::LibraryScanner(LibraryIndex *index)
+    : m_index(index)
+    , m_parsed(0)
+    , m_reused(0)
+    , m_removed(0)
+{}
+
+QStringList LibraryScanner::nameFilters()
+{
+    return QStringList() << "*.mid" << "*.midi" << "*.kar" << "*.rmi";
+}
+
+LibraryEntry LibraryScanner::scanFile(const QString &path)
+{
+    LibraryEntry entry;
+    QFileInfo info(path);
+    entry.path = info.absoluteFilePath();
+    entry.size = info.size();
+    entry.modified = info.lastModified().toMSecsSinceEpoch();
+    QFile file(entry.path);
+    if (file.open(QIODevice::ReadOnly)) {
+        SmfReader smf;
+        if (smf.parse(file.readAll())) {
+            entry.valid = true;
+            entry.duration = qint32(smf.duration() / 1000);
+            entry.tracks = quint16(smf.tracks());
+            entry.title = smf.title();
+        }
+    }
+    return entry;
+}
+
+/* returns the number of files that had to be parsed */
+int LibraryScanner::scan(const QString &directory)
+{
+    m_parsed = 0;
+    m_reused = 0;
+    m_removed = 0;
+
+    QSet<QString> found;
+    QStringList batch;
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+    QDirIterator it(directory, nameFilters(), QDir::Files | QDir::Readable,
+                    QDirIterator::Subdirectories | QDirIterator::FollowSymlinks);
+    while (it.hasNext()) {
+        it.next();
+        QFileInfo info = it.fileInfo();
+        QString path = info.absoluteFilePath();
+        found.insert(path);
+        bool current;
+        {
+            QMutexLocker locker(&m_mutex);
+            current = m_index->isCurrent(path, info.size(), info.lastModified().toMSecsSinceEpoch());
+        }
+        if (current) {
+            ++m_reused;
+            continue;
+        }
+        batch.append(path);
+        if (batch.count() == SCAN_BATCH_SIZE) {
+            pool.start(new ScanTask(this, batch));
+            batch.clear();
+        }
+    }
+    if (!batch.isEmpty()) {
+        pool.start(new ScanTask(this, batch));
+    }
+    pool.waitForDone();
+
+    /* forget the files that are gone */
+    for (const LibraryEntry &entry : m_index->entries(directory)) {
+        if (!found.contains(entry.path)) {
+            m_index->remove(entry.path);
+            ++m_removed;
+        }
+    }
+    qDebug() << Q_FUNC_INFO << directory << "parsed:" << m_parsed << "reused:" << m_reused
+             << "removed:" << m_removed;
+    return m_parsed;
+}
+
+void LibraryScanner::addResults(const QList<LibraryEntry> &entries)
+{
+    QMutexLocker locker(&m_mutex);
+    for (const LibraryEntry &entry : entries) {
+        m_index->insert(entry);
+    }
+    m_parsed += entries.count();
+}
+
+int LibraryScanner::parsedFiles() const
+{
+    return m_parsed;
+}
+
+int LibraryScanner::reusedFiles() const
+{
+    return m_reused;
+}
+
+int LibraryScanner::removedFiles() const
+{
+    return m_removed;
+}
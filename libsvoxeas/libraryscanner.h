@@ -0,0 +1,59 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef LIBRARYSCANNER_H
+#define LIBRARYSCANNER_H
+
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include "libraryindex.h"
+
+/*
+ * Walks a directory tree and brings a LibraryIndex up to date. Files whose
+ * size and modification time match their index entry are not read again;
+ * the rest are read and parsed in batches on a thread pool while the walk
+ * goes on.
+ */
+class LibraryScanner
+{
+public:
+    explicit LibraryScanner(LibraryIndex *index);
+
+    int scan(const QString &directory);
+    int parsedFiles() const;
+    int reusedFiles() const;
+    int removedFiles() const;
+
+    static LibraryEntry scanFile(const QString &path);
+    static QStringList nameFilters();
+
+private:
+    friend class ScanTask;
+
+    void addResults(const QList<LibraryEntry> &entries);
+
+    LibraryIndex *m_index;
+    QMutex m_mutex;
+    int m_parsed;
+    int m_reused;
+    int m_removed;
+};
+
+#endif // LIBRARYSCANNER_H
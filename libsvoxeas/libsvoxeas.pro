@@ -3,6 +3,7 @@
 # Sonivox EAS library for Qt
 #
 #---------------------------
+include(../global.pri)
 
 QT += core
 QT -= gui
@@ -14,6 +15,15 @@ CONFIG(debug, debug|release) {
     DEFINES += QT_NO_DEBUG_OUTPUT
 }
 
+qtHaveModule(dbus) {
+    QT += dbus
+    DEFINES += SVOXEAS_RTKIT
+}
+
+eas_arena {
+    DEFINES += SVOXEAS_ARENA
+}
+
 DEPENDPATH += ../sonivox
 INCLUDEPATH += ../sonivox/host_src
 
@@ -21,19 +31,82 @@ HEADERS += \
     programsettings.h \
     synthcontroller.h \
     synthrenderer.h \
-    filewrapper.h 
+    filewrapper.h \
+    loadgovernor.h \
+    synthstatistics.h \
+    triplebuffer.h \
+    spscring.h \
+    levelmeter.h \
+    audiotap.h \
+    synthengine.h \
+    wavewriter.h \
+    rendercache.h \
+    offlinerenderer.h \
+    controlqueue.h \
+    gainsmoother.h \
+    midiparser.h \
+    rawmidiinput.h \
+    tracer.h \
+    portworker.h \
+    smfreader.h \
+    stemrenderer.h \
+    libraryindex.h \
+    libraryscanner.h \
+    previewmixer.h \
+    enginecontrols.h \
+    filestreamer.h \
+    easarena.h \
+    dspchain.h \
+    dspstages.h \
+    threadschedule.h \
+    latencycontroller.h \
+    synthpool.h \
+    compactsong.h \
+    songstate.h \
+    segmentrenderer.h \
+    pulseoutput.h
 
 SOURCES += \
     programsettings.cpp \
     synthcontroller.cpp \
     synthrenderer.cpp \
-    filewrapper.cpp
+    filewrapper.cpp \
+    loadgovernor.cpp \
+    synthstatistics.cpp \
+    levelmeter.cpp \
+    audiotap.cpp \
+    synthengine.cpp \
+    wavewriter.cpp \
+    rendercache.cpp \
+    offlinerenderer.cpp \
+    gainsmoother.cpp \
+    rawmidiinput.cpp \
+    tracer.cpp \
+    portworker.cpp \
+    smfreader.cpp \
+    stemrenderer.cpp \
+    libraryindex.cpp \
+    libraryscanner.cpp \
+    previewmixer.cpp \
+    enginecontrols.cpp \
+    filestreamer.cpp \
+    easarena.cpp \
+    dspchain.cpp \
+    dspstages.cpp \
+    threadschedule.cpp \
+    latencycontroller.cpp \
+    synthpool.cpp \
+    compactsong.cpp \
+    songstate.cpp \
+    segmentrenderer.cpp \
+    pulseoutput.cpp
 
 QMAKE_LFLAGS += -L../sonivox
 LIBS += -lsonivox
 
 CONFIG += link_pkgconfig
-PKGCONFIG += libpulse-simple \
+PKGCONFIG += libpulse \
+   libpulse-simple \
    alsa
 
 _DRUMSTICKLIBS=$$(DRUMSTICKLIBS)
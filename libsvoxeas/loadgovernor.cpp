@@ -0,0 +1,112 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QString>
+#include "loadgovernor.h"
+
+/* EWMA smoothing factor, per rendered block */
+static const double LOAD_SMOOTHING = 0.05;
+/* fraction of the block deadline used by EAS_Render */
+static const double HIGH_LOAD = 0.75;
+static const double LOW_LOAD = 0.40;
+/* hysteresis, in nanoseconds of sustained load before changing level */
+static const qint64 ESCALATE_TIME = 250000000;
+static const qint64 RELAX_TIME = 3000000000;
+
+LoadGovernor::LoadGovernor()
+{
+    reset(0);
+}
+
+void LoadGovernor::reset(qint64 blockTime)
+{
+    m_blockTime = blockTime;
+    m_load = 0.0;
+    m_level = FullQuality;
+    m_escalateBlocks = 1;
+    m_relaxBlocks = 1;
+    if (blockTime > 0) {
+        m_escalateBlocks = qMax<qint64>(1, ESCALATE_TIME / blockTime);
+        m_relaxBlocks = qMax<qint64>(1, RELAX_TIME / blockTime);
+    }
+    m_blocksAbove = 0;
+    m_blocksBelow = 0;
+}
+
+bool LoadGovernor::update(qint64 renderTime, bool adjust)
+{
+    if (m_blockTime <= 0) {
+        return false;
+    }
+    double sample = double(renderTime) / double(m_blockTime);
+    m_load += LOAD_SMOOTHING * (sample - m_load);
+    if (!adjust) {
+        bool changed = m_level != FullQuality;
+        m_level = FullQuality;
+        m_blocksAbove = 0;
+        m_blocksBelow = 0;
+        return changed;
+    }
+    if (m_load > HIGH_LOAD) {
+        m_blocksBelow = 0;
+        if (++m_blocksAbove >= m_escalateBlocks && m_level < ReverbBypassed) {
+            m_level = Level(m_level + 1);
+            m_blocksAbove = 0;
+            return true;
+        }
+    } else if (m_load < LOW_LOAD) {
+        m_blocksAbove = 0;
+        if (++m_blocksBelow >= m_relaxBlocks && m_level > FullQuality) {
+            m_level = Level(m_level - 1);
+            m_blocksBelow = 0;
+            return true;
+        }
+    } else {
+        m_blocksAbove = 0;
+        m_blocksBelow = 0;
+    }
+    return false;
+}
+
+LoadGovernor::Level LoadGovernor::level() const
+{
+    return m_level;
+}
+
+double LoadGovernor::load() const
+{
+    return m_load;
+}
+
+QString LoadGovernor::levelName(int level)
+{
+    switch (level) {
+    case FullQuality:
+        return QStringLiteral("full quality");
+    case ReducedPolyphony:
+        return QStringLiteral("reduced polyphony");
+    case MinimalPolyphony:
+        return QStringLiteral("minimal polyphony");
+    case ChorusBypassed:
+        return QStringLiteral("chorus bypassed");
+    case ReverbBypassed:
+        return QStringLiteral("chorus and reverb bypassed");
+    }
+    return QString();
+}
@@ -0,0 +1,64 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef LOADGOVERNOR_H
+#define LOADGOVERNOR_H
+
+#include <QString>
+#include <QtGlobal>
+
+/*
+ * Tracks the time spent in EAS_Render against the duration of the rendered
+ * block, using an exponentially weighted moving average. The degradation
+ * level is raised one step at a time while the load stays above the high
+ * threshold, and lowered again only after a longer period below the low
+ * threshold, so the synth does not oscillate between quality levels.
+ */
+class LoadGovernor
+{
+public:
+    enum Level {
+        FullQuality = 0,
+        ReducedPolyphony,
+        MinimalPolyphony,
+        ChorusBypassed,
+        ReverbBypassed
+    };
+
+    LoadGovernor();
+
+    void reset(qint64 blockTime);
+    bool update(qint64 renderTime, bool adjust = true);
+
+    Level level() const;
+    double load() const;
+
+    static QString levelName(int level);
+
+private:
+    qint64 m_blockTime;
+    double m_load;
+    Level m_level;
+    int m_escalateBlocks;
+    int m_relaxBlocks;
+    int m_blocksAbove;
+    int m_blocksBelow;
+};
+
+#endif // LOADGOVERNOR_H
@@ -0,0 +1,133 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef MIDIPARSER_H
+#define MIDIPARSER_H
+
+#include <QtGlobal>
+
+/*
+ * Incremental parser for a raw MIDI byte stream. Messages may be split
+ * between reads, use running status, or have real time bytes interleaved.
+ * Every complete channel or system message is handed to the callback with
+ * its status byte, so several independent streams can be merged without
+ * corrupting each other. Real time messages are dropped, and system
+ * exclusive messages longer than MAX_SYSEX are discarded.
+ */
+class MidiParser
+{
+public:
+    static const int MAX_SYSEX = 256;
+
+    MidiParser() { reset(); }
+
+    void reset()
+    {
+        m_runningStatus = 0;
+        m_expected = 0;
+        m_count = 0;
+        m_sysexOverflow = false;
+    }
+
+    /* the callback is invoked as message(const quint8 *data, int length) */
+    template<typename F>
+    void parse(const quint8 *data, int length, F message)
+    {
+        for (int i = 0; i < length; ++i) {
+            quint8 byte = data[i];
+            if (byte >= 0xf8) {
+                continue;
+            }
+            if (byte & 0x80) {
+                if (byte == 0xf7 && m_runningStatus == 0xf0) {
+                    if (!m_sysexOverflow && m_count < MAX_SYSEX) {
+                        m_buffer[m_count++] = byte;
+                        message(static_cast<const quint8 *>(m_buffer), m_count);
+                    }
+                    m_runningStatus = 0;
+                    m_count = 0;
+                    continue;
+                }
+                m_buffer[0] = byte;
+                m_count = 1;
+                m_sysexOverflow = false;
+                m_expected = dataBytes(byte);
+                /* system messages cancel the running status */
+                m_runningStatus = byte < 0xf0 || byte == 0xf0 ? byte : 0;
+                if (m_expected == 0 && byte != 0xf0) {
+                    message(static_cast<const quint8 *>(m_buffer), 1);
+                    m_count = 0;
+                }
+                continue;
+            }
+            if (m_runningStatus == 0xf0) {
+                if (m_count < MAX_SYSEX) {
+                    m_buffer[m_count++] = byte;
+                } else {
+                    m_sysexOverflow = true;
+                }
+                continue;
+            }
+            if (m_count == 0) {
+                if (m_runningStatus == 0) {
+                    /* stray data byte without a status */
+                    continue;
+                }
+                m_buffer[0] = m_runningStatus;
+                m_count = 1;
+                m_expected = dataBytes(m_runningStatus);
+            }
+            m_buffer[m_count++] = byte;
+            if (m_count > m_expected) {
+                message(static_cast<const quint8 *>(m_buffer), m_count);
+                m_count = 0;
+            }
+        }
+    }
+
+private:
+    static int dataBytes(quint8 status)
+    {
+        switch (status & 0xf0) {
+        case 0xc0:
+        case 0xd0:
+            return 1;
+        case 0xf0:
+            switch (status) {
+            case 0xf1:
+            case 0xf3:
+                return 1;
+            case 0xf2:
+                return 2;
+            default:
+                return 0;
+            }
+        default:
+            return 2;
+        }
+    }
+
+    quint8 m_buffer[MAX_SYSEX];
+    quint8 m_runningStatus;
+    int m_expected;
+    int m_count;
+    bool m_sysexOverflow;
+};
+
+#endif // MIDIPARSER_H
@@ -0,0 +1,116 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QElapsedTimer>
+#include <QVector>
+#include <QtDebug>
+
+#include "offlinerenderer.h"
+#include "synthengine.h"
+#include "wavewriter.h"
+
+OfflineRenderer::OfflineRenderer(ProgramSettings *settings)
+    : m_settings(settings)
+    , m_realtimeFactor(0.0)
+    , m_cacheHit(false)
+{}
+
+bool OfflineRenderer::render(const QString &midiFile, const QString &waveFile)
+{
+    QElapsedTimer timer;
+    timer.start();
+    m_realtimeFactor = 0.0;
+    m_cacheHit = false;
+
+    SynthEngine engine;
+    RenderParameters params = RenderParameters::fromSettings(m_settings);
+    params.libVersion = engine.libVersion();
+    params.sampleRate = engine.sampleRate();
+    params.channels = engine.channels();
+
+    QString key;
+    WaveWriter wave;
+    if (m_settings->renderCache()) {
+        m_cache.setMaxSize(qint64(m_settings->renderCacheSize()) * 1024 * 1024);
+        key = m_cache.key(midiFile, params);
+        RenderCache::Reader reader;
+        if (m_cache.lookup(key, reader)) {
+            if (!wave.open(waveFile, reader.sampleRate(), reader.channels())) {
+                return false;
+            }
+            QVector<EAS_PCM> buffer(engine.bufferSize() * reader.channels());
+            int frames;
+            while ((frames = reader.read(buffer.data(), engine.bufferSize())) > 0) {
+                wave.write(buffer.data(), frames);
+            }
+            m_cacheHit = true;
+            m_realtimeFactor = double(wave.frames()) / reader.sampleRate()
+                               / qMax<qint64>(1, timer.nsecsElapsed()) * 1e9;
+            return wave.close();
+        }
+    }
+
+    if (!engine.init(m_settings->dlsSoundfont())) {
+        return false;
+    }
+    engine.initReverb(m_settings->reverbType());
+    engine.setReverbWet(m_settings->reverbWet());
+    engine.initChorus(m_settings->chorusType());
+    engine.setChorusLevel(m_settings->chorusLevel());
+    if (!engine.openFile(midiFile)) {
+        return false;
+    }
+    if (!wave.open(waveFile, engine.sampleRate(), engine.channels())) {
+        return false;
+    }
+    RenderCache::Writer writer;
+    if (!key.isEmpty()) {
+        m_cache.begin(key, writer, engine.sampleRate(), engine.channels());
+    }
+
+    QVector<EAS_PCM> buffer(engine.bufferSize() * engine.channels());
+    bool ok = true;
+    while (ok && !engine.playbackCompleted()) {
+        EAS_I32 numGen = engine.render(buffer.data());
+        if (numGen <= 0) {
+            break;
+        }
+        ok = wave.write(buffer.data(), numGen);
+        if (writer.isOpen() && !writer.write(buffer.data(), numGen)) {
+            writer.discard();
+        }
+    }
+    engine.closeFile();
+    if (ok && writer.isOpen()) {
+        m_cache.commit(writer);
+    }
+    m_realtimeFactor = double(wave.frames()) / engine.sampleRate()
+                       / qMax<qint64>(1, timer.nsecsElapsed()) * 1e9;
+    return wave.close() && ok;
+}
+
+double OfflineRenderer::realtimeFactor() const
+{
+    return m_realtimeFactor;
+}
+
+bool OfflineRenderer::cacheHit() const
+{
+    return m_cacheHit;
+}
@@ -0,0 +1,50 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef OFFLINERENDERER_H
+#define OFFLINERENDERER_H
+
+#include <QString>
+#include "programsettings.h"
+#include "rendercache.h"
+
+/*
+ * Renders MIDI files to WAV files as fast as possible, without ALSA or
+ * PulseAudio, using the soundfont and effect settings of a ProgramSettings
+ * object. Results are stored in the render cache when it is enabled, and
+ * repeated renders are copied from it.
+ */
+class OfflineRenderer
+{
+public:
+    explicit OfflineRenderer(ProgramSettings *settings = ProgramSettings::instance());
+
+    bool render(const QString &midiFile, const QString &waveFile);
+
+    double realtimeFactor() const;
+    bool cacheHit() const;
+
+private:
+    ProgramSettings *m_settings;
+    RenderCache m_cache;
+    double m_realtimeFactor;
+    bool m_cacheHit;
+};
+
+#endif // OFFLINERENDERER_H
@@ -0,0 +1,202 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QtDebug>
+#include <pulse/error.h>
+
+#include "portworker.h"
+#include "tracer.h"
+
+/* MIDI bytes buffered between two rendered blocks */
+static const size_t PORT_MIDI_BUFFER = 4096;
+
+PortWorker::PortWorker(int port, const QString &soundfont)
+    : m_port(port)
+    , m_soundfont(soundfont)
+    , m_midi(PORT_MIDI_BUFFER)
+    , m_frames(0)
+    , m_sink(nullptr)
+    , m_stopped(true)
+{
+}
+
+PortWorker::~PortWorker()
+{
+    stop();
+    m_engine.uninit();
+    if (m_sink != nullptr) {
+        pa_simple_free(m_sink);
+    }
+}
+
+bool
+PortWorker::init()
+{
+    if (!m_engine.init(m_soundfont)) {
+        return false;
+    }
+    m_buffer.resize(m_engine.bufferSize() * m_engine.channels());
+    m_controls.setup(m_engine);
+    return true;
+}
+
+void
+PortWorker::setSink(pa_simple *sink)
+{
+    m_sink = sink;
+}
+
+bool
+PortWorker::hasSink() const
+{
+    return m_sink != nullptr;
+}
+
+/* applied by the worker thread when it starts */
+void
+PortWorker::setSchedule(const ThreadSchedule &schedule)
+{
+    m_schedule = schedule;
+}
+
+void
+PortWorker::start()
+{
+    if (m_thread.joinable() || !m_engine.isValid()) {
+        return;
+    }
+    m_stopped = false;
+    m_thread = std::thread(&PortWorker::run, this);
+}
+
+void
+PortWorker::stop()
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+    m_stopped = true;
+    m_go.release();
+    m_thread.join();
+    /* leave the semaphores balanced for a later start() */
+    m_go.tryAcquire(m_go.available());
+    m_done.tryAcquire(m_done.available());
+}
+
+int
+PortWorker::port() const
+{
+    return m_port;
+}
+
+QString
+PortWorker::soundfont() const
+{
+    return m_soundfont;
+}
+
+/* a message is queued whole or not at all */
+bool
+PortWorker::writeMIDI(const quint8 *data, int count)
+{
+    if (m_midi.writeAvailable() < size_t(count)) {
+        return false;
+    }
+    m_midi.write(data, size_t(count));
+    return true;
+}
+
+void
+PortWorker::initReverb(int reverb_type)
+{
+    m_controls.initReverb(reverb_type);
+}
+
+void
+PortWorker::setReverbWet(int amount)
+{
+    m_controls.setReverbWet(amount);
+}
+
+void
+PortWorker::initChorus(int chorus_type)
+{
+    m_controls.initChorus(chorus_type);
+}
+
+void
+PortWorker::setChorusLevel(int amount)
+{
+    m_controls.setChorusLevel(amount);
+}
+
+void
+PortWorker::renderBlock()
+{
+    m_go.release();
+}
+
+int
+PortWorker::waitBlock(const EAS_PCM **buffer)
+{
+    m_done.acquire();
+    *buffer = m_buffer.constData();
+    return m_frames;
+}
+
+void
+PortWorker::applyControls()
+{
+    m_controls.apply(m_engine);
+
+    quint8 midi[256];
+    size_t count;
+    while ((count = m_midi.read(midi, sizeof(midi))) > 0) {
+        m_engine.writeMIDI(midi, EAS_I32(count));
+    }
+}
+
+void
+PortWorker::run()
+{
+    qDebug() << Q_FUNC_INFO << "port" << m_port << "started";
+    const size_t bytesPerFrame = sizeof(EAS_PCM) * m_engine.channels();
+    m_schedule.apply(QString("port %1").arg(m_port),
+                     qint64(m_engine.bufferSize()) * 1000000000 / m_engine.sampleRate());
+    for (;;) {
+        if (m_sink == nullptr) {
+            m_go.acquire();
+        }
+        if (m_stopped) {
+            break;
+        }
+        TRACE_SCOPE("PortWorker::run");
+        applyControls();
+        m_frames = m_engine.render(m_buffer.data());
+        if (m_sink == nullptr) {
+            m_done.release();
+        } else {
+            int pa_err;
+            if (pa_simple_write(m_sink, m_buffer.constData(), m_frames * bytesPerFrame, &pa_err) < 0) {
+                qWarning() << "Error writing to PulseAudio connection:" << pa_strerror(pa_err);
+            }
+        }
+    }
+    qDebug() << Q_FUNC_INFO << "port" << m_port << "ended";
+}
@@ -0,0 +1,89 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PORTWORKER_H
+#define PORTWORKER_H
+
+#include <QSemaphore>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <thread>
+#include <pulse/simple.h>
+#include "enginecontrols.h"
+#include "spscring.h"
+#include "synthengine.h"
+#include "threadschedule.h"
+
+/*
+ * An additional ALSA input port with its own EAS instance, rendered on its
+ * own thread. Without a sink the worker renders in lock step with the main
+ * render loop, one block per renderBlock()/waitBlock() pair, and the main
+ * loop mixes the result into its output. With a sink it runs freely and
+ * writes to its own PulseAudio stream.
+ */
+class PortWorker
+{
+public:
+    PortWorker(int port, const QString &soundfont);
+    ~PortWorker();
+
+    bool init();
+    void setSink(pa_simple *sink);
+    bool hasSink() const;
+    void setSchedule(const ThreadSchedule &schedule);
+    void start();
+    void stop();
+
+    int port() const;
+    QString soundfont() const;
+
+    /* producer side, called from the main render thread */
+    bool writeMIDI(const quint8 *data, int count);
+    void initReverb(int reverb_type);
+    void setReverbWet(int amount);
+    void initChorus(int chorus_type);
+    void setChorusLevel(int amount);
+
+    /* lock step mode */
+    void renderBlock();
+    int waitBlock(const EAS_PCM **buffer);
+
+private:
+    Q_DISABLE_COPY(PortWorker)
+
+    void run();
+    void applyControls();
+
+    int m_port;
+    QString m_soundfont;
+    SynthEngine m_engine;
+    SpscRing<quint8> m_midi;
+    EngineControls m_controls;
+    QVector<EAS_PCM> m_buffer;
+    int m_frames;
+    pa_simple *m_sink;
+    ThreadSchedule m_schedule;
+    std::thread m_thread;
+    std::atomic<bool> m_stopped;
+    QSemaphore m_go;
+    QSemaphore m_done;
+};
+
+#endif // PORTWORKER_H
@@ -0,0 +1,289 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QElapsedTimer>
+#include <QtDebug>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "previewmixer.h"
+#include "synthrenderer.h"
+#include "tracer.h"
+
+static const size_t PREVIEW_REQUESTS = 64;
+/* milliseconds between retries while the render thread has not taken the ready previews */
+static const int PREVIEW_POLL_TIME = 20;
+/* weight of the last block in the average render time of a preview, as 1/n */
+static const int PREVIEW_COST_SMOOTHING = 8;
+
+PreviewMixer::PreviewMixer()
+    : m_requests(PREVIEW_REQUESTS)
+    , m_ready(PREVIEW_REQUESTS)
+    , m_done(PREVIEW_REQUESTS + MAX_PREVIEWS)
+    , m_nextId(1)
+    , m_budget(0)
+    , m_cost(0)
+    , m_stopped(false)
+{
+    m_active.reserve(MAX_PREVIEWS);
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wakeFd < 0) {
+        qWarning() << "eventfd error:" << strerror(errno);
+    }
+}
+
+PreviewMixer::~PreviewMixer()
+{
+    if (m_thread.joinable()) {
+        m_stopped = true;
+        notify();
+        m_thread.join();
+    }
+    Request *request;
+    while (m_requests.pop(request)) {
+        delete request;
+    }
+    Ready ready;
+    while (m_ready.pop(ready)) {
+        delete ready.engine;
+    }
+    SynthEngine *engine;
+    while (m_done.pop(engine)) {
+        delete engine;
+    }
+    for (const Preview &preview : m_active) {
+        delete preview.engine;
+    }
+    qDeleteAll(m_idle);
+    if (m_wakeFd >= 0) {
+        ::close(m_wakeFd);
+    }
+}
+
+/* the budget is the time of a block the previews may use, in nanoseconds */
+void
+PreviewMixer::setup(int frames, int channels, qint64 budget)
+{
+    m_buffer.resize(frames * channels);
+    m_budget = budget;
+}
+
+/* returns the id of the new preview, or -1 when the request can't be queued */
+int
+PreviewMixer::start(const QString &fileName, double rate)
+{
+    /* the worker only exists once previews are used */
+    std::call_once(m_started, [this] { m_thread = std::thread(&PreviewMixer::run, this); });
+    Request *request = new Request{m_nextId.fetch_add(1), true, fileName, rate};
+    int id = request->id;
+    if (!m_requests.push(request)) {
+        delete request;
+        return -1;
+    }
+    notify();
+    return id;
+}
+
+void
+PreviewMixer::stop(int id)
+{
+    Request *request = new Request{id, false, QString(), 1.0};
+    if (!m_requests.push(request)) {
+        delete request;
+        return;
+    }
+    notify();
+}
+
+/* any thread, it never blocks */
+void
+PreviewMixer::notify()
+{
+    quint64 one = 1;
+    if (::write(m_wakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        qWarning() << "eventfd write error:" << strerror(errno);
+    }
+}
+
+/* worker thread */
+SynthEngine *
+PreviewMixer::takeEngine()
+{
+    if (!m_idle.isEmpty()) {
+        return m_idle.takeLast();
+    }
+    SynthEngine *engine = new SynthEngine;
+    if (!engine->init()) {
+        delete engine;
+        return nullptr;
+    }
+    engine->setPolyphony(PREVIEW_POLYPHONY);
+    engine->suspendReverb(true);
+    engine->suspendChorus(true);
+    return engine;
+}
+
+/* worker thread: opens the file, the render thread gets a preview ready to render */
+void
+PreviewMixer::prepare(const Request *request)
+{
+    Ready ready{request->id, nullptr, !request->start};
+    if (request->start) {
+        SynthEngine *engine = takeEngine();
+        if (engine != nullptr && engine->openFile(request->fileName)) {
+            if (request->rate != 1.0) {
+                engine->setPlaybackRate(request->rate);
+            }
+            ready.engine = engine;
+            qDebug() << Q_FUNC_INFO << "preview" << request->id << request->fileName;
+        } else if (engine != nullptr) {
+            m_idle.append(engine);
+        }
+    }
+    m_ready.push(ready);
+}
+
+void
+PreviewMixer::run()
+{
+    while (!m_stopped) {
+        /* finished previews are closed here, their files are freed off the render thread */
+        SynthEngine *engine;
+        while (m_done.pop(engine)) {
+            engine->closeFile();
+            m_idle.append(engine);
+        }
+        Request *request;
+        while (m_ready.writeAvailable() > 0 && m_requests.pop(request)) {
+            prepare(request);
+            delete request;
+        }
+        struct pollfd fd;
+        fd.fd = m_wakeFd;
+        fd.events = POLLIN;
+        fd.revents = 0;
+        int timeout = m_ready.writeAvailable() > 0 ? -1 : PREVIEW_POLL_TIME;
+        while (poll(&fd, 1, timeout) < 0 && errno == EINTR) { }
+        quint64 count;
+        while (::read(m_wakeFd, &count, sizeof(count)) > 0) { }
+    }
+}
+
+/* render thread: the engine goes back to the worker */
+void
+PreviewMixer::recycle(SynthEngine *engine)
+{
+    if (!m_done.push(engine)) {
+        /* every engine fits in the queue; if not, the preview is stopped but not recycled */
+        qWarning() << Q_FUNC_INFO << "preview engine lost";
+        return;
+    }
+    notify();
+}
+
+void
+PreviewMixer::release(int index, QVector<int> &finished)
+{
+    Preview preview = m_active.at(index);
+    m_active.remove(index);
+    finished.append(preview.id);
+    recycle(preview.engine);
+}
+
+void
+PreviewMixer::processRequests(QVector<int> &finished)
+{
+    Ready ready;
+    while (m_ready.pop(ready)) {
+        if (ready.stop) {
+            for (int i = m_active.count() - 1; i >= 0; --i) {
+                if (ready.id < 0 || m_active.at(i).id == ready.id) {
+                    release(i, finished);
+                }
+            }
+        } else if (ready.engine == nullptr) {
+            finished.append(ready.id);
+        } else if (!m_active.isEmpty() && !fits(qMin(m_active.count() + 1, MAX_PREVIEWS))) {
+            /* refused: it is reported as finished without playing */
+            qDebug() << Q_FUNC_INFO << "preview" << ready.id << "over the budget";
+            finished.append(ready.id);
+            recycle(ready.engine);
+        } else {
+            if (m_active.count() == MAX_PREVIEWS) {
+                /* the oldest preview makes room for the new one */
+                release(0, finished);
+            }
+            m_active.append(Preview{ready.id, ready.engine});
+        }
+    }
+}
+
+/* whether this many previews are expected to render within the budget */
+bool
+PreviewMixer::fits(int count) const
+{
+    return qint64(count) * m_cost <= m_budget;
+}
+
+void
+PreviewMixer::render(EAS_PCM *buffer, int frames, QVector<int> &finished)
+{
+    if (m_active.isEmpty()) {
+        return;
+    }
+    TRACE_SCOPE("PreviewMixer::render");
+    QElapsedTimer timer;
+    timer.start();
+    const int count = m_active.count();
+    for (const Preview &preview : m_active) {
+        EAS_I32 numGen = preview.engine->render(m_buffer.data());
+        SynthRenderer::mixSaturated(buffer, m_buffer.constData(),
+                                    qMin<int>(numGen, frames) * preview.engine->channels());
+    }
+    const qint64 cost = timer.nsecsElapsed() / count;
+    m_cost = m_cost == 0 ? cost : m_cost + (cost - m_cost) / PREVIEW_COST_SMOOTHING;
+    for (int i = m_active.count() - 1; i >= 0; --i) {
+        if (m_active.at(i).engine->playbackCompleted()) {
+            release(i, finished);
+        }
+    }
+    /* the previews got heavier: the oldest ones stop, the newest keeps playing */
+    while (m_active.count() > 1 && !fits(m_active.count())) {
+        release(0, finished);
+    }
+}
+
+bool
+PreviewMixer::isActive() const
+{
+    return !m_active.isEmpty();
+}
+
+/* render thread: the active previews are handed back to the worker */
+void
+PreviewMixer::clear()
+{
+    QVector<int> finished;
+    while (!m_active.isEmpty()) {
+        release(m_active.count() - 1, finished);
+    }
+}
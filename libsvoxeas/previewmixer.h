@@ -0,0 +1,112 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PREVIEWMIXER_H
+#define PREVIEWMIXER_H
+
+#include <QList>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "controlqueue.h"
+#include "spscring.h"
+#include "synthengine.h"
+
+/*
+ * Low cost file previews mixed into the live output. Each preview plays
+ * on a small EAS instance with limited polyphony, no effects and the built
+ * in wavetable, optionally faster than real time. A worker thread creates
+ * the instances, opens the files and recycles the instances of finished
+ * previews, so the render thread only takes ready previews from a queue.
+ * Every active preview is rendered in every block. A new preview is only
+ * admitted while the measured cost of the previews fits in their share of
+ * the block time, and the oldest one is stopped when they get heavier, so
+ * live synthesis keeps its deadline.
+ */
+class PreviewMixer
+{
+public:
+    static const int MAX_PREVIEWS = 4;
+    static const int PREVIEW_POLYPHONY = 16;
+
+    PreviewMixer();
+    ~PreviewMixer();
+
+    /* must be called before the render thread is started */
+    void setup(int frames, int channels, qint64 budget);
+
+    /* any thread */
+    int start(const QString &fileName, double rate = 1.0);
+    void stop(int id = -1);
+
+    /* render thread */
+    void processRequests(QVector<int> &finished);
+    void render(EAS_PCM *buffer, int frames, QVector<int> &finished);
+    bool isActive() const;
+    void clear();
+
+private:
+    Q_DISABLE_COPY(PreviewMixer)
+
+    struct Request {
+        int id;
+        bool start;
+        QString fileName;
+        double rate;
+    };
+
+    /* from the worker to the render thread: a ready preview, a failed one, or a stop */
+    struct Ready {
+        int id;
+        SynthEngine *engine;
+        bool stop;
+    };
+
+    struct Preview {
+        int id;
+        SynthEngine *engine;
+    };
+
+    void run();
+    void prepare(const Request *request);
+    SynthEngine *takeEngine();
+    void recycle(SynthEngine *engine);
+    void release(int index, QVector<int> &finished);
+    void notify();
+    bool fits(int count) const;
+
+    MpscQueue<Request *> m_requests;
+    SpscRing<Ready> m_ready;
+    SpscRing<SynthEngine *> m_done;
+    std::atomic<int> m_nextId;
+    QVector<Preview> m_active;
+    QList<SynthEngine *> m_idle;
+    QVector<EAS_PCM> m_buffer;
+    qint64 m_budget;
+    qint64 m_cost;
+
+    std::once_flag m_started;
+    std::thread m_thread;
+    std::atomic<bool> m_stopped;
+    int m_wakeFd;
+};
+
+#endif // PREVIEWMIXER_H
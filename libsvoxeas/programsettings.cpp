@@ -16,6 +16,10 @@
     along with this program. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <QThread>
+#include <QVariant>
+#include <QtDebug>
+
 #include "programsettings.h"
 
 ProgramSettings::ProgramSettings(QObject *parent) : QObject(parent)
@@ -32,12 +36,33 @@ ProgramSettings* ProgramSettings::instance()
 void ProgramSettings::ResetDefaults()
 {
     m_bufferTime = 60;
+    m_adaptiveLatency = false;
+    m_latencyFloor = 20;
+    m_latencyCeiling = 250;
+    m_idleSuspend = false;
+    m_compactSongs = false;
     m_reverbType = 1;
     m_reverbWet = 25800;
     m_chorusType = -1;
     m_chorusLevel = 0;
     m_DLSsoundfont.clear();
     m_ALSAConnection.clear();
+    m_loadGovernor = false;
+    m_renderCache = true;
+    m_renderCacheSize = 512;
+    m_inputPorts = 1;
+    m_portSoundfonts.clear();
+    m_separateOutputs = false;
+    m_renderAhead = 2000;
+    m_highPass = 0;
+    m_equalizer = QList<int>() << 0 << 0 << 0;
+    m_limiter = 0;
+    m_schedulingPolicy = "normal";
+    m_realtimePriority = 10;
+    m_renderCpus.clear();
+    m_workerCpus.clear();
+    m_lastSong.clear();
+    m_lastPosition = 0;
     emit ValuesChanged();
 }
 
@@ -70,24 +95,73 @@ void ProgramSettings::SaveToFile(const QString& filepath)
 void ProgramSettings::internalRead(QSettings &settings)
 {
     m_bufferTime = settings.value("BufferTime", 60).toInt();
+    m_adaptiveLatency = settings.value("AdaptiveLatency", false).toBool();
+    m_latencyFloor = settings.value("LatencyFloor", 20).toInt();
+    m_latencyCeiling = settings.value("LatencyCeiling", 250).toInt();
+    m_idleSuspend = settings.value("IdleSuspend", false).toBool();
+    m_compactSongs = settings.value("CompactSongs", false).toBool();
     m_reverbType = settings.value("ReverbType", 1).toInt();
     m_reverbWet = settings.value("ReverbWet", 25800).toInt();
     m_chorusType = settings.value("ChorusType", -1).toInt();
     m_chorusLevel = settings.value("ChorusLevel", 0).toInt();
     m_DLSsoundfont = settings.value("DLSsoundFont", QString()).toString();
     m_ALSAConnection = settings.value("ALSAConnection", QString()).toString();
+    m_loadGovernor = settings.value("LoadGovernor", false).toBool();
+    m_renderCache = settings.value("RenderCache", true).toBool();
+    m_renderCacheSize = settings.value("RenderCacheSize", 512).toInt();
+    m_inputPorts = settings.value("InputPorts", 1).toInt();
+    m_portSoundfonts = settings.value("PortSoundfonts", QStringList()).toStringList();
+    m_separateOutputs = settings.value("SeparateOutputs", false).toBool();
+    m_renderAhead = settings.value("RenderAhead", 2000).toInt();
+    m_highPass = settings.value("HighPass", 0).toInt();
+    m_equalizer.clear();
+    for (const QVariant &gain : settings.value("Equalizer", QVariantList() << 0 << 0 << 0).toList()) {
+        m_equalizer << gain.toInt();
+    }
+    m_limiter = settings.value("Limiter", 0).toInt();
+    m_schedulingPolicy = settings.value("SchedulingPolicy", "normal").toString();
+    m_realtimePriority = settings.value("RealtimePriority", 10).toInt();
+    m_renderCpus = settings.value("RenderCpus", QString()).toString();
+    m_workerCpus = settings.value("WorkerCpus", QString()).toString();
+    m_lastSong = settings.value("LastSong", QString()).toString();
+    m_lastPosition = settings.value("LastPosition", 0).toInt();
     emit ValuesChanged();
 }
 
 void ProgramSettings::internalSave(QSettings &settings)
 {
     settings.setValue("BufferTime", m_bufferTime);
+    settings.setValue("AdaptiveLatency", m_adaptiveLatency);
+    settings.setValue("LatencyFloor", m_latencyFloor);
+    settings.setValue("LatencyCeiling", m_latencyCeiling);
+    settings.setValue("IdleSuspend", m_idleSuspend);
+    settings.setValue("CompactSongs", m_compactSongs);
     settings.setValue("ReverbType", m_reverbType);
     settings.setValue("ReverbWet", m_reverbWet);
     settings.setValue("ChorusType", m_chorusType);
     settings.setValue("ChorusLevel", m_chorusLevel);
     settings.setValue("DLSsoundFont", m_DLSsoundfont);
     settings.setValue("ALSAConnection", m_ALSAConnection);
+    settings.setValue("LoadGovernor", m_loadGovernor);
+    settings.setValue("RenderCache", m_renderCache);
+    settings.setValue("RenderCacheSize", m_renderCacheSize);
+    settings.setValue("InputPorts", m_inputPorts);
+    settings.setValue("PortSoundfonts", m_portSoundfonts);
+    settings.setValue("SeparateOutputs", m_separateOutputs);
+    settings.setValue("RenderAhead", m_renderAhead);
+    settings.setValue("HighPass", m_highPass);
+    QVariantList equalizer;
+    for (int gain : m_equalizer) {
+        equalizer << gain;
+    }
+    settings.setValue("Equalizer", equalizer);
+    settings.setValue("Limiter", m_limiter);
+    settings.setValue("SchedulingPolicy", m_schedulingPolicy);
+    settings.setValue("RealtimePriority", m_realtimePriority);
+    settings.setValue("RenderCpus", m_renderCpus);
+    settings.setValue("WorkerCpus", m_workerCpus);
+    settings.setValue("LastSong", m_lastSong);
+    settings.setValue("LastPosition", m_lastPosition);
     settings.sync();
 }
 
@@ -101,6 +175,201 @@ void ProgramSettings::setALSAConnection(const QString &newALSAConnection)
     m_ALSAConnection = newALSAConnection;
 }
 
+bool ProgramSettings::loadGovernor() const
+{
+    return m_loadGovernor;
+}
+
+void ProgramSettings::setLoadGovernor(bool enabled)
+{
+    m_loadGovernor = enabled;
+}
+
+bool ProgramSettings::renderCache() const
+{
+    return m_renderCache;
+}
+
+void ProgramSettings::setRenderCache(bool enabled)
+{
+    m_renderCache = enabled;
+}
+
+int ProgramSettings::renderCacheSize() const
+{
+    return m_renderCacheSize;
+}
+
+void ProgramSettings::setRenderCacheSize(int megabytes)
+{
+    m_renderCacheSize = megabytes;
+}
+
+int ProgramSettings::inputPorts() const
+{
+    return m_inputPorts;
+}
+
+void ProgramSettings::setInputPorts(int ports)
+{
+    m_inputPorts = ports;
+}
+
+QStringList ProgramSettings::portSoundfonts() const
+{
+    return m_portSoundfonts;
+}
+
+void ProgramSettings::setPortSoundfonts(const QStringList &soundfonts)
+{
+    m_portSoundfonts = soundfonts;
+}
+
+/* the list starts with the second port, ports without an entry use the main soundfont */
+QString ProgramSettings::portSoundfont(int port) const
+{
+    QString soundfont = m_portSoundfonts.value(port - 2);
+    return soundfont.isEmpty() ? m_DLSsoundfont : soundfont;
+}
+
+bool ProgramSettings::separateOutputs() const
+{
+    return m_separateOutputs;
+}
+
+void ProgramSettings::setSeparateOutputs(bool separate)
+{
+    m_separateOutputs = separate;
+}
+
+/* milliseconds of file playback rendered ahead of the output, zero disables it */
+int ProgramSettings::renderAhead() const
+{
+    return m_renderAhead;
+}
+
+void ProgramSettings::setRenderAhead(int milliseconds)
+{
+    m_renderAhead = milliseconds;
+}
+
+/* cutoff frequency in Hz of the output high pass filter, zero disables it */
+int ProgramSettings::highPass() const
+{
+    return m_highPass;
+}
+
+void ProgramSettings::setHighPass(int frequency)
+{
+    m_highPass = frequency;
+}
+
+/* low shelf, mid and high shelf gains of the output equalizer, in dB */
+QList<int> ProgramSettings::equalizer() const
+{
+    return m_equalizer;
+}
+
+void ProgramSettings::setEqualizer(const QList<int> &gains)
+{
+    m_equalizer = gains;
+}
+
+/* output limiter threshold in dBFS, zero disables it */
+int ProgramSettings::limiter() const
+{
+    return m_limiter;
+}
+
+void ProgramSettings::setLimiter(int threshold)
+{
+    m_limiter = threshold;
+}
+
+/* normal, fifo, rr or deadline */
+QString ProgramSettings::schedulingPolicy() const
+{
+    return m_schedulingPolicy;
+}
+
+void ProgramSettings::setSchedulingPolicy(const QString &policy)
+{
+    m_schedulingPolicy = policy;
+}
+
+int ProgramSettings::realtimePriority() const
+{
+    return m_realtimePriority;
+}
+
+void ProgramSettings::setRealtimePriority(int priority)
+{
+    m_realtimePriority = priority;
+}
+
+/* CPU lists like "2,3" or "4-7", empty for no affinity */
+QString ProgramSettings::renderCpus() const
+{
+    return m_renderCpus;
+}
+
+void ProgramSettings::setRenderCpus(const QString &cpus)
+{
+    m_renderCpus = cpus;
+}
+
+QString ProgramSettings::workerCpus() const
+{
+    return m_workerCpus;
+}
+
+void ProgramSettings::setWorkerCpus(const QString &cpus)
+{
+    m_workerCpus = cpus;
+}
+
+ThreadSchedule ProgramSettings::renderSchedule() const
+{
+    ThreadSchedule schedule;
+    ThreadSchedule::Policy policy;
+    if (ThreadSchedule::parsePolicy(m_schedulingPolicy, &policy)) {
+        schedule.setPolicy(policy);
+    } else {
+        qWarning() << "Unknown scheduling policy:" << m_schedulingPolicy;
+    }
+    schedule.setPriority(m_realtimePriority);
+    QList<int> cpus;
+    if (ThreadSchedule::parseCpus(m_renderCpus, &cpus)) {
+        schedule.setCpus(cpus);
+    } else {
+        qWarning() << "Wrong CPU list:" << m_renderCpus;
+    }
+    return schedule;
+}
+
+/*
+ * Port workers render in step with the render thread, and share its policy.
+ * Threads inherit the affinity of the render thread, so without a list of
+ * their own they are kept off the CPUs reserved for it.
+ */
+ThreadSchedule ProgramSettings::workerSchedule() const
+{
+    ThreadSchedule schedule = renderSchedule();
+    QList<int> cpus;
+    if (!ThreadSchedule::parseCpus(m_workerCpus, &cpus)) {
+        qWarning() << "Wrong CPU list:" << m_workerCpus;
+    }
+    if (cpus.isEmpty() && !schedule.cpus().isEmpty()) {
+        for (int cpu = 0; cpu < QThread::idealThreadCount(); ++cpu) {
+            if (!schedule.cpus().contains(cpu)) {
+                cpus << cpu;
+            }
+        }
+    }
+    schedule.setCpus(cpus);
+    return schedule;
+}
+
 QString ProgramSettings::dlsSoundfont() const
 {
     return m_DLSsoundfont;
@@ -160,3 +429,77 @@ void ProgramSettings::setBufferTime(int bufferTime)
 {
     m_bufferTime = bufferTime;
 }
+
+/* when enabled, BufferTime is only the starting point */
+bool ProgramSettings::adaptiveLatency() const
+{
+    return m_adaptiveLatency;
+}
+
+void ProgramSettings::setAdaptiveLatency(bool enabled)
+{
+    m_adaptiveLatency = enabled;
+}
+
+int ProgramSettings::latencyFloor() const
+{
+    return m_latencyFloor;
+}
+
+void ProgramSettings::setLatencyFloor(int floor)
+{
+    m_latencyFloor = floor;
+}
+
+int ProgramSettings::latencyCeiling() const
+{
+    return m_latencyCeiling;
+}
+
+void ProgramSettings::setLatencyCeiling(int ceiling)
+{
+    m_latencyCeiling = ceiling;
+}
+
+/* stop rendering after a while without MIDI input or playback */
+bool ProgramSettings::idleSuspend() const
+{
+    return m_idleSuspend;
+}
+
+void ProgramSettings::setIdleSuspend(bool enabled)
+{
+    m_idleSuspend = enabled;
+}
+
+/* play MIDI files from their compiled event arrays, see SynthEngine::setCompactSongs() */
+bool ProgramSettings::compactSongs() const
+{
+    return m_compactSongs;
+}
+
+void ProgramSettings::setCompactSongs(bool enabled)
+{
+    m_compactSongs = enabled;
+}
+
+/* the song open when the program was closed, and where its playback was, to resume it */
+QString ProgramSettings::lastSong() const
+{
+    return m_lastSong;
+}
+
+void ProgramSettings::setLastSong(const QString &fileName)
+{
+    m_lastSong = fileName;
+}
+
+int ProgramSettings::lastPosition() const
+{
+    return m_lastPosition;
+}
+
+void ProgramSettings::setLastPosition(int milliseconds)
+{
+    m_lastPosition = milliseconds;
+}
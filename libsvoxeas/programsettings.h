@@ -19,20 +19,40 @@
 #ifndef PROGRAMSETTINGS_H
 #define PROGRAMSETTINGS_H
 
+#include <QList>
 #include <QObject>
 #include <QString>
+#include <QStringList>
 #include <QSettings>
+#include "threadschedule.h"
 
 class ProgramSettings : public QObject
 {
     Q_OBJECT
 
 public:
+    /* the application settings; other objects are for SynthPool instances */
     static ProgramSettings* instance();
+    explicit ProgramSettings(QObject *parent = nullptr);
 
     int bufferTime() const;
     void setBufferTime(int bufferTime);
 
+    bool adaptiveLatency() const;
+    void setAdaptiveLatency(bool enabled);
+
+    int latencyFloor() const;
+    void setLatencyFloor(int floor);
+
+    int latencyCeiling() const;
+    void setLatencyCeiling(int ceiling);
+
+    bool idleSuspend() const;
+    void setIdleSuspend(bool enabled);
+
+    bool compactSongs() const;
+    void setCompactSongs(bool enabled);
+
     int reverbType() const;
     void setReverbType(int reverbType);
 
@@ -51,6 +71,58 @@ public:
     QString ALSAConnection() const;
     void setALSAConnection(const QString &newALSAConnection);
 
+    bool loadGovernor() const;
+    void setLoadGovernor(bool enabled);
+
+    bool renderCache() const;
+    void setRenderCache(bool enabled);
+
+    int renderCacheSize() const;
+    void setRenderCacheSize(int megabytes);
+
+    int inputPorts() const;
+    void setInputPorts(int ports);
+
+    QStringList portSoundfonts() const;
+    void setPortSoundfonts(const QStringList &soundfonts);
+    QString portSoundfont(int port) const;
+
+    bool separateOutputs() const;
+    void setSeparateOutputs(bool separate);
+
+    int renderAhead() const;
+    void setRenderAhead(int milliseconds);
+
+    int highPass() const;
+    void setHighPass(int frequency);
+
+    QList<int> equalizer() const;
+    void setEqualizer(const QList<int> &gains);
+
+    int limiter() const;
+    void setLimiter(int threshold);
+
+    QString schedulingPolicy() const;
+    void setSchedulingPolicy(const QString &policy);
+
+    int realtimePriority() const;
+    void setRealtimePriority(int priority);
+
+    QString renderCpus() const;
+    void setRenderCpus(const QString &cpus);
+
+    QString workerCpus() const;
+    void setWorkerCpus(const QString &cpus);
+
+    QString lastSong() const;
+    void setLastSong(const QString &fileName);
+
+    int lastPosition() const;
+    void setLastPosition(int milliseconds);
+
+    ThreadSchedule renderSchedule() const;
+    ThreadSchedule workerSchedule() const;
+
 signals:
     void ValuesChanged();
 
@@ -62,17 +134,37 @@ public slots:
     void SaveToFile(const QString &filepath);
 
 private:
-    explicit ProgramSettings(QObject *parent = nullptr);
     void internalRead(QSettings& settings);
     void internalSave(QSettings& settings);
 
     int m_bufferTime;
+    bool m_adaptiveLatency;
+    int m_latencyFloor;
+    int m_latencyCeiling;
+    bool m_idleSuspend;
+    bool m_compactSongs;
     int m_reverbType;
     int m_reverbWet;
     int m_chorusType;
     int m_chorusLevel;
     QString m_DLSsoundfont;
     QString m_ALSAConnection;
+    bool m_loadGovernor;
+    bool m_renderCache;
+    int m_renderCacheSize;
+    int m_inputPorts;
+    QStringList m_portSoundfonts;
+    bool m_separateOutputs;
+    int m_renderAhead;
+    int m_highPass;
+    QList<int> m_equalizer;
+    int m_limiter;
+    QString m_schedulingPolicy;
+    int m_realtimePriority;
+    QString m_renderCpus;
+    QString m_workerCpus;
+    QString m_lastSong;
+    int m_lastPosition;
 };
 
 #endif // PROGRAMSETTINGS_H
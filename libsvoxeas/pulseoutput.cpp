@@ -0,0 +1,289 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QDebug>
+#include "pulseoutput.h"
+
+PulseOutput::PulseOutput()
+    : m_mainloop(nullptr)
+    , m_context(nullptr)
+    , m_stream(nullptr)
+    , m_underflows(0)
+{
+}
+
+PulseOutput::~PulseOutput()
+{
+    close();
+}
+
+/* blocks until the stream is ready, bufferTime in milliseconds */
+bool
+PulseOutput::open(const char *streamName, int sampleRate, int channels, int bufferTime, int *err)
+{
+    pa_buffer_attr bufattr;
+
+    m_spec.format = PA_SAMPLE_S16LE;
+    m_spec.channels = channels;
+    m_spec.rate = sampleRate;
+
+    *err = PA_OK;
+    m_mainloop = pa_threaded_mainloop_new();
+    if (m_mainloop == nullptr) {
+        *err = PA_ERR_INTERNAL;
+        return false;
+    }
+    m_context = pa_context_new(pa_threaded_mainloop_get_api(m_mainloop), "SonivoxEAS");
+    if (m_context == nullptr) {
+        *err = PA_ERR_INTERNAL;
+        close();
+        return false;
+    }
+    pa_context_set_state_callback(m_context, contextStateCallback, this);
+    if (pa_context_connect(m_context, nullptr, PA_CONTEXT_NOFLAGS, nullptr) < 0) {
+        *err = pa_context_errno(m_context);
+        close();
+        return false;
+    }
+
+    pa_threaded_mainloop_lock(m_mainloop);
+    if (pa_threaded_mainloop_start(m_mainloop) < 0) {
+        *err = PA_ERR_INTERNAL;
+        pa_threaded_mainloop_unlock(m_mainloop);
+        close();
+        return false;
+    }
+    if (!waitForContext(err)) {
+        pa_threaded_mainloop_unlock(m_mainloop);
+        close();
+        return false;
+    }
+    m_stream = pa_stream_new(m_context, streamName, &m_spec, nullptr);
+    if (m_stream == nullptr) {
+        *err = pa_context_errno(m_context);
+        pa_threaded_mainloop_unlock(m_mainloop);
+        close();
+        return false;
+    }
+    pa_stream_set_state_callback(m_stream, streamStateCallback, this);
+    pa_stream_set_write_callback(m_stream, streamRequestCallback, this);
+    pa_stream_set_latency_update_callback(m_stream, streamLatencyCallback, this);
+    pa_stream_set_underflow_callback(m_stream, streamUnderflowCallback, this);
+
+    bufattr.maxlength = (uint32_t)-1;
+    bufattr.tlength = pa_usec_to_bytes(pa_usec_t(bufferTime) * 1000, &m_spec);
+    bufattr.minreq = (uint32_t)-1;
+    bufattr.prebuf = (uint32_t)-1;
+    bufattr.fragsize = (uint32_t)-1;
+    qDebug() << Q_FUNC_INFO << "tlength:" << bufattr.tlength;
+
+    pa_stream_flags_t flags = pa_stream_flags_t(PA_STREAM_INTERPOLATE_TIMING |
+                                                PA_STREAM_ADJUST_LATENCY |
+                                                PA_STREAM_AUTO_TIMING_UPDATE);
+    if (pa_stream_connect_playback(m_stream, nullptr, &bufattr, flags, nullptr, nullptr) < 0 ||
+        !waitForStream(err)) {
+        if (*err == PA_OK) {
+            *err = pa_context_errno(m_context);
+        }
+        pa_threaded_mainloop_unlock(m_mainloop);
+        close();
+        return false;
+    }
+    pa_threaded_mainloop_unlock(m_mainloop);
+    return true;
+}
+
+void
+PulseOutput::close()
+{
+    if (m_mainloop != nullptr) {
+        pa_threaded_mainloop_stop(m_mainloop);
+    }
+    if (m_stream != nullptr) {
+        pa_stream_disconnect(m_stream);
+        pa_stream_unref(m_stream);
+        m_stream = nullptr;
+    }
+    if (m_context != nullptr) {
+        pa_context_disconnect(m_context);
+        pa_context_unref(m_context);
+        m_context = nullptr;
+    }
+    if (m_mainloop != nullptr) {
+        pa_threaded_mainloop_free(m_mainloop);
+        m_mainloop = nullptr;
+    }
+}
+
+/* called with the mainloop locked */
+bool
+PulseOutput::waitForContext(int *err)
+{
+    for (;;) {
+        pa_context_state_t state = pa_context_get_state(m_context);
+        if (state == PA_CONTEXT_READY) {
+            return true;
+        }
+        if (!PA_CONTEXT_IS_GOOD(state)) {
+            *err = pa_context_errno(m_context);
+            return false;
+        }
+        pa_threaded_mainloop_wait(m_mainloop);
+    }
+}
+
+/* called with the mainloop locked */
+bool
+PulseOutput::waitForStream(int *err)
+{
+    for (;;) {
+        pa_stream_state_t state = pa_stream_get_state(m_stream);
+        if (state == PA_STREAM_READY) {
+            return true;
+        }
+        if (!PA_STREAM_IS_GOOD(state)) {
+            *err = pa_context_errno(m_context);
+            return false;
+        }
+        pa_threaded_mainloop_wait(m_mainloop);
+    }
+}
+
+/* render thread, waits for room in the stream like pa_simple_write() */
+bool
+PulseOutput::write(const void *data, size_t bytes, int *err)
+{
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    *err = PA_OK;
+    pa_threaded_mainloop_lock(m_mainloop);
+    while (bytes > 0) {
+        size_t length;
+        while ((length = pa_stream_writable_size(m_stream)) == 0) {
+            if (pa_stream_get_state(m_stream) != PA_STREAM_READY) {
+                break;
+            }
+            pa_threaded_mainloop_wait(m_mainloop);
+        }
+        if (length == 0 || length == size_t(-1)) {
+            *err = pa_context_errno(m_context);
+            pa_threaded_mainloop_unlock(m_mainloop);
+            return false;
+        }
+        length = qMin(length, bytes);
+        if (pa_stream_write(m_stream, p, length, nullptr, 0, PA_SEEK_RELATIVE) < 0) {
+            *err = pa_context_errno(m_context);
+            pa_threaded_mainloop_unlock(m_mainloop);
+            return false;
+        }
+        p += length;
+        bytes -= length;
+    }
+    pa_threaded_mainloop_unlock(m_mainloop);
+    return true;
+}
+
+/*
+ * The new target length is sent to the server and the call returns at once,
+ * the audio already queued in the stream keeps playing.
+ */
+bool
+PulseOutput::setBufferTime(int bufferTime)
+{
+    pa_buffer_attr bufattr;
+    bufattr.maxlength = (uint32_t)-1;
+    bufattr.tlength = pa_usec_to_bytes(pa_usec_t(bufferTime) * 1000, &m_spec);
+    bufattr.minreq = (uint32_t)-1;
+    bufattr.prebuf = (uint32_t)-1;
+    bufattr.fragsize = (uint32_t)-1;
+
+    pa_threaded_mainloop_lock(m_mainloop);
+    pa_operation *op = pa_stream_set_buffer_attr(m_stream, &bufattr, nullptr, nullptr);
+    if (op == nullptr) {
+        qWarning() << Q_FUNC_INFO << pa_strerror(pa_context_errno(m_context));
+        pa_threaded_mainloop_unlock(m_mainloop);
+        return false;
+    }
+    pa_operation_unref(op);
+    pa_threaded_mainloop_unlock(m_mainloop);
+    return true;
+}
+
+/* interpolated from the last timing update, in microseconds, or -1 if not known yet */
+qint64
+PulseOutput::latency()
+{
+    pa_usec_t usec;
+    int negative = 0;
+    qint64 result = -1;
+    pa_threaded_mainloop_lock(m_mainloop);
+    if (pa_stream_get_latency(m_stream, &usec, &negative) >= 0) {
+        result = negative ? 0 : qint64(usec);
+    }
+    pa_threaded_mainloop_unlock(m_mainloop);
+    return result;
+}
+
+/* number of times the server ran out of data since the stream was opened */
+quint32
+PulseOutput::underflows() const
+{
+    return m_underflows.load(std::memory_order_relaxed);
+}
+
+void
+PulseOutput::contextStateCallback(pa_context *context, void *userdata)
+{
+    Q_UNUSED(context)
+    PulseOutput *self = static_cast<PulseOutput *>(userdata);
+    pa_threaded_mainloop_signal(self->m_mainloop, 0);
+}
+
+void
+PulseOutput::streamStateCallback(pa_stream *stream, void *userdata)
+{
+    Q_UNUSED(stream)
+    PulseOutput *self = static_cast<PulseOutput *>(userdata);
+    pa_threaded_mainloop_signal(self->m_mainloop, 0);
+}
+
+void
+PulseOutput::streamRequestCallback(pa_stream *stream, size_t bytes, void *userdata)
+{
+    Q_UNUSED(stream)
+    Q_UNUSED(bytes)
+    PulseOutput *self = static_cast<PulseOutput *>(userdata);
+    pa_threaded_mainloop_signal(self->m_mainloop, 0);
+}
+
+void
+PulseOutput::streamLatencyCallback(pa_stream *stream, void *userdata)
+{
+    Q_UNUSED(stream)
+    PulseOutput *self = static_cast<PulseOutput *>(userdata);
+    pa_threaded_mainloop_signal(self->m_mainloop, 0);
+}
+
+/* mainloop thread */
+void
+PulseOutput::streamUnderflowCallback(pa_stream *stream, void *userdata)
+{
+    Q_UNUSED(stream)
+    PulseOutput *self = static_cast<PulseOutput *>(userdata);
+    self->m_underflows.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,63 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PULSEOUTPUT_H
+#define PULSEOUTPUT_H
+
+#include <atomic>
+#include <QtGlobal>
+#include <pulse/pulseaudio.h>
+
+/*
+ * Playback stream of the main output, on the asynchronous PulseAudio API.
+ * Writes block like pa_simple_write(), but the server reports underflows
+ * through a callback, and the buffer time may be changed on the running
+ * stream, without reopening or draining it.
+ */
+class PulseOutput
+{
+public:
+    PulseOutput();
+    ~PulseOutput();
+
+    bool open(const char *streamName, int sampleRate, int channels, int bufferTime, int *err);
+    void close();
+    bool write(const void *data, size_t bytes, int *err);
+    bool setBufferTime(int bufferTime);
+    qint64 latency();
+    quint32 underflows() const;
+
+private:
+    bool waitForContext(int *err);
+    bool waitForStream(int *err);
+
+    static void contextStateCallback(pa_context *context, void *userdata);
+    static void streamStateCallback(pa_stream *stream, void *userdata);
+    static void streamRequestCallback(pa_stream *stream, size_t bytes, void *userdata);
+    static void streamLatencyCallback(pa_stream *stream, void *userdata);
+    static void streamUnderflowCallback(pa_stream *stream, void *userdata);
+
+    pa_threaded_mainloop *m_mainloop;
+    pa_context *m_context;
+    pa_stream *m_stream;
+    pa_sample_spec m_spec;
+    std::atomic<quint32> m_underflows;
+};
+
+#endif // PULSEOUTPUT_H
@@ -0,0 +1,181 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QFileInfo>
+#include <QtDebug>
+
+#include <alsa/asoundlib.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "rawmidiinput.h"
+
+RawMidiInput::RawMidiInput()
+    : m_type(NoSource)
+    , m_rawmidi(nullptr)
+    , m_fd(-1)
+    , m_stdinFlags(-1)
+{
+}
+
+RawMidiInput::~RawMidiInput()
+{
+    close();
+}
+
+bool
+RawMidiInput::open(const QString &source)
+{
+    close();
+    if (source == "-") {
+        int flags = fcntl(STDIN_FILENO, F_GETFL);
+        if (flags < 0 || fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK) < 0) {
+            qWarning() << "Can't read MIDI from the standard input:" << strerror(errno);
+            return false;
+        }
+        /* the flags belong to the open file description shared with the parent shell */
+        m_stdinFlags = flags;
+        m_fd = STDIN_FILENO;
+        m_type = StandardInput;
+    } else if (QFileInfo::exists(source)) {
+        QByteArray path = QFile::encodeName(source);
+        /* O_RDWR keeps a FIFO open when the last writer goes away */
+        m_fd = ::open(path.constData(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (m_fd < 0) {
+            m_fd = ::open(path.constData(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        }
+        if (m_fd < 0) {
+            qWarning() << "Can't open MIDI input" << source << ":" << strerror(errno);
+            return false;
+        }
+        m_type = FileSource;
+    } else {
+        int err = snd_rawmidi_open(&m_rawmidi, nullptr, source.toLocal8Bit().constData(),
+                                   SND_RAWMIDI_NONBLOCK);
+        if (err < 0) {
+            qWarning() << "snd_rawmidi_open" << source << "error:" << snd_strerror(err);
+            m_rawmidi = nullptr;
+            return false;
+        }
+        m_type = RawMidiDevice;
+    }
+    m_source = source;
+    m_parser.reset();
+    qDebug() << Q_FUNC_INFO << source << m_type;
+    return true;
+}
+
+void
+RawMidiInput::close()
+{
+    if (m_rawmidi != nullptr) {
+        snd_rawmidi_close(m_rawmidi);
+        m_rawmidi = nullptr;
+    }
+    if (m_fd >= 0 && m_type == FileSource) {
+        ::close(m_fd);
+    }
+    if (m_stdinFlags >= 0) {
+        if (fcntl(STDIN_FILENO, F_SETFL, m_stdinFlags) < 0) {
+            qWarning() << "Can't restore the standard input flags:" << strerror(errno);
+        }
+        m_stdinFlags = -1;
+    }
+    m_fd = -1;
+    m_type = NoSource;
+}
+
+bool
+RawMidiInput::isOpen() const
+{
+    return m_type != NoSource;
+}
+
+QString
+RawMidiInput::source() const
+{
+    return m_source;
+}
+
+RawMidiInput::SourceType
+RawMidiInput::type() const
+{
+    return m_type;
+}
+
+/* fills the descriptors to wait for input on, returns how many were used */
+int
+RawMidiInput::pollDescriptors(struct pollfd *fds, int space) const
+{
+    if (m_rawmidi != nullptr) {
+        return qMax(0, snd_rawmidi_poll_descriptors(m_rawmidi, fds, uint(space)));
+    }
+    if (m_fd >= 0 && space > 0) {
+        fds[0].fd = m_fd;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        return 1;
+    }
+    return 0;
+}
+
+/* returns the number of bytes available without waiting, or -1 when the input is gone */
+int
+RawMidiInput::read(quint8 *buffer, int size)
+{
+    if (m_rawmidi != nullptr) {
+        ssize_t res = snd_rawmidi_read(m_rawmidi, buffer, size);
+        if (res == -EAGAIN) {
+            return 0;
+        }
+        if (res < 0) {
+            qWarning() << "snd_rawmidi_read" << m_source << "error:" << snd_strerror(int(res));
+            close();
+            return -1;
+        }
+        return int(res);
+    }
+    if (m_fd >= 0) {
+        ssize_t res = ::read(m_fd, buffer, size_t(size));
+        if (res < 0) {
+            if (errno == EAGAIN || errno == EINTR) {
+                return 0;
+            }
+            qWarning() << "MIDI input" << m_source << "error:" << strerror(errno);
+            close();
+            return -1;
+        }
+        if (res == 0) {
+            /* end of file, or the standard input was closed */
+            qDebug() << Q_FUNC_INFO << m_source << "closed";
+            close();
+            return -1;
+        }
+        return int(res);
+    }
+    return -1;
+}
+
+MidiParser &
+RawMidiInput::parser()
+{
+    return m_parser;
+}
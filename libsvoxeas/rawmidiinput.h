@@ -0,0 +1,70 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef RAWMIDIINPUT_H
+#define RAWMIDIINPUT_H
+
+#include <QString>
+#include <QtGlobal>
+#include <poll.h>
+#include "midiparser.h"
+
+typedef struct _snd_rawmidi snd_rawmidi_t;
+
+/*
+ * A raw MIDI byte stream read without blocking: an ALSA rawmidi device
+ * ("hw:1,0,0", "virtual", ...), a named pipe or any other file path, or
+ * the standard input ("-"). Named pipes are opened for reading and writing
+ * so they survive writers coming and going.
+ */
+class RawMidiInput
+{
+public:
+    enum SourceType {
+        NoSource,
+        RawMidiDevice,
+        FileSource,
+        StandardInput
+    };
+
+    RawMidiInput();
+    ~RawMidiInput();
+
+    bool open(const QString &source);
+    void close();
+    bool isOpen() const;
+    QString source() const;
+    SourceType type() const;
+
+    int read(quint8 *buffer, int size);
+    int pollDescriptors(struct pollfd *fds, int space) const;
+    MidiParser &parser();
+
+private:
+    Q_DISABLE_COPY(RawMidiInput)
+
+    QString m_source;
+    SourceType m_type;
+    snd_rawmidi_t *m_rawmidi;
+    int m_fd;
+    int m_stdinFlags;
+    MidiParser m_parser;
+};
+
+#endif // RAWMIDIINPUT_H
@@ -0,0 +1,465 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtDebug>
+#include <QtEndian>
+#include <cstring>
+
+#include "programsettings.h"
+#include "rendercache.h"
+#include "synthengine.h"
+
+static const quint32 CACHE_MAGIC = 0x31435653; /* "SVC1" */
+static const int CACHE_HEADER_SIZE = 20;
+static const int CHUNK_FRAMES = 8192;
+static const char *CACHE_SUFFIX = ".svc";
+static const qint64 DEFAULT_MAX_SIZE = Q_INT64_C(512) * 1024 * 1024;
+
+RenderParameters::RenderParameters()
+    : reverbType(-1)
+    , reverbWet(0)
+    , chorusType(-1)
+    , chorusLevel(0)
+    , compactSongs(false)
+    , libVersion(0)
+    , sampleRate(0)
+    , channels(0)
+{}
+
+RenderParameters RenderParameters::fromSettings(const ProgramSettings *settings)
+{
+    RenderParameters params;
+    params.soundfont = settings->dlsSoundfont();
+    params.reverbType = settings->reverbType();
+    params.reverbWet = settings->reverbWet();
+    params.chorusType = settings->chorusType();
+    params.chorusLevel = settings->chorusLevel();
+    /* the engines follow the process wide selection, not the settings object */
+    params.compactSongs = SynthEngine::compactSongs();
+    return params;
+}
+
+RenderCache::Reader::Reader()
+    : m_chunkPos(0)
+    , m_position(0)
+    , m_frames(0)
+    , m_sampleRate(0)
+    , m_channels(0)
+{}
+
+bool RenderCache::Reader::open(const QString &fileName)
+{
+    close();
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QByteArray header = m_file.read(CACHE_HEADER_SIZE);
+    const uchar *h = reinterpret_cast<const uchar *>(header.constData());
+    if (header.size() != CACHE_HEADER_SIZE || qFromLittleEndian<quint32>(h) != CACHE_MAGIC) {
+        qWarning() << "Invalid render cache entry" << fileName;
+        m_file.close();
+        return false;
+    }
+    m_sampleRate = int(qFromLittleEndian<quint32>(h + 4));
+    m_channels = int(qFromLittleEndian<quint32>(h + 8));
+    m_frames = qint64(qFromLittleEndian<quint64>(h + 12));
+    m_position = 0;
+    m_chunk.clear();
+    m_chunkPos = 0;
+    return m_channels > 0;
+}
+
+void RenderCache::Reader::close()
+{
+    m_file.close();
+    m_chunk.clear();
+    m_chunkPos = 0;
+    m_position = 0;
+    m_frames = 0;
+}
+
+bool RenderCache::Reader::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+bool RenderCache::Reader::readChunk()
+{
+    uchar size[4];
+    if (m_file.read(reinterpret_cast<char *>(size), 4) != 4) {
+        return false;
+    }
+    QByteArray compressed = m_file.read(qFromLittleEndian<quint32>(size));
+    m_chunk = qUncompress(compressed);
+    m_chunkPos = 0;
+    return !m_chunk.isEmpty();
+}
+
+int RenderCache::Reader::read(EAS_PCM *buffer, int frames)
+{
+    int frameBytes = m_channels * int(sizeof(EAS_PCM));
+    int done = 0;
+    while (done < frames && m_position < m_frames) {
+        if (m_chunkPos >= m_chunk.size() && !readChunk()) {
+            qWarning() << "Truncated render cache entry" << m_file.fileName();
+            m_frames = m_position;
+            break;
+        }
+        int count = qMin(frames - done, (m_chunk.size() - m_chunkPos) / frameBytes);
+        if (count <= 0) {
+            break;
+        }
+        const char *src = m_chunk.constData() + m_chunkPos;
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+        qFromLittleEndian<qint16>(src, count * m_channels, buffer + done * m_channels);
+#else
+        memcpy(buffer + done * m_channels, src, count * frameBytes);
+#endif
+        m_chunkPos += count * frameBytes;
+        m_position += count;
+        done += count;
+    }
+    return done;
+}
+
+/* chunks before the target are skipped unread: qCompress() stores the uncompressed size first */
+bool RenderCache::Reader::seek(qint64 frame)
+{
+    const int frameBytes = m_channels * int(sizeof(EAS_PCM));
+    frame = qBound(Q_INT64_C(0), frame, m_frames);
+    qint64 chunkStart = m_position - m_chunkPos / frameBytes;
+    const qint64 chunkEnd = chunkStart + m_chunk.size() / frameBytes;
+    if (frame >= chunkStart && frame < chunkEnd) {
+        m_chunkPos = int(frame - chunkStart) * frameBytes;
+        m_position = frame;
+        return true;
+    }
+    /* the file is past the current chunk, unless the target is before it */
+    if (frame < chunkStart) {
+        if (!m_file.seek(CACHE_HEADER_SIZE)) {
+            return false;
+        }
+        chunkStart = 0;
+    } else {
+        chunkStart = chunkEnd;
+    }
+    m_chunk.clear();
+    m_chunkPos = 0;
+    while (chunkStart < frame) {
+        uchar header[8];
+        if (m_file.read(reinterpret_cast<char *>(header), 8) != 8) {
+            qWarning() << "Truncated render cache entry" << m_file.fileName();
+            m_frames = m_position = chunkStart;
+            return false;
+        }
+        const qint64 frames = qFromBigEndian<quint32>(header + 4) / frameBytes;
+        if (frame < chunkStart + frames) {
+            if (!m_file.seek(m_file.pos() - 8) || !readChunk()) {
+                return false;
+            }
+            m_chunkPos = int(frame - chunkStart) * frameBytes;
+            break;
+        }
+        if (!m_file.seek(m_file.pos() + qFromLittleEndian<quint32>(header) - 4)) {
+            return false;
+        }
+        chunkStart += frames;
+    }
+    m_position = frame;
+    return true;
+}
+
+bool RenderCache::Reader::atEnd() const
+{
+    return m_position >= m_frames;
+}
+
+qint64 RenderCache::Reader::position() const
+{
+    return m_position;
+}
+
+qint64 RenderCache::Reader::frames() const
+{
+    return m_frames;
+}
+
+int RenderCache::Reader::sampleRate() const
+{
+    return m_sampleRate;
+}
+
+int RenderCache::Reader::channels() const
+{
+    return m_channels;
+}
+
+RenderCache::Writer::Writer()
+    : m_frames(0)
+    , m_channels(0)
+{}
+
+RenderCache::Writer::~Writer()
+{
+    discard();
+}
+
+bool RenderCache::Writer::open(const QString &fileName, int sampleRate, int channels)
+{
+    discard();
+    /* QSaveFile writes to a unique temporary file, so concurrent writers of a key do not mix */
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to create render cache entry" << fileName;
+        return false;
+    }
+    m_channels = channels;
+    m_frames = 0;
+    m_pending.clear();
+    uchar header[CACHE_HEADER_SIZE];
+    qToLittleEndian<quint32>(CACHE_MAGIC, header);
+    qToLittleEndian<quint32>(quint32(sampleRate), header + 4);
+    qToLittleEndian<quint32>(quint32(channels), header + 8);
+    qToLittleEndian<quint64>(0, header + 12);
+    return m_file.write(reinterpret_cast<const char *>(header), CACHE_HEADER_SIZE) == CACHE_HEADER_SIZE;
+}
+
+bool RenderCache::Writer::write(const EAS_PCM *buffer, int frames)
+{
+    if (!m_file.isOpen()) {
+        return false;
+    }
+    int bytes = frames * m_channels * int(sizeof(EAS_PCM));
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    int offset = m_pending.size();
+    m_pending.resize(offset + bytes);
+    qToLittleEndian<qint16>(buffer, frames * m_channels, m_pending.data() + offset);
+#else
+    m_pending.append(reinterpret_cast<const char *>(buffer), bytes);
+#endif
+    m_frames += frames;
+    if (m_pending.size() >= CHUNK_FRAMES * m_channels * int(sizeof(EAS_PCM))) {
+        return writeChunk();
+    }
+    return true;
+}
+
+bool RenderCache::Writer::writeChunk()
+{
+    if (m_pending.isEmpty()) {
+        return true;
+    }
+    QByteArray compressed = qCompress(m_pending, 1);
+    uchar size[4];
+    qToLittleEndian<quint32>(quint32(compressed.size()), size);
+    bool ok = m_file.write(reinterpret_cast<const char *>(size), 4) == 4
+              && m_file.write(compressed) == compressed.size();
+    m_pending.clear();
+    return ok;
+}
+
+bool RenderCache::Writer::finish()
+{
+    if (!m_file.isOpen()) {
+        return false;
+    }
+    uchar frames[8];
+    qToLittleEndian<quint64>(quint64(m_frames), frames);
+    bool ok = writeChunk() && m_file.seek(12)
+              && m_file.write(reinterpret_cast<const char *>(frames), 8) == 8;
+    if (!ok) {
+        m_file.cancelWriting();
+    }
+    /* the last writer of a key wins, the entry is replaced atomically */
+    if (!m_file.commit()) {
+        qWarning() << "Failed to store render cache entry" << m_file.fileName();
+        ok = false;
+    }
+    m_pending.clear();
+    return ok;
+}
+
+void RenderCache::Writer::discard()
+{
+    if (m_file.isOpen()) {
+        m_file.cancelWriting();
+        m_file.commit();
+    }
+    m_pending.clear();
+}
+
+bool RenderCache::Writer::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+RenderCache::RenderCache(const QString &directory)
+    : m_directory(directory.isEmpty() ? defaultDirectory() : directory)
+    , m_maxSize(DEFAULT_MAX_SIZE)
+{}
+
+QString RenderCache::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+           + QStringLiteral("/sonivoxeas/render");
+}
+
+QString RenderCache::directory() const
+{
+    return m_directory;
+}
+
+void RenderCache::setMaxSize(qint64 bytes)
+{
+    m_maxSize = bytes;
+}
+
+qint64 RenderCache::maxSize() const
+{
+    return m_maxSize;
+}
+
+QString RenderCache::entryPath(const QString &key) const
+{
+    return m_directory + QLatin1Char('/') + key + QLatin1String(CACHE_SUFFIX);
+}
+
+/* hashing a large file for every render is expensive: the digest is
+   remembered until the file size or modification time changes */
+QByteArray RenderCache::fileDigest(const QString &fileName)
+{
+    static QMutex mutex;
+    static QHash<QString, QPair<QString, QByteArray>> digests;
+    QFileInfo info(fileName);
+    if (!info.exists()) {
+        return QByteArray();
+    }
+    QString stamp = QString("%1:%2").arg(info.size()).arg(info.lastModified().toMSecsSinceEpoch());
+    QMutexLocker locker(&mutex);
+    auto it = digests.constFind(info.absoluteFilePath());
+    if (it != digests.constEnd() && it.value().first == stamp) {
+        return it.value().second;
+    }
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(&file);
+    QByteArray digest = hash.result();
+    digests.insert(info.absoluteFilePath(), qMakePair(stamp, digest));
+    return digest;
+}
+
+QString RenderCache::key(const QString &midiFile, const RenderParameters &params) const
+{
+    QByteArray soundfont = params.soundfont.isEmpty() ? QByteArray() : fileDigest(params.soundfont);
+    return key(fileDigest(midiFile), soundfont, params);
+}
+
+/* only hashes the digests and the parameters, it does not read any file */
+QString RenderCache::key(const QByteArray &midiDigest,
+                         const QByteArray &soundfontDigest,
+                         const RenderParameters &params) const
+{
+    if (midiDigest.isEmpty() || (!params.soundfont.isEmpty() && soundfontDigest.isEmpty())) {
+        return QString();
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(midiDigest);
+    hash.addData(soundfontDigest);
+    QString settings = QString("%1:%2:%3:%4:%5:%6:%7")
+                           .arg(params.reverbType)
+                           .arg(params.reverbWet)
+                           .arg(params.chorusType)
+                           .arg(params.chorusLevel)
+                           .arg(params.libVersion)
+                           .arg(params.sampleRate)
+                           .arg(params.channels);
+    /* appended only when set, so that the existing entries keep their keys */
+    if (params.compactSongs) {
+        settings += ":compact";
+    }
+    hash.addData(settings.toLatin1());
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+bool RenderCache::lookup(const QString &key, Reader &reader)
+{
+    QString path = entryPath(key);
+    if (key.isEmpty() || !QFileInfo::exists(path) || !reader.open(path)) {
+        return false;
+    }
+    /* the modification time is the last use time for the LRU eviction */
+    QFile touch(path);
+    if (touch.open(QIODevice::ReadWrite)) {
+        touch.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    }
+    qDebug() << Q_FUNC_INFO << "hit" << key;
+    return true;
+}
+
+bool RenderCache::begin(const QString &key, Writer &writer, int sampleRate, int channels)
+{
+    if (key.isEmpty() || !QDir().mkpath(m_directory)) {
+        return false;
+    }
+    return writer.open(entryPath(key), sampleRate, channels);
+}
+
+bool RenderCache::commit(Writer &writer)
+{
+    bool ok = writer.finish();
+    if (ok) {
+        evict();
+    }
+    return ok;
+}
+
+void RenderCache::evict()
+{
+    QDir dir(m_directory);
+    QFileInfoList entries = dir.entryInfoList(QStringList() << QString("*") + CACHE_SUFFIX,
+                                              QDir::Files,
+                                              QDir::Time);
+    qint64 total = 0;
+    for (const QFileInfo &entry : entries) {
+        total += entry.size();
+    }
+    /* the list is sorted by modification time, newest first */
+    while (total > m_maxSize && !entries.isEmpty()) {
+        QFileInfo oldest = entries.takeLast();
+        if (QFile::remove(oldest.absoluteFilePath())) {
+            total -= oldest.size();
+            qDebug() << Q_FUNC_INFO << "removed" << oldest.fileName();
+        } else {
+            break;
+        }
+    }
+}
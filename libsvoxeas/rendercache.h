@@ -0,0 +1,130 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef RENDERCACHE_H
+#define RENDERCACHE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QSaveFile>
+#include <QString>
+#include <eas_types.h>
+
+class ProgramSettings;
+
+/* Everything that changes the rendered audio of a MIDI file */
+struct RenderParameters
+{
+    RenderParameters();
+    static RenderParameters fromSettings(const ProgramSettings *settings);
+
+    QString soundfont;
+    int reverbType;
+    int reverbWet;
+    int chorusType;
+    int chorusLevel;
+    bool compactSongs;
+    uint libVersion;
+    int sampleRate;
+    int channels;
+};
+
+/*
+ * Content addressed on-disk cache of rendered MIDI files. Entries are keyed
+ * by a hash of the MIDI file contents, the DLS soundfont contents and the
+ * render parameters, and hold the PCM audio compressed in independent chunks
+ * so a reader can stream them. The cache is kept under a size limit by
+ * removing the least recently used entries.
+ */
+class RenderCache
+{
+public:
+    class Reader
+    {
+    public:
+        Reader();
+        bool open(const QString &fileName);
+        void close();
+        bool isOpen() const;
+        int read(EAS_PCM *buffer, int frames);
+        bool seek(qint64 frame);
+        bool atEnd() const;
+        qint64 position() const;
+        qint64 frames() const;
+        int sampleRate() const;
+        int channels() const;
+
+    private:
+        bool readChunk();
+
+        QFile m_file;
+        QByteArray m_chunk;
+        int m_chunkPos;
+        qint64 m_position;
+        qint64 m_frames;
+        int m_sampleRate;
+        int m_channels;
+    };
+
+    class Writer
+    {
+    public:
+        Writer();
+        ~Writer();
+        bool open(const QString &fileName, int sampleRate, int channels);
+        bool write(const EAS_PCM *buffer, int frames);
+        bool finish();
+        void discard();
+        bool isOpen() const;
+
+    private:
+        friend class RenderCache;
+        bool writeChunk();
+
+        QSaveFile m_file;
+        QByteArray m_pending;
+        qint64 m_frames;
+        int m_channels;
+    };
+
+    explicit RenderCache(const QString &directory = QString());
+
+    static QString defaultDirectory();
+    QString directory() const;
+    void setMaxSize(qint64 bytes);
+    qint64 maxSize() const;
+
+    static QByteArray fileDigest(const QString &fileName);
+    QString key(const QString &midiFile, const RenderParameters &params) const;
+    QString key(const QByteArray &midiDigest,
+                const QByteArray &soundfontDigest,
+                const RenderParameters &params) const;
+    bool lookup(const QString &key, Reader &reader);
+    bool begin(const QString &key, Writer &writer, int sampleRate, int channels);
+    bool commit(Writer &writer);
+    void evict();
+
+private:
+    QString entryPath(const QString &key) const;
+
+    QString m_directory;
+    qint64 m_maxSize;
+};
+
+#endif // RENDERCACHE_H
@@ -0,0 +1,300 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QElapsedTimer>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QtDebug>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#include "segmentrenderer.h"
+#include "synthengine.h"
+#include "wavewriter.h"
+
+/* rendered after the last event, so that notes and effects can fade out */
+static const int SEGMENT_TAIL_SECONDS = 3;
+/* rendered and dropped before each segment, for the attacks and effect tails to settle */
+static const int PREROLL_SECONDS = 2;
+/* segments shorter than this spend too much of their time in the pre-roll */
+static const int MIN_SEGMENT_SECONDS = 10;
+static const int CROSSFADE_MILLISECONDS = 20;
+
+class SegmentTask : public QRunnable
+{
+public:
+    SegmentTask(SegmentRenderer *renderer, const SegmentRenderer::Segment &segment, EAS_PCM *output,
+                QVector<EAS_PCM> *tail, std::atomic<int> *failures)
+        : m_renderer(renderer)
+        , m_segment(segment)
+        , m_output(output)
+        , m_tail(tail)
+        , m_failures(failures)
+    {}
+
+    void run() override
+    {
+        if (!m_renderer->renderSegment(m_segment, m_output, m_tail)) {
+            m_failures->fetch_add(1);
+        }
+    }
+
+private:
+    SegmentRenderer *m_renderer;
+    SegmentRenderer::Segment m_segment;
+    EAS_PCM *m_output;
+    QVector<EAS_PCM> *m_tail;
+    std::atomic<int> *m_failures;
+};
+
+SegmentRenderer::SegmentRenderer(ProgramSettings *settings)
+    : m_settings(settings)
+    , m_requestedSegments(0)
+    , m_segments(0)
+    , m_sampleRate(0)
+    , m_channels(0)
+    , m_realtimeFactor(0.0)
+    , m_serialRealtimeFactor(0.0)
+    , m_maxError(0)
+    , m_rmsError(0.0)
+{}
+
+/* the number of segments to split a file into, 0 for one per CPU */
+void
+SegmentRenderer::setSegments(int segments)
+{
+    m_requestedSegments = qMax(0, segments);
+}
+
+bool
+SegmentRenderer::render(const QString &midiFile, const QString &waveFile, bool verify)
+{
+    QElapsedTimer timer;
+    timer.start();
+    m_segments = 0;
+    m_realtimeFactor = 0.0;
+    m_serialRealtimeFactor = 0.0;
+    m_maxError = 0;
+    m_rmsError = 0.0;
+    m_error.clear();
+
+    if (!m_song.load(midiFile)) {
+        m_error = m_song.errorString();
+        return false;
+    }
+    SynthEngine engine;
+    m_sampleRate = engine.sampleRate();
+    m_channels = engine.channels();
+    const int blockSize = engine.bufferSize();
+    if (m_sampleRate <= 0 || m_channels <= 0) {
+        m_error = QStringLiteral("SONiVOX EAS is not available");
+        return false;
+    }
+    m_snapshots.build(m_song);
+
+    /* the segments share the block grid of a serial render, so the events fall in the same blocks */
+    qint64 frames = (m_song.duration() * m_sampleRate) / 1000000 + SEGMENT_TAIL_SECONDS * m_sampleRate;
+    const qint64 totalFrames = (frames + blockSize - 1) / blockSize * blockSize;
+    int segments = m_requestedSegments > 0 ? m_requestedSegments : QThread::idealThreadCount();
+    segments = int(qBound<qint64>(1, segments, totalFrames / (qint64(MIN_SEGMENT_SECONDS) * m_sampleRate)));
+    const int fade = CROSSFADE_MILLISECONDS * m_sampleRate / 1000;
+    const qint64 preroll = qint64(PREROLL_SECONDS) * m_sampleRate;
+
+    QVector<Segment> plan;
+    for (int k = 0; k < segments; ++k) {
+        Segment segment;
+        segment.start = totalFrames * k / segments / blockSize * blockSize;
+        segment.end = totalFrames * (k + 1) / segments / blockSize * blockSize;
+        segment.preroll = qMax<qint64>(0, segment.start - preroll) / blockSize * blockSize;
+        segment.fadeIn = k > 0 ? fade : 0;
+        segment.fadeOut = k < segments - 1 ? fade : 0;
+        plan.append(segment);
+    }
+
+    m_output.fill(0, int(totalFrames * m_channels));
+    QVector<QVector<EAS_PCM>> tails(segments);
+    std::atomic<int> failures(0);
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMin(QThread::idealThreadCount(), segments));
+    for (int k = 0; k < segments; ++k) {
+        tails[k].fill(0, plan[k].fadeOut * m_channels);
+        pool.start(new SegmentTask(this, plan[k], m_output.data(), &tails[k], &failures));
+    }
+    pool.waitForDone();
+    if (failures > 0) {
+        m_error = QString("%1 segments failed to render").arg(failures.load());
+        m_output.clear();
+        return false;
+    }
+    /* the fade out of each segment over the fade in of the next one */
+    for (int k = 0; k + 1 < segments; ++k) {
+        EAS_PCM *dest = m_output.data() + plan[k].end * m_channels;
+        for (int i = 0; i < tails[k].size(); ++i) {
+            dest[i] = EAS_PCM(qBound(-32768, dest[i] + tails[k][i], 32767));
+        }
+    }
+    m_segments = segments;
+
+    WaveWriter wave;
+    bool ok = wave.open(waveFile, m_sampleRate, m_channels)
+              && wave.write(m_output.constData(), int(totalFrames))
+              && wave.close();
+    if (!ok) {
+        m_error = QStringLiteral("Failed to write ") + waveFile;
+    }
+    m_realtimeFactor = double(totalFrames) / m_sampleRate / qMax<qint64>(1, timer.nsecsElapsed()) * 1e9;
+
+    if (ok && verify) {
+        timer.restart();
+        QVector<EAS_PCM> reference(int(totalFrames * m_channels), 0);
+        const Segment whole = { 0, 0, totalFrames, 0, 0 };
+        if (renderSegment(whole, reference.data(), nullptr)) {
+            m_serialRealtimeFactor = double(totalFrames) / m_sampleRate
+                                     / qMax<qint64>(1, timer.nsecsElapsed()) * 1e9;
+            this->verify(reference);
+        } else {
+            m_error = QStringLiteral("The serial render failed");
+            ok = false;
+        }
+    }
+    m_output.clear();
+    return ok;
+}
+
+bool
+SegmentRenderer::renderSegment(const Segment &segment, EAS_PCM *output, QVector<EAS_PCM> *tail)
+{
+    SynthEngine engine;
+    if (!engine.init(m_settings->dlsSoundfont())) {
+        return false;
+    }
+    engine.initReverb(m_settings->reverbType());
+    engine.setReverbWet(m_settings->reverbWet());
+    engine.initChorus(m_settings->chorusType());
+    engine.setChorusLevel(m_settings->chorusLevel());
+
+    /* the state left by the events before the pre-roll, from the nearest snapshot */
+    const qint64 prerollTime = segment.preroll * 1000000 / m_sampleRate;
+    int next = m_song.locate(prerollTime);
+    if (segment.preroll > 0) {
+        const SongSnapshots::Snapshot &snapshot = m_snapshots.find(prerollTime);
+        SongState state = snapshot.state;
+        for (int i = snapshot.index; i < next; ++i) {
+            const CompactSong::Event &event = m_song.event(i);
+            state.apply(m_song.data(event), event.length);
+        }
+        state.restore(engine);
+    }
+
+    const int blockSize = engine.bufferSize();
+    const int channels = m_channels;
+    const qint64 last = segment.end + segment.fadeOut;
+    QVector<EAS_PCM> buffer(blockSize * channels);
+    for (qint64 frame = segment.preroll; frame < last; frame += blockSize) {
+        const qint64 blockEnd = (frame + blockSize) * 1000000 / m_sampleRate;
+        while (next < m_song.count() && m_song.event(next).time < blockEnd) {
+            const CompactSong::Event &event = m_song.event(next++);
+            engine.writeSongMIDI(m_song.data(event), event.length);
+        }
+        EAS_I32 numGen = engine.render(buffer.data());
+        if (numGen != blockSize) {
+            qWarning() << Q_FUNC_INFO << "short block" << numGen;
+            return false;
+        }
+        for (int i = 0; i < blockSize; ++i) {
+            const qint64 f = frame + i;
+            const EAS_PCM *src = buffer.constData() + i * channels;
+            if (f < segment.start || f >= last) {
+                continue;
+            }
+            if (f >= segment.end) {
+                const float gain = 1.0f - (f - segment.end + 0.5f) / segment.fadeOut;
+                EAS_PCM *dest = tail->data() + (f - segment.end) * channels;
+                for (int c = 0; c < channels; ++c) {
+                    dest[c] = EAS_PCM(src[c] * gain);
+                }
+            } else if (f < segment.start + segment.fadeIn) {
+                const float gain = (f - segment.start + 0.5f) / segment.fadeIn;
+                EAS_PCM *dest = output + f * channels;
+                for (int c = 0; c < channels; ++c) {
+                    dest[c] = EAS_PCM(src[c] * gain);
+                }
+            } else {
+                memcpy(output + f * channels, src, channels * sizeof(EAS_PCM));
+            }
+        }
+    }
+    return true;
+}
+
+/* the difference between the segmented render and the serial one */
+void
+SegmentRenderer::verify(const QVector<EAS_PCM> &reference)
+{
+    double sum = 0.0;
+    int peak = 0;
+    for (int i = 0; i < reference.size(); ++i) {
+        const int error = qAbs(int(m_output[i]) - int(reference[i]));
+        peak = qMax(peak, error);
+        sum += double(error) * error;
+    }
+    m_maxError = peak;
+    const double rms = reference.isEmpty() ? 0.0 : std::sqrt(sum / reference.size());
+    m_rmsError = rms > 0.0 ? 20.0 * std::log10(rms / 32768.0) : -INFINITY;
+}
+
+int
+SegmentRenderer::segments() const
+{
+    return m_segments;
+}
+
+double
+SegmentRenderer::realtimeFactor() const
+{
+    return m_realtimeFactor;
+}
+
+QString
+SegmentRenderer::errorString() const
+{
+    return m_error;
+}
+
+double
+SegmentRenderer::serialRealtimeFactor() const
+{
+    return m_serialRealtimeFactor;
+}
+
+/* the largest difference of a sample, in 16 bit steps */
+int
+SegmentRenderer::maxError() const
+{
+    return m_maxError;
+}
+
+/* the RMS of the difference, in dBFS */
+double
+SegmentRenderer::rmsError() const
+{
+    return m_rmsError;
+}
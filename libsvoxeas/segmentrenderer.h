@@ -0,0 +1,85 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SEGMENTRENDERER_H
+#define SEGMENTRENDERER_H
+
+#include <QString>
+#include <QVector>
+#include <eas_types.h>
+#include "compactsong.h"
+#include "programsettings.h"
+#include "songstate.h"
+
+/*
+ * Renders one MIDI file to a WAV file in time segments, each one on its
+ * own EAS instance, in parallel on a thread pool. A segment starts with a
+ * pre-roll: the song state from before it is restored and a few seconds
+ * are rendered and dropped, so the notes, controllers and effect tails are
+ * settled at the boundary. Adjacent segments are joined with a short
+ * linear crossfade. The result can be verified against a serial render of
+ * the whole file.
+ */
+class SegmentRenderer
+{
+public:
+    explicit SegmentRenderer(ProgramSettings *settings = ProgramSettings::instance());
+
+    void setSegments(int segments);
+    bool render(const QString &midiFile, const QString &waveFile, bool verify = false);
+
+    int segments() const;
+    double realtimeFactor() const;
+    QString errorString() const;
+
+    /* filled by a verified render */
+    double serialRealtimeFactor() const;
+    int maxError() const;
+    double rmsError() const;
+
+private:
+    friend class SegmentTask;
+
+    struct Segment {
+        qint64 preroll;  /* first rendered frame, on the block grid */
+        qint64 start;    /* first frame written to the output */
+        qint64 end;
+        int fadeIn;
+        int fadeOut;
+    };
+
+    bool renderSegment(const Segment &segment, EAS_PCM *output, QVector<EAS_PCM> *tail);
+    void verify(const QVector<EAS_PCM> &reference);
+
+    ProgramSettings *m_settings;
+    CompactSong m_song;
+    SongSnapshots m_snapshots;
+    int m_requestedSegments;
+    int m_segments;
+    int m_sampleRate;
+    int m_channels;
+    double m_realtimeFactor;
+    double m_serialRealtimeFactor;
+    int m_maxError;
+    double m_rmsError;
+    QVector<EAS_PCM> m_output;
+    QString m_error;
+};
+
+#endif // SEGMENTRENDERER_H
@@ -0,0 +1,326 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QFile>
+#include <algorithm>
+#include <cstring>
+
+#include "smfreader.h"
+
+static const qint32 DEFAULT_TEMPO = 500000;
+
+static quint32 readBE(const quint8 *data, int bytes)
+{
+    quint32 value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+/* reads a variable length quantity, returns false when it runs past the end */
+static bool readVLQ(const quint8 *data, int length, int &pos, quint32 &value)
+{
+    value = 0;
+    for (int i = 0; i < 4; ++i) {
+        if (pos >= length) {
+            return false;
+        }
+        quint8 byte = data[pos++];
+        value = (value << 7) | (byte & 0x7f);
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+SmfReader::SmfReader()
+    : m_karaokeTitle(false)
+    , m_format(0)
+    , m_tracks(0)
+    , m_division(0)
+{
+}
+
+bool
+SmfReader::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_error = file.errorString();
+        return false;
+    }
+    return parse(file.readAll());
+}
+
+bool
+SmfReader::parse(const QByteArray &smf)
+{
+    m_data.clear();
+    m_events.clear();
+    m_tempoMap.clear();
+    m_error.clear();
+    m_title.clear();
+    m_karaokeTitle = false;
+
+    const quint8 *data = reinterpret_cast<const quint8 *>(smf.constData());
+    int length = smf.size();
+    int pos = 0;
+    /* RIFF wrapped files (RMID) keep the SMF in the data chunk */
+    if (length >= 20 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "RMID", 4) == 0) {
+        pos = 12;
+        bool found = false;
+        while (pos + 8 <= length) {
+            const quint32 size = quint32(data[pos + 4]) | quint32(data[pos + 5]) << 8
+                                 | quint32(data[pos + 6]) << 16 | quint32(data[pos + 7]) << 24;
+            if (size > quint32(length - pos - 8)) {
+                break;
+            }
+            if (memcmp(data + pos, "data", 4) == 0) {
+                pos += 8;
+                length = pos + int(size);
+                found = true;
+                break;
+            }
+            /* RIFF chunks are padded to an even size */
+            pos += 8 + int(size) + int(size & 1);
+        }
+        if (!found) {
+            m_error = QStringLiteral("Invalid RMID file");
+            return false;
+        }
+    }
+    if (pos + 14 > length || memcmp(data + pos, "MThd", 4) != 0) {
+        m_error = QStringLiteral("Not a standard MIDI file");
+        return false;
+    }
+    const quint32 headerLength = readBE(data + pos + 4, 4);
+    m_format = int(readBE(data + pos + 8, 2));
+    m_tracks = int(readBE(data + pos + 10, 2));
+    m_division = int(readBE(data + pos + 12, 2));
+    if (headerLength < 6 || headerLength > quint32(length - pos - 8) || m_division == 0) {
+        m_error = QStringLiteral("Invalid MIDI file header");
+        return false;
+    }
+    pos += 8 + int(headerLength);
+
+    QVector<RawEvent> events;
+    int track = 0;
+    while (track < m_tracks && pos + 8 <= length) {
+        quint32 chunkSize = readBE(data + pos + 4, 4);
+        bool isTrack = memcmp(data + pos, "MTrk", 4) == 0;
+        pos += 8;
+        int chunkLength = chunkSize > quint32(length - pos) ? length - pos : int(chunkSize);
+        if (isTrack) {
+            if (!parseTrack(data + pos, chunkLength, track, events)) {
+                return false;
+            }
+            ++track;
+        }
+        pos += chunkLength;
+    }
+    if (track == 0) {
+        m_error = QStringLiteral("No tracks found");
+        return false;
+    }
+    convertTimes(events);
+    return true;
+}
+
+bool
+SmfReader::parseTrack(const quint8 *data, int length, int track, QVector<RawEvent> &events)
+{
+    int pos = 0;
+    qint64 tick = 0;
+    quint8 status = 0;
+    int order = 0;
+    while (pos < length) {
+        quint32 delta;
+        if (!readVLQ(data, length, pos, delta) || pos >= length) {
+            break;
+        }
+        tick += delta;
+        RawEvent event = { tick, track, order++, 0, 0, 0 };
+        quint8 byte = data[pos];
+        if (byte == 0xff) {
+            quint32 size;
+            if (pos + 2 > length) {
+                break;
+            }
+            quint8 type = data[pos + 1];
+            pos += 2;
+            if (!readVLQ(data, length, pos, size) || pos + int(size) > length) {
+                break;
+            }
+            if (type == 0x2f) {
+                break;
+            }
+            if (type == 0x51 && size == 3) {
+                event.tempo = qint32(readBE(data + pos, 3));
+                events.append(event);
+            } else if (type == 0x01 && size > 2 && data[pos] == '@' && data[pos + 1] == 'T'
+                       && !m_karaokeTitle) {
+                /* karaoke files put the song title in a text event starting with @T */
+                m_title = QString::fromLatin1(reinterpret_cast<const char *>(data + pos + 2), int(size) - 2);
+                m_karaokeTitle = true;
+            } else if (type == 0x03 && track == 0 && m_title.isEmpty()) {
+                m_title = QString::fromLatin1(reinterpret_cast<const char *>(data + pos), int(size));
+            }
+            pos += int(size);
+            continue;
+        }
+        if (byte == 0xf0 || byte == 0xf7) {
+            quint32 size;
+            ++pos;
+            if (!readVLQ(data, length, pos, size) || pos + int(size) > length) {
+                break;
+            }
+            /* F7 escapes carry raw bytes, F0 messages get their status back */
+            event.offset = m_data.size();
+            if (byte == 0xf0) {
+                m_data.append(char(0xf0));
+            }
+            m_data.append(reinterpret_cast<const char *>(data + pos), int(size));
+            event.length = m_data.size() - event.offset;
+            if (event.length > 0) {
+                events.append(event);
+            }
+            status = 0;
+            pos += int(size);
+            continue;
+        }
+        if (byte > 0xf0) {
+            m_error = QString("Unexpected status %1 in track %2").arg(byte, 0, 16).arg(track);
+            return false;
+        }
+        if (byte & 0x80) {
+            status = byte;
+            ++pos;
+        } else if (status == 0) {
+            m_error = QString("Data byte without status in track %1").arg(track);
+            return false;
+        }
+        int size = (status & 0xe0) == 0xc0 ? 1 : 2;
+        if (pos + size > length) {
+            break;
+        }
+        event.offset = m_data.size();
+        event.length = size + 1;
+        m_data.append(char(status));
+        m_data.append(reinterpret_cast<const char *>(data + pos), size);
+        events.append(event);
+        pos += size;
+    }
+    return true;
+}
+
+void
+SmfReader::convertTimes(QVector<RawEvent> &events)
+{
+    std::stable_sort(events.begin(), events.end(), [](const RawEvent &a, const RawEvent &b) {
+        if (a.tick != b.tick) {
+            return a.tick < b.tick;
+        }
+        return a.track < b.track || (a.track == b.track && a.order < b.order);
+    });
+
+    const bool smpte = (m_division & 0x8000) != 0;
+    double tickTime; /* microseconds per tick */
+    if (smpte) {
+        int fps = 256 - ((m_division >> 8) & 0xff);
+        int resolution = m_division & 0xff;
+        tickTime = 1e6 / (fps == 29 ? 29.97 : fps) / qMax(1, resolution);
+    } else {
+        tickTime = double(DEFAULT_TEMPO) / m_division;
+    }
+    qint64 lastTick = 0;
+    double time = 0.0;
+    m_events.reserve(events.size());
+    for (const RawEvent &event : events) {
+        time += (event.tick - lastTick) * tickTime;
+        lastTick = event.tick;
+        if (event.tempo > 0) {
+            if (!smpte) {
+                tickTime = double(event.tempo) / m_division;
+            }
+            Tempo change = { qint64(time), event.tempo };
+            m_tempoMap.append(change);
+            continue;
+        }
+        Event converted = { qint64(time), event.offset, event.length };
+        m_events.append(converted);
+    }
+}
+
+QString
+SmfReader::errorString() const
+{
+    return m_error;
+}
+
+const QVector<SmfReader::Event> &
+SmfReader::events() const
+{
+    return m_events;
+}
+
+const quint8 *
+SmfReader::data(const Event &event) const
+{
+    return reinterpret_cast<const quint8 *>(m_data.constData()) + event.offset;
+}
+
+/* the tempo changes of the song, empty when it keeps the default tempo */
+const QVector<SmfReader::Tempo> &
+SmfReader::tempoMap() const
+{
+    return m_tempoMap;
+}
+
+int
+SmfReader::channel(const Event &event) const
+{
+    quint8 status = data(event)[0];
+    return status >= 0x80 && status < 0xf0 ? status & 0x0f : -1;
+}
+
+qint64
+SmfReader::duration() const
+{
+    return m_events.isEmpty() ? 0 : m_events.last().time;
+}
+
+int
+SmfReader::format() const
+{
+    return m_format;
+}
+
+int
+SmfReader::tracks() const
+{
+    return m_tracks;
+}
+
+QString
+SmfReader::title() const
+{
+    return m_title.trimmed();
+}
@@ -0,0 +1,88 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SMFREADER_H
+#define SMFREADER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+/*
+ * Standard MIDI File reader. All the tracks are merged into one list of
+ * channel and system exclusive events, timestamped in microseconds using
+ * the tempo map. Meta events other than tempo changes are dropped, except
+ * for the song title.
+ */
+class SmfReader
+{
+public:
+    struct Event {
+        qint64 time;  /* microseconds from the start of the song */
+        int offset;   /* position of the message in data() */
+        int length;
+    };
+
+    struct Tempo {
+        qint64 time;   /* microseconds from the start of the song */
+        qint32 tempo;  /* microseconds per quarter note */
+    };
+
+    SmfReader();
+
+    bool load(const QString &fileName);
+    bool parse(const QByteArray &smf);
+    QString errorString() const;
+
+    const QVector<Event> &events() const;
+    const quint8 *data(const Event &event) const;
+    const QVector<Tempo> &tempoMap() const;
+    /* the channel of a channel message, or -1 for system exclusive */
+    int channel(const Event &event) const;
+    qint64 duration() const;
+    int format() const;
+    int tracks() const;
+    QString title() const;
+
+private:
+    struct RawEvent {
+        qint64 tick;
+        int track;
+        int order;
+        int offset;
+        int length;
+        qint32 tempo;  /* microseconds per quarter note, or 0 */
+    };
+
+    bool parseTrack(const quint8 *data, int length, int track, QVector<RawEvent> &events);
+    void convertTimes(QVector<RawEvent> &events);
+
+    QByteArray m_data;
+    QVector<Event> m_events;
+    QVector<Tempo> m_tempoMap;
+    QString m_error;
+    QString m_title;
+    bool m_karaokeTitle;
+    int m_format;
+    int m_tracks;
+    int m_division;
+};
+
+#endif // SMFREADER_H
@@ -0,0 +1,317 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <initializer_list>
+#include <cstring>
+
+#include "compactsong.h"
+#include "songstate.h"
+#include "synthengine.h"
+
+/* microseconds between snapshots */
+static const qint64 SNAPSHOT_INTERVAL = 5000000;
+static const quint16 PITCH_BEND_CENTER = 8192;
+static const int SUSTAIN_PEDAL = 64;
+
+SongState::SongState()
+{
+    reset();
+}
+
+void
+SongState::reset()
+{
+    for (Channel &channel : m_channels) {
+        memset(channel.velocity, 0, sizeof(channel.velocity));
+        channel.released.reset();
+        resetChannel(channel);
+        channel.controllerSet.reset();
+        channel.rpnSet.reset();
+        memset(channel.controllers, 0, sizeof(channel.controllers));
+        memset(channel.rpn, 0, sizeof(channel.rpn));
+        channel.program = -1;
+    }
+    m_masterVolume[0] = m_masterVolume[1] = 0;
+    m_masterVolumeSet = false;
+}
+
+void
+SongState::apply(const quint8 *message, int length)
+{
+    if (length < 1) {
+        return;
+    }
+    const quint8 status = message[0];
+    if (status == 0xf0) {
+        if (length >= 6 && message[1] == 0x7e && message[3] == 0x09 && message[4] == 0x01) {
+            /* general MIDI system on */
+            reset();
+        } else if (length >= 8 && message[1] == 0x7f && message[3] == 0x04 && message[4] == 0x01) {
+            m_masterVolume[0] = message[5];
+            m_masterVolume[1] = message[6];
+            m_masterVolumeSet = true;
+        }
+        return;
+    }
+    if (status < 0x80 || status >= 0xf0) {
+        return;
+    }
+    Channel &channel = m_channels[status & 0x0f];
+    switch (status & 0xf0) {
+    case 0x90:
+        if (length > 2 && message[2] > 0) {
+            channel.velocity[message[1] & 0x7f] = message[2] & 0x7f;
+            channel.released.reset(message[1] & 0x7f);
+            break;
+        }
+        /* note on with velocity zero */
+        // fall through
+    case 0x80:
+        if (length > 1) {
+            const int key = message[1] & 0x7f;
+            if (channel.controllers[SUSTAIN_PEDAL] >= 64 && channel.velocity[key] > 0) {
+                channel.released.set(key);
+            } else {
+                channel.velocity[key] = 0;
+            }
+        }
+        break;
+    case 0xb0:
+        if (length > 2) {
+            controller(channel, message[1] & 0x7f, message[2] & 0x7f);
+        }
+        break;
+    case 0xc0:
+        if (length > 1) {
+            channel.program = message[1] & 0x7f;
+        }
+        break;
+    case 0xd0:
+        if (length > 1) {
+            channel.pressure = message[1] & 0x7f;
+        }
+        break;
+    case 0xe0:
+        if (length > 2) {
+            channel.pitchBend = quint16((message[1] & 0x7f) | (message[2] & 0x7f) << 7);
+        }
+        break;
+    }
+}
+
+void
+SongState::controller(Channel &channel, int number, int value)
+{
+    switch (number) {
+    case 101:
+        channel.rpnMsb = quint8(value);
+        break;
+    case 100:
+        channel.rpnLsb = quint8(value);
+        break;
+    case 99:
+    case 98:
+        /* the data entry that follows is for a non registered parameter */
+        channel.rpnMsb = channel.rpnLsb = 127;
+        break;
+    case 6:
+    case 38:
+        if (channel.rpnMsb == 0 && channel.rpnLsb < RPN_COUNT) {
+            channel.rpn[channel.rpnLsb][number == 6 ? 0 : 1] = quint8(value);
+            channel.rpnSet.set(channel.rpnLsb);
+        }
+        break;
+    case SUSTAIN_PEDAL:
+        channel.controllers[SUSTAIN_PEDAL] = quint8(value);
+        channel.controllerSet.set(SUSTAIN_PEDAL);
+        if (value < 64) {
+            for (int key = 0; key < 128; ++key) {
+                if (channel.released.test(key)) {
+                    channel.velocity[key] = 0;
+                }
+            }
+            channel.released.reset();
+        }
+        break;
+    case 120:
+    case 123:
+        memset(channel.velocity, 0, sizeof(channel.velocity));
+        channel.released.reset();
+        break;
+    case 121:
+        /* reset all controllers keeps the bank, program, volume and pan, and the held keys */
+        for (int cc : { 1, 11, 64, 65, 66, 67 }) {
+            channel.controllerSet.reset(cc);
+            channel.controllers[cc] = 0;
+        }
+        resetChannel(channel);
+        break;
+    default:
+        if (number < 120) {
+            channel.controllers[number] = quint8(value);
+            channel.controllerSet.set(number);
+        }
+        break;
+    }
+}
+
+/* the state reset all controllers returns to: the pedal is up, so the notes it held end */
+void
+SongState::resetChannel(Channel &channel)
+{
+    for (int key = 0; key < 128; ++key) {
+        if (channel.released.test(key)) {
+            channel.velocity[key] = 0;
+        }
+    }
+    channel.released.reset();
+    channel.rpnMsb = channel.rpnLsb = 127;
+    channel.pressure = 0;
+    channel.pitchBend = PITCH_BEND_CENTER;
+}
+
+/* expects the engine silenced and its controllers reset */
+void
+SongState::restore(SynthEngine &engine) const
+{
+    if (m_masterVolumeSet) {
+        const EAS_U8 masterVolume[8] = { 0xf0, 0x7f, 0x7f, 0x04, 0x01, m_masterVolume[0], m_masterVolume[1], 0xf7 };
+        engine.writeSongMIDI(masterVolume, 8);
+    }
+    for (int number = 0; number < MIDI_CHANNELS; ++number) {
+        const Channel &channel = m_channels[number];
+        const EAS_U8 control = EAS_U8(0xb0 | number);
+        /* the controllers that reset all controllers does not restore get their defaults */
+        const EAS_U8 defaults[][3] = {
+            { control, 0, EAS_U8(channel.controllerSet.test(0) ? channel.controllers[0] : 0) },
+            { control, 32, EAS_U8(channel.controllerSet.test(32) ? channel.controllers[32] : 0) },
+            { control, 7, EAS_U8(channel.controllerSet.test(7) ? channel.controllers[7] : 100) },
+            { control, 10, EAS_U8(channel.controllerSet.test(10) ? channel.controllers[10] : 64) },
+        };
+        for (const EAS_U8 *message : defaults) {
+            engine.writeSongMIDI(message, 3);
+        }
+        const EAS_U8 program[2] = { EAS_U8(0xc0 | number), EAS_U8(qMax(0, int(channel.program))) };
+        engine.writeSongMIDI(program, 2);
+        for (int cc = 1; cc < 120; ++cc) {
+            if (!channel.controllerSet.test(cc) || cc == 7 || cc == 10 || cc == 32 || cc == SUSTAIN_PEDAL) {
+                continue;
+            }
+            const EAS_U8 message[3] = { control, EAS_U8(cc), channel.controllers[cc] };
+            engine.writeSongMIDI(message, 3);
+        }
+        for (int rpn = 0; rpn < RPN_COUNT; ++rpn) {
+            if (!channel.rpnSet.test(rpn)) {
+                continue;
+            }
+            const EAS_U8 messages[4][3] = {
+                { control, 101, 0 },
+                { control, 100, EAS_U8(rpn) },
+                { control, 6, channel.rpn[rpn][0] },
+                { control, 38, channel.rpn[rpn][1] },
+            };
+            for (const EAS_U8 *message : messages) {
+                engine.writeSongMIDI(message, 3);
+            }
+        }
+        if (channel.rpnSet.any()) {
+            const EAS_U8 nullMsb[3] = { control, 101, 127 };
+            const EAS_U8 nullLsb[3] = { control, 100, 127 };
+            engine.writeSongMIDI(nullMsb, 3);
+            engine.writeSongMIDI(nullLsb, 3);
+        }
+        if (channel.pitchBend != PITCH_BEND_CENTER) {
+            const EAS_U8 bend[3] = { EAS_U8(0xe0 | number), EAS_U8(channel.pitchBend & 0x7f), EAS_U8(channel.pitchBend >> 7) };
+            engine.writeSongMIDI(bend, 3);
+        }
+        if (channel.pressure > 0) {
+            const EAS_U8 pressure[2] = { EAS_U8(0xd0 | number), EAS_U8(channel.pressure) };
+            engine.writeSongMIDI(pressure, 2);
+        }
+        if (channel.controllerSet.test(SUSTAIN_PEDAL)) {
+            const EAS_U8 pedal[3] = { control, SUSTAIN_PEDAL, channel.controllers[SUSTAIN_PEDAL] };
+            engine.writeSongMIDI(pedal, 3);
+        }
+        /* the notes held by the pedal are played and released, so the pedal keeps them */
+        for (int key = 0; key < 128; ++key) {
+            if (channel.velocity[key] > 0) {
+                const EAS_U8 noteOn[3] = { EAS_U8(0x90 | number), EAS_U8(key), channel.velocity[key] };
+                engine.writeSongMIDI(noteOn, 3);
+            }
+        }
+        for (int key = 0; key < 128; ++key) {
+            if (channel.released.test(key)) {
+                const EAS_U8 noteOff[3] = { EAS_U8(0x80 | number), EAS_U8(key), 0 };
+                engine.writeSongMIDI(noteOff, 3);
+            }
+        }
+    }
+}
+
+SongSnapshots::SongSnapshots()
+{}
+
+/* a pass over the events of the song, without rendering */
+void
+SongSnapshots::build(const CompactSong &song)
+{
+    m_snapshots.clear();
+    m_snapshots.reserve(int(song.duration() / SNAPSHOT_INTERVAL) + 1);
+    SongState state;
+    qint64 next = 0;
+    for (int i = 0; i < song.count(); ++i) {
+        const CompactSong::Event &event = song.event(i);
+        while (event.time >= next) {
+            Snapshot snapshot = { next, i, state };
+            m_snapshots.append(snapshot);
+            next += SNAPSHOT_INTERVAL;
+        }
+        state.apply(song.data(event), event.length);
+    }
+    if (m_snapshots.isEmpty()) {
+        Snapshot snapshot = { 0, 0, state };
+        m_snapshots.append(snapshot);
+    }
+}
+
+void
+SongSnapshots::clear()
+{
+    m_snapshots.clear();
+}
+
+bool
+SongSnapshots::isEmpty() const
+{
+    return m_snapshots.isEmpty();
+}
+
+int
+SongSnapshots::count() const
+{
+    return m_snapshots.count();
+}
+
+/* the last snapshot at or before this time; must not be called while empty */
+const SongSnapshots::Snapshot &
+SongSnapshots::find(qint64 time) const
+{
+    const int slot = int(qBound(qint64(0), time / SNAPSHOT_INTERVAL, qint64(m_snapshots.count() - 1)));
+    return m_snapshots.at(slot);
+}
@@ -0,0 +1,99 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SONGSTATE_H
+#define SONGSTATE_H
+
+#include <QVector>
+#include <QtGlobal>
+#include <bitset>
+
+class CompactSong;
+class SynthEngine;
+
+/*
+ * The MIDI state a song leaves in the synthesizer at one point: programs,
+ * controllers, registered parameters, pitch bend, pressure, master volume
+ * and the notes still sounding, held by a key or by the sustain pedal.
+ * Restoring it into the song stream of an engine sends the messages that
+ * recreate the state; the sounding notes start again from their attack.
+ */
+class SongState
+{
+public:
+    SongState();
+
+    void reset();
+    void apply(const quint8 *message, int length);
+    void restore(SynthEngine &engine) const;
+
+private:
+    /* pitch bend sensitivity, fine and coarse tuning, the ones EAS implements */
+    static const int RPN_COUNT = 3;
+    static const int MIDI_CHANNELS = 16;
+
+    struct Channel {
+        std::bitset<128> controllerSet;
+        std::bitset<128> released;  /* notes off while the pedal is down */
+        std::bitset<RPN_COUNT> rpnSet;
+        quint8 controllers[128];
+        quint8 velocity[128];       /* of the sounding notes, or 0 */
+        quint8 rpn[RPN_COUNT][2];
+        quint8 rpnMsb;
+        quint8 rpnLsb;
+        qint16 program;
+        qint16 pressure;
+        quint16 pitchBend;
+    };
+
+    void controller(Channel &channel, int number, int value);
+    static void resetChannel(Channel &channel);
+
+    Channel m_channels[MIDI_CHANNELS];
+    quint8 m_masterVolume[2];
+    bool m_masterVolumeSet;
+};
+
+/*
+ * The song state every few seconds of a compiled song, with the position of
+ * the next event. A seek restores the nearest snapshot before the target and
+ * only applies the events in between, instead of the whole song.
+ */
+class SongSnapshots
+{
+public:
+    struct Snapshot {
+        qint64 time;  /* microseconds from the start of the song */
+        int index;    /* the first event at or after time */
+        SongState state;
+    };
+
+    SongSnapshots();
+
+    void build(const CompactSong &song);
+    void clear();
+    bool isEmpty() const;
+    int count() const;
+    const Snapshot &find(qint64 time) const;
+
+private:
+    QVector<Snapshot> m_snapshots;
+};
+
+#endif // SONGSTATE_H
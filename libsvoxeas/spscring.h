@@ -0,0 +1,150 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/*
+ * Bounded lock-free ring buffer for one producer thread and one consumer
+ * thread. The capacity is rounded up to a power of two. Writes that do not
+ * fit are truncated and reads return what is available, so neither side
+ * ever blocks.
+ */
+template<typename T>
+class SpscRing
+{
+public:
+    explicit SpscRing(size_t capacity = 0)
+        : m_mask(0)
+        , m_head(0)
+        , m_tail(0)
+    {
+        resize(capacity);
+    }
+
+    /* not thread safe: call before the producer and consumer are running */
+    void resize(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        m_buffer.assign(capacity > 0 ? size : 0, T());
+        m_mask = capacity > 0 ? size - 1 : 0;
+        m_head.store(0, std::memory_order_relaxed);
+        m_tail.store(0, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return m_buffer.size(); }
+
+    size_t readAvailable() const
+    {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_relaxed);
+    }
+
+    size_t writeAvailable() const
+    {
+        return m_buffer.size()
+               - (m_head.load(std::memory_order_relaxed) - m_tail.load(std::memory_order_acquire));
+    }
+
+    size_t write(const T *data, size_t count)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        count = std::min(count, writeAvailable());
+        for (size_t i = 0; i < count; ++i) {
+            m_buffer[(head + i) & m_mask] = data[i];
+        }
+        m_head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    bool push(const T &item) { return write(&item, 1) == 1; }
+
+    /* moves the item into the ring, so the producer keeps no reference to it */
+    bool push(T &&item)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (writeAvailable() == 0) {
+            return false;
+        }
+        m_buffer[head & m_mask] = std::move(item);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* producer side: the number of items written since the ring was created */
+    size_t written() const { return m_head.load(std::memory_order_relaxed); }
+
+    size_t read(T *data, size_t count)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        count = std::min(count, readAvailable());
+        for (size_t i = 0; i < count; ++i) {
+            data[i] = m_buffer[(tail + i) & m_mask];
+        }
+        m_tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    bool pop(T &item) { return read(&item, 1) == 1; }
+
+    /* like pop(), but leaves a default item in the slot, so that the
+       producer never releases what the item refers to */
+    bool take(T &item)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (readAvailable() == 0) {
+            return false;
+        }
+        item = std::move(m_buffer[tail & m_mask]);
+        m_buffer[tail & m_mask] = T();
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* consumer side: drops the items written before this count of written() */
+    void skipTo(size_t position)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (std::ptrdiff_t(position - tail) > 0) {
+            m_tail.store(position, std::memory_order_release);
+        }
+    }
+
+    /* consumer side: drops everything available */
+    void clear()
+    {
+        m_tail.store(m_head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+private:
+    std::vector<T> m_buffer;
+    size_t m_mask;
+    std::atomic<size_t> m_head;
+    std::atomic<size_t> m_tail;
+};
+
+#endif // SPSCRING_H
@@ -0,0 +1,234 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QtDebug>
+#include <atomic>
+
+#include "stemrenderer.h"
+#include "synthengine.h"
+#include "wavewriter.h"
+
+/* rendered after the last event, so that notes and effects can fade out */
+static const int STEM_TAIL_SECONDS = 3;
+static const int MIDI_CHANNELS = 16;
+
+class StemTask : public QRunnable
+{
+public:
+    StemTask(StemRenderer *renderer, int channel, const QString &waveFile, std::atomic<int> *failures)
+        : m_renderer(renderer)
+        , m_channel(channel)
+        , m_waveFile(waveFile)
+        , m_failures(failures)
+    {}
+
+    void run() override
+    {
+        if (!m_renderer->renderChannel(m_channel, m_waveFile)) {
+            m_failures->fetch_add(1);
+        }
+    }
+
+private:
+    StemRenderer *m_renderer;
+    int m_channel;
+    QString m_waveFile;
+    std::atomic<int> *m_failures;
+};
+
+StemRenderer::StemRenderer(ProgramSettings *settings)
+    : m_settings(settings)
+    , m_totalFrames(0)
+    , m_sampleRate(0)
+    , m_channels(0)
+    , m_mixEnabled(false)
+    , m_realtimeFactor(0.0)
+{}
+
+bool
+StemRenderer::render(const QString &midiFile, const QString &outputDirectory, bool writeMix)
+{
+    QElapsedTimer timer;
+    timer.start();
+    m_files.clear();
+    m_realtimeFactor = 0.0;
+    m_error.clear();
+
+    if (!m_smf.load(midiFile)) {
+        m_error = m_smf.errorString();
+        return false;
+    }
+
+    bool used[MIDI_CHANNELS] = {};
+    for (const SmfReader::Event &event : m_smf.events()) {
+        int channel = m_smf.channel(event);
+        if (channel >= 0) {
+            used[channel] = true;
+        }
+    }
+
+    SynthEngine engine;
+    m_sampleRate = engine.sampleRate();
+    m_channels = engine.channels();
+    if (m_sampleRate <= 0 || m_channels <= 0) {
+        m_error = QStringLiteral("SONiVOX EAS is not available");
+        return false;
+    }
+    /* every stem has the same length, a whole number of blocks */
+    qint64 frames = (m_smf.duration() * m_sampleRate) / 1000000 + STEM_TAIL_SECONDS * m_sampleRate;
+    m_totalFrames = (frames + engine.bufferSize() - 1) / engine.bufferSize() * engine.bufferSize();
+    m_mixEnabled = writeMix;
+    m_mix.clear();
+    if (m_mixEnabled) {
+        m_mix.fill(0, int(m_totalFrames * m_channels));
+    }
+
+    QDir dir(outputDirectory);
+    QString baseName = QFileInfo(midiFile).completeBaseName();
+    std::atomic<int> failures(0);
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMin(QThread::idealThreadCount(), MIDI_CHANNELS));
+    for (int channel = 0; channel < MIDI_CHANNELS; ++channel) {
+        if (used[channel]) {
+            QString waveFile = dir.absoluteFilePath(QString("%1_ch%2.wav").arg(baseName)
+                                                    .arg(channel + 1, 2, 10, QChar('0')));
+            m_files << waveFile;
+            pool.start(new StemTask(this, channel, waveFile, &failures));
+        }
+    }
+    pool.waitForDone();
+
+    bool ok = failures == 0 && !m_files.isEmpty();
+    if (m_files.isEmpty()) {
+        m_error = QStringLiteral("No channel events found");
+    } else if (failures > 0) {
+        m_error = QString("%1 stems failed to render").arg(failures.load());
+    }
+    if (ok && m_mixEnabled) {
+        QString waveFile = dir.absoluteFilePath(baseName + "_mix.wav");
+        ok = this->writeMix(waveFile);
+        m_files << waveFile;
+    }
+    m_mix.clear();
+    m_realtimeFactor = double(m_totalFrames) / m_sampleRate
+                       / qMax<qint64>(1, timer.nsecsElapsed()) * 1e9;
+    return ok;
+}
+
+bool
+StemRenderer::renderChannel(int channel, const QString &waveFile)
+{
+    SynthEngine engine;
+    if (!engine.init(m_settings->dlsSoundfont())) {
+        return false;
+    }
+    engine.initReverb(m_settings->reverbType());
+    engine.setReverbWet(m_settings->reverbWet());
+    engine.initChorus(m_settings->chorusType());
+    engine.setChorusLevel(m_settings->chorusLevel());
+
+    WaveWriter wave;
+    if (!wave.open(waveFile, engine.sampleRate(), engine.channels())) {
+        return false;
+    }
+
+    const QVector<SmfReader::Event> &events = m_smf.events();
+    const int blockSize = engine.bufferSize();
+    QVector<EAS_PCM> buffer(blockSize * engine.channels());
+    int next = 0;
+    bool ok = true;
+    for (qint64 frame = 0; ok && frame < m_totalFrames; frame += blockSize) {
+        /* events due before the end of this block; system exclusive goes to every stem */
+        qint64 blockEnd = (frame + blockSize) * 1000000 / m_sampleRate;
+        while (next < events.size() && events[next].time < blockEnd) {
+            const SmfReader::Event &event = events[next++];
+            int eventChannel = m_smf.channel(event);
+            if (eventChannel == channel || eventChannel < 0) {
+                engine.writeMIDI(m_smf.data(event), event.length);
+            }
+        }
+        EAS_I32 numGen = engine.render(buffer.data());
+        if (numGen != blockSize) {
+            qWarning() << Q_FUNC_INFO << "short block" << numGen;
+            ok = false;
+            break;
+        }
+        ok = wave.write(buffer.constData(), numGen);
+        if (m_mixEnabled) {
+            mix(buffer.constData(), frame, numGen);
+        }
+    }
+    return wave.close() && ok;
+}
+
+void
+StemRenderer::mix(const EAS_PCM *buffer, qint64 frame, int frames)
+{
+    QMutexLocker locker(&m_mixMutex);
+    qint32 *dest = m_mix.data() + frame * m_channels;
+    for (int i = 0; i < frames * m_channels; ++i) {
+        dest[i] += buffer[i];
+    }
+}
+
+bool
+StemRenderer::writeMix(const QString &waveFile)
+{
+    WaveWriter wave;
+    if (!wave.open(waveFile, m_sampleRate, m_channels)) {
+        return false;
+    }
+    const int chunkFrames = 4096;
+    QVector<EAS_PCM> buffer(chunkFrames * m_channels);
+    bool ok = true;
+    for (qint64 frame = 0; ok && frame < m_totalFrames; frame += chunkFrames) {
+        int frames = int(qMin<qint64>(chunkFrames, m_totalFrames - frame));
+        const qint32 *src = m_mix.constData() + frame * m_channels;
+        for (int i = 0; i < frames * m_channels; ++i) {
+            buffer[i] = EAS_PCM(qBound(-32768, src[i], 32767));
+        }
+        ok = wave.write(buffer.constData(), frames);
+    }
+    return wave.close() && ok;
+}
+
+QStringList
+StemRenderer::files() const
+{
+    return m_files;
+}
+
+double
+StemRenderer::realtimeFactor() const
+{
+    return m_realtimeFactor;
+}
+
+QString
+StemRenderer::errorString() const
+{
+    return m_error;
+}
@@ -0,0 +1,68 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef STEMRENDERER_H
+#define STEMRENDERER_H
+
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "programsettings.h"
+#include "smfreader.h"
+
+/*
+ * Renders every MIDI channel of a file to its own WAV file. The file is
+ * parsed once and the events of each channel are fed to a separate EAS
+ * instance; the instances run in parallel on a thread pool. All the stems
+ * have the same length, so they line up sample by sample, and the sum of
+ * them can be written as well.
+ */
+class StemRenderer
+{
+public:
+    explicit StemRenderer(ProgramSettings *settings = ProgramSettings::instance());
+
+    bool render(const QString &midiFile, const QString &outputDirectory, bool writeMix = false);
+
+    QStringList files() const;
+    double realtimeFactor() const;
+    QString errorString() const;
+
+private:
+    friend class StemTask;
+
+    bool renderChannel(int channel, const QString &waveFile);
+    void mix(const EAS_PCM *buffer, qint64 frame, int frames);
+    bool writeMix(const QString &waveFile);
+
+    ProgramSettings *m_settings;
+    SmfReader m_smf;
+    qint64 m_totalFrames;
+    int m_sampleRate;
+    int m_channels;
+    bool m_mixEnabled;
+    QMutex m_mixMutex;
+    QVector<qint32> m_mix;
+    QStringList m_files;
+    double m_realtimeFactor;
+    QString m_error;
+};
+
+#endif // STEMRENDERER_H
@@ -0,0 +1,731 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QFileInfo>
+#include <QtDebug>
+#include <atomic>
+
+#include "eas_chorus.h"
+#include "eas_reverb.h"
+#include "synthengine.h"
+#include "tracer.h"
+
+#ifdef SVOXEAS_ARENA
+/* estimates for the EAS allocations, the arena falls back to malloc when they are short */
+static const size_t ARENA_BASE_SIZE = 256 * 1024;
+static const size_t ARENA_VOICE_SIZE = 1024;
+static const size_t ARENA_FILE_SIZE = 256 * 1024;
+/* 8 bit DLS samples are expanded to 16 bits when loaded */
+static const int ARENA_DLS_FACTOR = 2;
+#endif
+
+/* files opened from now on are played from their compiled CompactSong */
+static std::atomic<bool> useCompactSongs(false);
+/* microseconds rendered after the last event of a compiled song, for the note releases */
+static const double SONG_RELEASE_TIME = 2e6;
+/* EAS_SetMaxLoad() budget per voice applied by init(), enough to never defer a note at full polyphony */
+static const EAS_I32 DEFAULT_LOAD_PER_VOICE = 40;
+
+SynthEngine::SynthEngine()
+    : m_easData(0)
+    , m_streamHandle(0)
+    , m_songHandle(0)
+    , m_fileHandle(0)
+    , m_currentFile(nullptr)
+    , m_songOpen(false)
+    , m_songIndex(0)
+    , m_songTime(0.0)
+    , m_songRate(1.0)
+    , m_sampleRate(0)
+    , m_bufferSize(0)
+    , m_channels(0)
+    , m_libVersion(0)
+    , m_maxPolyphony(0)
+    , m_maxLoad(0)
+    , m_reverbType(-1)
+    , m_chorusType(-1)
+    , m_reverbSuspended(false)
+    , m_chorusSuspended(false)
+    , m_playTime(0)
+{
+    const S_EAS_LIB_CONFIG *easConfig = EAS_Config();
+    if (easConfig != 0) {
+        m_sampleRate = easConfig->sampleRate;
+        m_bufferSize = easConfig->mixBufferSize;
+        m_channels = easConfig->numChannels;
+        m_libVersion = easConfig->libVersion;
+        m_maxPolyphony = easConfig->maxVoices;
+    }
+}
+
+SynthEngine::~SynthEngine()
+{
+    uninit();
+}
+
+bool
+SynthEngine::init(const QString &dlsFile)
+{
+    /* SONiVOX EAS initialization */
+    EAS_RESULT eas_res;
+    EAS_DATA_HANDLE dataHandle;
+    EAS_HANDLE handle;
+    EAS_HANDLE songHandle;
+
+    const S_EAS_LIB_CONFIG *easConfig = EAS_Config();
+    if (easConfig == 0) {
+        qWarning() << "EAS_Config returned null";
+        return false;
+    }
+
+    reserveArena(easConfig, dlsFile);
+    EasArena::Scope arenaScope(&m_arena);
+    eas_res = EAS_Init(&dataHandle);
+    if (eas_res != EAS_SUCCESS) {
+        qWarning() << "EAS_Init error:" << eas_res;
+        return false;
+    }
+#ifdef SVOXEAS_ARENA
+    if (m_arena.blocks() == 0) {
+        qWarning() << "The EAS host memory functions are not replaced, the arena is not used";
+        m_arena.release();
+    }
+#endif
+
+    if (!dlsFile.isEmpty()) {
+        FileWrapper dls(dlsFile);
+        if (dls.ok()) {
+            eas_res = EAS_LoadDLSCollection(dataHandle, nullptr, dls.getLocator());
+            if (eas_res != EAS_SUCCESS) {
+                qWarning() << QString("EAS_LoadDLSCollection(%1) error: %2").arg(dlsFile).arg(eas_res);
+            }
+        } else {
+            qWarning() << "Failed to open" << dlsFile;
+        }
+    }
+
+    eas_res = EAS_OpenMIDIStream(dataHandle, &handle, NULL);
+    if (eas_res != EAS_SUCCESS) {
+        qWarning() << "EAS_OpenMIDIStream error:" << eas_res;
+        EAS_Shutdown(dataHandle);
+        return false;
+    }
+    /* a virtual synth of its own, so that the song and the live input do not share channels */
+    eas_res = EAS_OpenMIDIStream(dataHandle, &songHandle, NULL);
+    if (eas_res != EAS_SUCCESS) {
+        qWarning() << "EAS_OpenMIDIStream error:" << eas_res;
+        EAS_CloseMIDIStream(dataHandle, handle);
+        EAS_Shutdown(dataHandle);
+        return false;
+    }
+
+    m_maxPolyphony = easConfig->maxVoices;
+    eas_res = EAS_GetPolyphony(dataHandle, &m_maxPolyphony);
+    if (eas_res != EAS_SUCCESS) {
+        qWarning() << "EAS_GetPolyphony error:" << eas_res;
+    }
+
+    /* EAS has no getter for the work load limit, so a known one is configured here */
+    m_maxLoad = m_maxPolyphony * DEFAULT_LOAD_PER_VOICE;
+    eas_res = EAS_SetMaxLoad(dataHandle, m_maxLoad);
+    if (eas_res != EAS_SUCCESS) {
+        qWarning() << "EAS_SetMaxLoad error:" << eas_res;
+    }
+
+    m_easData = dataHandle;
+    m_streamHandle = handle;
+    m_songHandle = songHandle;
+    m_sampleRate = easConfig->sampleRate;
+    m_bufferSize = easConfig->mixBufferSize;
+    m_channels = easConfig->numChannels;
+    m_libVersion = easConfig->libVersion;
+    m_reverbType = -1;
+    m_chorusType = -1;
+    m_reverbSuspended = false;
+    m_chorusSuspended = false;
+    return true;
+}
+
+void
+SynthEngine::uninit()
+{
+    EAS_RESULT eas_res;
+    EasArena::Scope arenaScope(&m_arena);
+    if (isPlaying()) {
+        closeFile();
+    }
+    if (m_easData != 0 && m_streamHandle != 0) {
+        eas_res = EAS_CloseMIDIStream(m_easData, m_songHandle);
+        if (eas_res != EAS_SUCCESS) {
+            qWarning() << "EAS_CloseMIDIStream error: " << eas_res;
+        }
+        m_songHandle = 0;
+        eas_res = EAS_CloseMIDIStream(m_easData, m_streamHandle);
+        if (eas_res != EAS_SUCCESS) {
+            qWarning() << "EAS_CloseMIDIStream error: " << eas_res;
+        }
+        m_streamHandle = 0;
+        eas_res = EAS_Shutdown(m_easData);
+        if (eas_res != EAS_SUCCESS) {
+            qWarning() << "EAS_Shutdown error: " << eas_res;
+        }
+        m_easData = 0;
+        if (m_arena.capacity() > 0) {
+            qDebug() << Q_FUNC_INFO << "arena peak:" << m_arena.peakBytes() << "of" << m_arena.capacity()
+                     << "overflows:" << m_arena.overflows() << "leaked blocks:" << m_arena.blocks();
+        }
+    }
+}
+
+/* keeps the storage of a previous init when it is large enough */
+void
+SynthEngine::reserveArena(const S_EAS_LIB_CONFIG *easConfig, const QString &dlsFile)
+{
+#ifdef SVOXEAS_ARENA
+    size_t size = ARENA_BASE_SIZE + ARENA_FILE_SIZE + size_t(easConfig->maxVoices) * ARENA_VOICE_SIZE;
+    if (!dlsFile.isEmpty()) {
+        size += size_t(QFileInfo(dlsFile).size()) * ARENA_DLS_FACTOR;
+    }
+    if (!m_arena.reserve(size)) {
+        qWarning() << "Failed to reserve" << size << "bytes for the EAS arena";
+    }
+#else
+    Q_UNUSED(easConfig)
+    Q_UNUSED(dlsFile)
+#endif
+}
+
+bool
+SynthEngine::isValid() const
+{
+    return m_easData != 0 && m_streamHandle != 0;
+}
+
+EAS_DATA_HANDLE
+SynthEngine::handle() const
+{
+    return m_easData;
+}
+
+int
+SynthEngine::sampleRate() const
+{
+    return m_sampleRate;
+}
+
+int
+SynthEngine::bufferSize() const
+{
+    return m_bufferSize;
+}
+
+int
+SynthEngine::channels() const
+{
+    return m_channels;
+}
+
+uint
+SynthEngine::libVersion() const
+{
+    return m_libVersion;
+}
+
+EAS_I32
+SynthEngine::maxPolyphony() const
+{
+    return m_maxPolyphony;
+}
+
+EAS_I32
+SynthEngine::maxLoad() const
+{
+    return m_maxLoad;
+}
+
+void
+SynthEngine::initReverb(int reverb_type)
+{
+    EAS_RESULT eas_res;
+    m_reverbType = reverb_type;
+    if ( reverb_type >= EAS_PARAM_REVERB_LARGE_HALL && reverb_type <= EAS_PARAM_REVERB_ROOM ) {
+        eas_res = EAS_SetParameter(m_easData, EAS_MODULE_REVERB, EAS_PARAM_REVERB_PRESET, (EAS_I32) reverb_type);
+        if (eas_res != EAS_SUCCESS) {
+            qWarning() << "EAS_SetParameter error:" << eas_res;
+        }
+    }
+    updateReverbBypass();
+}
+
+void
+SynthEngine::initChorus(int chorus_type)
+{
+    EAS_RESULT eas_res;
+    m_chorusType = chorus_type;
+    if (chorus_type >= EAS_PARAM_CHORUS_PRESET1 && chorus_type <= EAS_PARAM_CHORUS_PRESET4 ) {
+        eas_res = EAS_SetParameter(m_easData, EAS_MODULE_CHORUS, EAS_PARAM_CHORUS_PRESET, (EAS_I32) chorus_type);
+        if (eas_res != EAS_SUCCESS) {
+            qWarning() << "EAS_SetParameter error:" << eas_res;
+        }
+    }
+    updateChorusBypass();
+}
+
+int
+SynthEngine::reverbType() const
+{
+    return m_reverbType;
+}
+
+int
+SynthEngine::chorusType() const
+{
+    return m_chorusType;
+}
+
+void
+SynthEngine::suspendReverb(bool suspend)
+{
+    if (m_reverbSuspended != suspend) {
+        m_reverbSuspended = suspend;
+        updateReverbBypass();
+    }
+}
+
+void
+SynthEngine::suspendChorus(bool suspend)
+{
+    if (m_chorusSuspended != suspend) {
+        m_chorusSuspended = suspend;
+        updateChorusBypass();
+    }
+}
+
+void
+SynthEngine::updateReverbBypass()
+{
+    /* the selected preset is kept while the reverb is suspended */
+    EAS_BOOL sw = EAS_TRUE;
+    if (!m_reverbSuspended && m_reverbType >= EAS_PARAM_REVERB_LARGE_HALL
+        && m_reverbType <= EAS_PARAM_REVERB_ROOM) {
+        sw = EAS_FALSE;
+    }
+    EAS_RESULT eas_res = EAS_SetParameter(m_easData, EAS_MODULE_REVERB, EAS_PARAM_REVERB_BYPASS, sw);
+    if (eas_res != EAS_SUCCESS) {
+        qWarning() << "EAS_SetParameter error: " << eas_res;
+    }
+}
+
+void
+SynthEngine::updateChorusBypass()
+{
+    EAS_BOOL sw = EAS_TRUE;
+    if (!m_chorusSuspended && m_chorusType >= EAS_PARAM_CHORUS_PRESET1
+        && m_chorusType <= EAS_PARAM_CHORUS_PRESET4) {
+        sw = EAS_FALSE;
+    }
+    EAS_RESULT eas_res = EAS_SetParameter(m_easData, EAS_MODULE_CHORUS, EAS_PARAM_CHORUS_BYPASS, sw);
+    if (eas_res != EAS_SUCCESS) {
+        qWarning() << "EAS_SetParameter error:" << eas_res;
+    }
+}
+
+int
+SynthEngine::reverbWet()
+{
+    EAS_I32 wet = 0;
+    EAS_RESULT eas_res = EAS_GetParameter(m_easData, EAS_MODULE_REVERB, EAS_PARAM_REVERB_WET, &wet);
+    if (eas_res != EAS_SUCCESS) {
+        qWarning() << "EAS_GetParameter error:" << eas_res;
+    }
+    return wet;
+}
+
+void
+SynthEngine::setReverbWet(int amount)
+{
+    EAS_RESULT eas_res = EAS_SetParameter(m_easData, EAS_MODULE_REVERB, EAS_PARAM_REVERB_WET, (EAS_I32) amount);
+    if (eas_res != EAS_SUCCESS) {
+        qWarning() << "EAS_SetParameter error:" << eas_res;
+    }
+}
+
+int
+SynthEngine::chorusLevel()
+{
+    EAS_I32 level = 0;
+    EAS_RESULT eas_res = EAS_GetParameter(m_easData, EAS_MODULE_CHORUS, EAS_PARAM_CHORUS_LEVEL, &level);
+    if (eas_res != EAS_SUCCESS) {
+        qWarning() << "EAS_GetParameter error:" << eas_res;
+    }
+    return level;
+}
+
+void
+SynthEngine::setChorusLevel(int amount)
+{
+    EAS_RESULT eas_res = EAS_SetParameter(m_easData, EAS_MODULE_CHORUS, EAS_PARAM_CHORUS_LEVEL, (EAS_I32) amount);
+    if (eas_res != EAS_SUCCESS) {
+        qWarning() << "EAS_SetParameter error:" << eas_res;
+    }
+}
+
+void
+SynthEngine::setPolyphony(EAS_I32 polyphony)
+{
+    EAS_RESULT eas_res = EAS_SetPolyphony(m_easData, polyphony);
+    if (eas_res != EAS_SUCCESS) {
+        qWarning() << "EAS_SetPolyphony error:" << eas_res;
+    }
+}
+
+void
+SynthEngine::setMaxLoad(EAS_I32 maxLoad)
+{
+    EAS_RESULT eas_res = EAS_SetMaxLoad(m_easData, maxLoad);
+    if (eas_res != EAS_SUCCESS) {
+        qWarning() << "EAS_SetMaxLoad error:" << eas_res;
+        return;
+    }
+    m_maxLoad = maxLoad;
+}
+
+void
+SynthEngine::writeMIDI(const EAS_U8 *data, EAS_I32 count)
+{
+    if (m_easData != 0 && m_streamHandle != 0) {
+        EAS_RESULT eas_res = EAS_WriteMIDIStream(m_easData, m_streamHandle, const_cast<EAS_U8 *>(data), count);
+        if (eas_res != EAS_SUCCESS) {
+            qWarning() << "EAS_WriteMIDIStream error: " << eas_res;
+        }
+    }
+}
+
+/* the events of a compiled song, kept apart from the live input */
+void
+SynthEngine::writeSongMIDI(const EAS_U8 *data, EAS_I32 count)
+{
+    if (m_easData != 0 && m_songHandle != 0) {
+        EAS_RESULT eas_res = EAS_WriteMIDIStream(m_easData, m_songHandle, const_cast<EAS_U8 *>(data), count);
+        if (eas_res != EAS_SUCCESS) {
+            qWarning() << "EAS_WriteMIDIStream error: " << eas_res;
+        }
+    }
+}
+
+EAS_I32
+SynthEngine::render(EAS_PCM *buffer)
+{
+    TRACE_SCOPE("EAS_Render");
+    EAS_I32 numGen = 0;
+    if (m_songOpen) {
+        playSongEvents();
+    }
+    EAS_RESULT eas_res = EAS_Render(m_easData, buffer, m_bufferSize, &numGen);
+    if (eas_res != EAS_SUCCESS) {
+        qWarning() << "EAS_Render error:" << eas_res;
+    }
+    return numGen;
+}
+
+/*
+ * Without compile, a song whose compiled file is missing or stale is left
+ * to the EAS parser, so that the render thread never parses and stores it.
+ */
+bool
+SynthEngine::openFile(const QString &fileName, int duration, bool compile)
+{
+    EAS_HANDLE handle;
+    EAS_RESULT result;
+    EAS_I32 playTime;
+
+    if (isPlaying()) {
+        closeFile();
+    }
+    if (useCompactSongs) {
+        if (m_song.load(fileName, compile)) {
+            /* indexed with the song, so that a seek only looks the snapshots up */
+            m_snapshots.build(m_song);
+            m_songOpen = true;
+            m_songIndex = 0;
+            m_songTime = 0.0;
+            m_songRate = 1.0;
+            m_playTime = duration >= 0 ? duration : int(m_song.duration() / 1000);
+            return true;
+        }
+        /* the formats other than SMF are left to the EAS parsers */
+        qDebug() << Q_FUNC_INFO << fileName << m_song.errorString();
+    }
+    EasArena::Scope arenaScope(&m_arena);
+    m_currentFile = new FileWrapper(fileName);
+
+    /* call EAS library to open file */
+    if ((result = EAS_OpenFile(m_easData, m_currentFile->getLocator(), &handle)) != EAS_SUCCESS)
+    {
+        qWarning() << "EAS_OpenFile" << result;
+        delete m_currentFile;
+        m_currentFile = nullptr;
+        return false;
+    }
+    m_fileHandle = handle;
+
+    /* prepare to play the file */
+    if ((result = EAS_Prepare(m_easData, handle)) != EAS_SUCCESS)
+    {
+        qWarning() << "EAS_Prepare" << result;
+        closeFile();
+        return false;
+    }
+
+    /* get play length, unless it is already known */
+    if (duration >= 0) {
+        playTime = duration;
+    }
+    else if ((result = EAS_ParseMetaData(m_easData, handle, &playTime)) != EAS_SUCCESS)
+    {
+        qWarning() << "EAS_ParseMetaData. result=" << result;
+        closeFile();
+        return false;
+    }
+    else
+    {
+        qDebug() << "EAS_ParseMetaData. playTime=" << playTime;
+    }
+
+    m_playTime = playTime;
+    return true;
+}
+
+/*
+ * Plays a song loaded and indexed by the caller on another thread. The
+ * containers are implicitly shared, so nothing is parsed or copied here.
+ */
+bool
+SynthEngine::openSong(const CompactSong &song, const SongSnapshots &snapshots, int duration)
+{
+    if (isPlaying()) {
+        closeFile();
+    }
+    if (song.isEmpty() || snapshots.isEmpty()) {
+        return false;
+    }
+    m_song = song;
+    m_snapshots = snapshots;
+    m_songOpen = true;
+    m_songIndex = 0;
+    m_songTime = 0.0;
+    m_songRate = 1.0;
+    m_playTime = duration >= 0 ? duration : int(m_song.duration() / 1000);
+    return true;
+}
+
+/* the open file plays from a compiled song */
+bool
+SynthEngine::isSongOpen() const
+{
+    return m_songOpen;
+}
+
+bool
+SynthEngine::isPlaying() const
+{
+    return m_fileHandle != 0 || m_songOpen;
+}
+
+bool
+SynthEngine::playbackCompleted()
+{
+    if (m_songOpen) {
+        return m_songIndex >= m_song.count() && m_songTime >= m_song.duration() + SONG_RELEASE_TIME;
+    }
+    EAS_RESULT result;
+    EAS_STATE state = EAS_STATE_EMPTY;
+    if ((result = EAS_State(m_easData, m_fileHandle, &state)) != EAS_SUCCESS)
+    {
+        qWarning() << "EAS_State:" << result;
+    }
+    /* is playback complete */
+    return ((state == EAS_STATE_STOPPED) || (state == EAS_STATE_ERROR));
+}
+
+void
+SynthEngine::closeFile()
+{
+    EAS_RESULT result = EAS_SUCCESS;
+    if (m_songOpen) {
+        /* silence the song stream, as closing an EAS file does */
+        silenceChannels();
+        m_song.clear();
+        m_snapshots.clear();
+        m_songOpen = false;
+        m_playTime = 0;
+        return;
+    }
+    EasArena::Scope arenaScope(&m_arena);
+    /* close the input file */
+    if (m_fileHandle != 0 && (result = EAS_CloseFile(m_easData, m_fileHandle)) != EAS_SUCCESS)
+    {
+        qWarning() << "EAS_CloseFile" << result;
+    }
+    m_fileHandle = 0;
+    delete m_currentFile;
+    m_currentFile = nullptr;
+    m_playTime = 0;
+}
+
+int
+SynthEngine::playbackLocation()
+{
+    EAS_I32 playTime = 0;
+    EAS_RESULT result = EAS_SUCCESS;
+    if (m_songOpen) {
+        return int(m_songTime / 1000);
+    }
+    /* get the current time */
+    if ((result = EAS_GetLocation(m_easData, m_fileHandle, &playTime)) != EAS_SUCCESS)
+    {
+        qWarning() << "EAS_GetLocation" << result;
+    }
+    return playTime;
+}
+
+const EasArena &
+SynthEngine::arena() const
+{
+    return m_arena;
+}
+
+/*
+ * Plays the MIDI files opened from now on from their compiled CompactSong,
+ * feeding the events of each block to the MIDI stream, instead of opening
+ * them with the EAS file parsers. Files that are not SMF are still opened
+ * by EAS.
+ */
+void
+SynthEngine::setCompactSongs(bool enabled)
+{
+    useCompactSongs = enabled;
+}
+
+bool
+SynthEngine::compactSongs()
+{
+    return useCompactSongs;
+}
+
+/*
+ * Moves the playback of the open file to this time. A compiled song
+ * restores the MIDI state of the nearest snapshot, built when the song was
+ * opened, and applies the events up to the target. Other files are located
+ * by EAS, which parses them from the start.
+ */
+bool
+SynthEngine::seek(int milliseconds)
+{
+    if (m_songOpen) {
+        const qint64 time = qBound(qint64(0), qint64(milliseconds) * 1000, m_song.duration());
+        if (m_snapshots.isEmpty()) {
+            return false;
+        }
+        const SongSnapshots::Snapshot &snapshot = m_snapshots.find(time);
+        SongState state = snapshot.state;
+        const int index = m_song.locate(time);
+        for (int i = snapshot.index; i < index; ++i) {
+            const CompactSong::Event &event = m_song.event(i);
+            state.apply(m_song.data(event), event.length);
+        }
+        silenceChannels();
+        state.restore(*this);
+        m_songIndex = index;
+        m_songTime = double(time);
+        return true;
+    }
+    if (m_fileHandle == 0) {
+        return false;
+    }
+    EasArena::Scope arenaScope(&m_arena);
+    EAS_RESULT result = EAS_Locate(m_easData, m_fileHandle, qMax(0, milliseconds), EAS_FALSE);
+    if (result != EAS_SUCCESS) {
+        qWarning() << "EAS_Locate" << result;
+        return false;
+    }
+    return true;
+}
+
+/* only the song stream, the live input keeps sounding */
+void
+SynthEngine::silenceChannels()
+{
+    for (int channel = 0; channel < 16; ++channel) {
+        /* all sound off and reset all controllers */
+        const EAS_U8 soundOff[3] = { EAS_U8(0xB0 | channel), 120, 0 };
+        const EAS_U8 resetControllers[3] = { EAS_U8(0xB0 | channel), 121, 0 };
+        writeSongMIDI(soundOff, 3);
+        writeSongMIDI(resetControllers, 3);
+    }
+}
+
+/* writes the song events due before the end of the next block; EAS plays a file with the same block resolution */
+void
+SynthEngine::playSongEvents()
+{
+    const double end = m_songTime + m_bufferSize * 1e6 * m_songRate / m_sampleRate;
+    const int count = m_song.count();
+    while (m_songIndex < count) {
+        const CompactSong::Event &event = m_song.event(m_songIndex);
+        if (event.time >= end) {
+            break;
+        }
+        writeSongMIDI(m_song.data(event), event.length);
+        ++m_songIndex;
+    }
+    m_songTime = end;
+}
+
+int
+SynthEngine::playbackDuration() const
+{
+    return m_playTime;
+}
+
+/* speeds up or slows down the file being played, between 0.5 and 2.0 */
+bool
+SynthEngine::setPlaybackRate(double rate)
+{
+    rate = qBound(0.5, rate, 2.0);
+    if (m_songOpen) {
+        m_songRate = rate;
+        return true;
+    }
+    if (m_fileHandle == 0) {
+        return false;
+    }
+    EAS_RESULT result = EAS_SetPlaybackRate(m_easData, m_fileHandle, EAS_U32(rate * (1 << 28)));
+    if (result != EAS_SUCCESS) {
+        qWarning() << "EAS_SetPlaybackRate" << result;
+        return false;
+    }
+    return true;
+}
+
+EAS_HANDLE
+SynthEngine::fileHandle() const
+{
+    return m_fileHandle;
+}
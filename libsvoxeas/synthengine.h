@@ -0,0 +1,119 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SYNTHENGINE_H
+#define SYNTHENGINE_H
+
+#include <QString>
+#include "compactsong.h"
+#include "eas.h"
+#include "easarena.h"
+#include "filewrapper.h"
+#include "songstate.h"
+
+/*
+ * One SONiVOX EAS instance: the synth data, a MIDI stream for real time
+ * input, another one for compiled songs, and optionally a MIDI file being
+ * played. The engine is not thread
+ * safe, all the calls must be made from the thread that renders it.
+ */
+class SynthEngine
+{
+public:
+    SynthEngine();
+    ~SynthEngine();
+
+    bool init(const QString &dlsFile = QString());
+    void uninit();
+    bool isValid() const;
+
+    EAS_DATA_HANDLE handle() const;
+    int sampleRate() const;
+    int bufferSize() const;
+    int channels() const;
+    uint libVersion() const;
+    EAS_I32 maxPolyphony() const;
+    EAS_I32 maxLoad() const;
+
+    void initReverb(int reverb_type);
+    void initChorus(int chorus_type);
+    int reverbType() const;
+    int chorusType() const;
+    void suspendReverb(bool suspend);
+    void suspendChorus(bool suspend);
+    int reverbWet();
+    void setReverbWet(int amount);
+    int chorusLevel();
+    void setChorusLevel(int amount);
+    void setPolyphony(EAS_I32 polyphony);
+    void setMaxLoad(EAS_I32 maxLoad);
+
+    void writeMIDI(const EAS_U8 *data, EAS_I32 count);
+    void writeSongMIDI(const EAS_U8 *data, EAS_I32 count);
+    EAS_I32 render(EAS_PCM *buffer);
+
+    bool openFile(const QString &fileName, int duration = -1, bool compile = true);
+    bool openSong(const CompactSong &song, const SongSnapshots &snapshots, int duration = -1);
+    bool isSongOpen() const;
+    bool isPlaying() const;
+    bool playbackCompleted();
+    void closeFile();
+    int playbackLocation();
+    int playbackDuration() const;
+    bool setPlaybackRate(double rate);
+    bool seek(int milliseconds);
+    EAS_HANDLE fileHandle() const;
+    const EasArena &arena() const;
+
+    static void setCompactSongs(bool enabled);
+    static bool compactSongs();
+
+private:
+    void playSongEvents();
+    void silenceChannels();
+    void updateReverbBypass();
+    void updateChorusBypass();
+    void reserveArena(const S_EAS_LIB_CONFIG *easConfig, const QString &dlsFile);
+
+    EasArena m_arena;
+    EAS_DATA_HANDLE m_easData;
+    EAS_HANDLE m_streamHandle;
+    EAS_HANDLE m_songHandle;
+    EAS_HANDLE m_fileHandle;
+    FileWrapper *m_currentFile;
+    CompactSong m_song;
+    SongSnapshots m_snapshots;
+    bool m_songOpen;
+    int m_songIndex;
+    double m_songTime;
+    double m_songRate;
+    int m_sampleRate;
+    int m_bufferSize;
+    int m_channels;
+    uint m_libVersion;
+    EAS_I32 m_maxPolyphony;
+    EAS_I32 m_maxLoad;
+    int m_reverbType;
+    int m_chorusType;
+    bool m_reverbSuspended;
+    bool m_chorusSuspended;
+    int m_playTime;
+};
+
+#endif // SYNTHENGINE_H
@@ -0,0 +1,403 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QThread>
+#include <QtDebug>
+#include <algorithm>
+#include <functional>
+
+#include "synthpool.h"
+#include "tracer.h"
+
+/* MIDI bytes buffered per instance between two rendered blocks */
+static const size_t POOL_MIDI_BUFFER = 4096;
+/* rendered blocks an instance may buffer at least, whatever its buffer time */
+static const int POOL_MIN_BLOCKS = 2;
+/* EWMA smoothing factor of the instance load, per rendered block */
+static const double POOL_LOAD_SMOOTHING = 0.05;
+
+SynthPool::SynthPool(int threads)
+    : m_threads(threads > 0 ? threads : qMax(1, QThread::idealThreadCount()))
+    , m_nextId(0)
+    , m_stopped(true)
+    , m_steals(0)
+{
+    for (int i = 0; i < m_threads; ++i) {
+        m_workers << new Worker;
+    }
+    m_clock.start();
+}
+
+SynthPool::~SynthPool()
+{
+    stop();
+    qDeleteAll(m_instances);
+    qDeleteAll(m_workers);
+}
+
+int
+SynthPool::threads() const
+{
+    return m_threads;
+}
+
+/* with a CPU list, each worker is pinned to one CPU of the list in turn */
+void
+SynthPool::setSchedule(const ThreadSchedule &schedule)
+{
+    m_schedule = schedule;
+}
+
+/*
+ * Creates an instance with the soundfont, effects and buffer time of the
+ * given settings, which are only read here. Returns the instance id, or
+ * -1 if the engine could not be initialized or the pool is running.
+ */
+int
+SynthPool::addInstance(const ProgramSettings *settings)
+{
+    if (isRunning()) {
+        qWarning() << Q_FUNC_INFO << "the pool must be stopped";
+        return -1;
+    }
+    Instance *instance = new Instance;
+    if (!instance->engine.init(settings->dlsSoundfont())) {
+        delete instance;
+        return -1;
+    }
+    SynthEngine &engine = instance->engine;
+    engine.initReverb(settings->reverbType());
+    engine.setReverbWet(settings->reverbWet());
+    engine.initChorus(settings->chorusType());
+    engine.setChorusLevel(settings->chorusLevel());
+    instance->controls.setup(engine);
+
+    const int blockSamples = engine.bufferSize() * engine.channels();
+    const int bufferSamples = settings->bufferTime() * engine.sampleRate() / 1000 * engine.channels();
+    instance->id = m_nextId++;
+    instance->home = 0;
+    instance->midi.resize(POOL_MIDI_BUFFER);
+    instance->ring.resize(size_t(qMax(bufferSamples, POOL_MIN_BLOCKS * blockSamples)));
+    instance->block.resize(blockSamples);
+    instance->blockTime = qint64(engine.bufferSize()) * 1000000000 / engine.sampleRate();
+    instance->consumed = false;
+    instance->queued = false;
+    instance->load = 0.0;
+    instance->blocks = 0;
+    instance->misses = 0;
+    instance->underruns = 0;
+    m_instances << instance;
+    return instance->id;
+}
+
+void
+SynthPool::removeInstance(int id)
+{
+    if (isRunning()) {
+        qWarning() << Q_FUNC_INFO << "the pool must be stopped";
+        return;
+    }
+    Instance *instance = find(id);
+    if (instance != nullptr) {
+        m_instances.removeOne(instance);
+        delete instance;
+    }
+}
+
+QList<int>
+SynthPool::instances() const
+{
+    QList<int> ids;
+    for (const Instance *instance : m_instances) {
+        ids << instance->id;
+    }
+    return ids;
+}
+
+int
+SynthPool::sampleRate(int id) const
+{
+    Instance *instance = find(id);
+    return instance != nullptr ? instance->engine.sampleRate() : 0;
+}
+
+int
+SynthPool::channels(int id) const
+{
+    Instance *instance = find(id);
+    return instance != nullptr ? instance->engine.channels() : 0;
+}
+
+void
+SynthPool::start()
+{
+    if (isRunning()) {
+        return;
+    }
+    m_stopped = false;
+    m_steals = 0;
+    int i = 0;
+    for (Instance *instance : m_instances) {
+        instance->home = i++ % m_threads;
+        instance->queued = true;
+        enqueue(instance, instance->home);
+    }
+    for (int worker = 0; worker < m_threads; ++worker) {
+        m_pool.emplace_back(&SynthPool::run, this, worker);
+    }
+    qDebug() << Q_FUNC_INFO << m_instances.count() << "instances on" << m_threads << "threads";
+}
+
+void
+SynthPool::stop()
+{
+    if (!isRunning()) {
+        return;
+    }
+    m_stopped = true;
+    m_pending.release(m_threads);
+    for (std::thread &thread : m_pool) {
+        thread.join();
+    }
+    m_pool.clear();
+    m_pending.tryAcquire(m_pending.available());
+    for (Worker *worker : m_workers) {
+        worker->queue.clear();
+    }
+    for (Instance *instance : m_instances) {
+        instance->queued = false;
+    }
+    qDebug() << Q_FUNC_INFO << "steals:" << m_steals.load();
+}
+
+bool
+SynthPool::isRunning() const
+{
+    return !m_pool.empty();
+}
+
+/* a message is queued whole or not at all */
+bool
+SynthPool::writeMIDI(int id, const quint8 *data, int count)
+{
+    Instance *instance = find(id);
+    if (instance == nullptr || instance->midi.writeAvailable() < size_t(count)) {
+        return false;
+    }
+    instance->midi.write(data, size_t(count));
+    return true;
+}
+
+void
+SynthPool::initReverb(int id, int reverb_type)
+{
+    Instance *instance = find(id);
+    if (instance != nullptr) {
+        instance->controls.initReverb(reverb_type);
+    }
+}
+
+void
+SynthPool::setReverbWet(int id, int amount)
+{
+    Instance *instance = find(id);
+    if (instance != nullptr) {
+        instance->controls.setReverbWet(amount);
+    }
+}
+
+void
+SynthPool::initChorus(int id, int chorus_type)
+{
+    Instance *instance = find(id);
+    if (instance != nullptr) {
+        instance->controls.initChorus(chorus_type);
+    }
+}
+
+void
+SynthPool::setChorusLevel(int id, int amount)
+{
+    Instance *instance = find(id);
+    if (instance != nullptr) {
+        instance->controls.setChorusLevel(amount);
+    }
+}
+
+/*
+ * Consumer side: copies up to the requested frames and queues the instance
+ * again if this made room for another block. An empty ring before the
+ * first frames were read is the pool starting, not an underrun.
+ */
+int
+SynthPool::read(int id, EAS_PCM *buffer, int frames)
+{
+    Instance *instance = find(id);
+    if (instance == nullptr) {
+        return 0;
+    }
+    const int channels = instance->engine.channels();
+    int count = int(instance->ring.read(buffer, size_t(frames) * channels) / channels);
+    if (count < frames && instance->consumed && !m_stopped) {
+        ++instance->underruns;
+    }
+    instance->consumed = instance->consumed || count > 0;
+    if (!m_stopped && hasRoom(instance) && !instance->queued.exchange(true)) {
+        enqueue(instance, instance->home);
+    }
+    return count;
+}
+
+SynthPool::InstanceStatistics
+SynthPool::statistics(int id) const
+{
+    InstanceStatistics stats = { 0.0, 0, 0, 0, 0 };
+    Instance *instance = find(id);
+    if (instance != nullptr) {
+        stats.load = instance->load;
+        stats.blocks = instance->blocks;
+        stats.deadlineMisses = instance->misses;
+        stats.underruns = instance->underruns;
+        stats.buffered = int(instance->ring.readAvailable() / instance->engine.channels());
+    }
+    return stats;
+}
+
+quint64
+SynthPool::steals() const
+{
+    return m_steals;
+}
+
+SynthPool::Instance *
+SynthPool::find(int id) const
+{
+    for (Instance *instance : m_instances) {
+        if (instance->id == id) {
+            return instance;
+        }
+    }
+    return nullptr;
+}
+
+bool
+SynthPool::hasRoom(const Instance *instance) const
+{
+    return instance->ring.writeAvailable() >= size_t(instance->block.size());
+}
+
+/*
+ * The deadline is the time the buffered audio of the instance runs out,
+ * or one block from now when nothing is buffered yet.
+ */
+void
+SynthPool::enqueue(Instance *instance, int worker)
+{
+    const int channels = instance->engine.channels();
+    const qint64 buffered = qint64(instance->ring.readAvailable() / channels);
+    const qint64 frames = qMax<qint64>(buffered, instance->engine.bufferSize());
+    Task task = { m_clock.nsecsElapsed() + frames * 1000000000 / instance->engine.sampleRate(), instance };
+    Worker *w = m_workers[worker];
+    w->mutex.lock();
+    w->queue.append(task);
+    std::push_heap(w->queue.begin(), w->queue.end(), std::greater<Task>());
+    w->mutex.unlock();
+    m_pending.release();
+}
+
+/* the earliest deadline of the own queue, or else of the first other queue that has one */
+bool
+SynthPool::dequeue(int worker, Task *task)
+{
+    for (int i = 0; i < m_threads; ++i) {
+        Worker *w = m_workers[(worker + i) % m_threads];
+        QMutexLocker locker(&w->mutex);
+        if (!w->queue.isEmpty()) {
+            std::pop_heap(w->queue.begin(), w->queue.end(), std::greater<Task>());
+            *task = w->queue.takeLast();
+            if (i > 0) {
+                ++m_steals;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+SynthPool::render(const Task &task)
+{
+    TRACE_SCOPE("SynthPool::render");
+    Instance *instance = task.instance;
+    instance->controls.apply(instance->engine);
+    quint8 midi[256];
+    size_t count;
+    while ((count = instance->midi.read(midi, sizeof(midi))) > 0) {
+        instance->engine.writeMIDI(midi, EAS_I32(count));
+    }
+
+    qint64 begin = m_clock.nsecsElapsed();
+    int frames = instance->engine.render(instance->block.data());
+    qint64 end = m_clock.nsecsElapsed();
+    instance->ring.write(instance->block.constData(), size_t(frames) * instance->engine.channels());
+
+    double load = instance->load;
+    load += POOL_LOAD_SMOOTHING * (double(end - begin) / double(instance->blockTime) - load);
+    instance->load = load;
+    ++instance->blocks;
+    if (end > task.deadline) {
+        ++instance->misses;
+    }
+}
+
+void
+SynthPool::run(int worker)
+{
+    qDebug() << Q_FUNC_INFO << "worker" << worker << "started";
+    ThreadSchedule schedule = m_schedule;
+    if (!schedule.cpus().isEmpty()) {
+        schedule.setCpus(QList<int>() << schedule.cpus().at(worker % schedule.cpus().count()));
+    }
+    schedule.apply(QString("pool %1").arg(worker),
+                   m_instances.isEmpty() ? 0 : m_instances.first()->blockTime);
+    for (;;) {
+        m_pending.acquire();
+        Task task;
+        bool found = false;
+        while (!m_stopped && !(found = dequeue(worker, &task))) {
+            /* a stealing worker took our task before its own was visible */
+            std::this_thread::yield();
+        }
+        if (!found) {
+            break;
+        }
+        render(task);
+        Instance *instance = task.instance;
+        /* stays queued while there is room, now on this worker */
+        if (hasRoom(instance)) {
+            enqueue(instance, worker);
+        } else {
+            instance->queued = false;
+            if (hasRoom(instance) && !instance->queued.exchange(true)) {
+                enqueue(instance, worker);
+            }
+        }
+    }
+    qDebug() << Q_FUNC_INFO << "worker" << worker << "ended";
+}
@@ -0,0 +1,135 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SYNTHPOOL_H
+#define SYNTHPOOL_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QSemaphore>
+#include <QVector>
+#include <atomic>
+#include <thread>
+#include "enginecontrols.h"
+#include "programsettings.h"
+#include "spscring.h"
+#include "synthengine.h"
+#include "threadschedule.h"
+
+/*
+ * Many independent EAS instances rendered by a fixed set of worker threads,
+ * one per core by default, instead of one thread per instance. Each
+ * instance renders ahead into its own ring, as much as its settings buffer
+ * time allows, and the host pulls the audio with read().
+ *
+ * An instance with room in its ring is queued on one worker, ordered by the
+ * time its buffered audio runs out. Workers render the earliest deadline
+ * of their own queue first, and steal from the other queues when theirs is
+ * empty. Instances are added and removed while the pool is stopped.
+ */
+class SynthPool
+{
+public:
+    struct InstanceStatistics {
+        double load;
+        quint64 blocks;
+        quint64 deadlineMisses;
+        quint64 underruns;
+        int buffered;
+    };
+
+    explicit SynthPool(int threads = 0);
+    ~SynthPool();
+
+    int threads() const;
+    void setSchedule(const ThreadSchedule &schedule);
+
+    int addInstance(const ProgramSettings *settings);
+    void removeInstance(int id);
+    QList<int> instances() const;
+    int sampleRate(int id) const;
+    int channels(int id) const;
+
+    void start();
+    void stop();
+    bool isRunning() const;
+
+    /* one producer and one consumer thread per instance */
+    bool writeMIDI(int id, const quint8 *data, int count);
+    void initReverb(int id, int reverb_type);
+    void setReverbWet(int id, int amount);
+    void initChorus(int id, int chorus_type);
+    void setChorusLevel(int id, int amount);
+    int read(int id, EAS_PCM *buffer, int frames);
+
+    InstanceStatistics statistics(int id) const;
+    quint64 steals() const;
+
+private:
+    Q_DISABLE_COPY(SynthPool)
+
+    struct Instance {
+        int id;
+        int home;
+        SynthEngine engine;
+        EngineControls controls;
+        SpscRing<quint8> midi;
+        SpscRing<EAS_PCM> ring;
+        QVector<EAS_PCM> block;
+        qint64 blockTime;
+        bool consumed;
+        std::atomic<bool> queued;
+        std::atomic<double> load;
+        std::atomic<quint64> blocks;
+        std::atomic<quint64> misses;
+        std::atomic<quint64> underruns;
+    };
+
+    struct Task {
+        qint64 deadline;
+        Instance *instance;
+        bool operator>(const Task &other) const { return deadline > other.deadline; }
+    };
+
+    struct Worker {
+        QMutex mutex;
+        QVector<Task> queue;
+    };
+
+    Instance *find(int id) const;
+    bool hasRoom(const Instance *instance) const;
+    void enqueue(Instance *instance, int worker);
+    bool dequeue(int worker, Task *task);
+    void render(const Task &task);
+    void run(int worker);
+
+    int m_threads;
+    ThreadSchedule m_schedule;
+    QList<Instance*> m_instances;
+    int m_nextId;
+    QVector<Worker*> m_workers;
+    std::vector<std::thread> m_pool;
+    std::atomic<bool> m_stopped;
+    std::atomic<quint64> m_steals;
+    QSemaphore m_pending;
+    QElapsedTimer m_clock;
+};
+
+#endif // SYNTHPOOL_H
@@ -17,33 +17,100 @@
 */
 
 #include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QMutexLocker>
 #include <QObject>
 #include <QReadLocker>
 #include <QString>
 #include <QTextStream>
+#include <QVector>
 #include <QVersionNumber>
 #include <QWriteLocker>
 #include <QtDebug>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 #include <drumstick/sequencererror.h>
 #include <pulse/error.h>
 #include <pulse/simple.h>
 
-#include "eas_chorus.h"
-#include "eas_reverb.h"
-#include "filewrapper.h"
 #include "synthrenderer.h"
+#include "tracer.h"
 
 using namespace drumstick::ALSA;
 
+/* EAS_SetMaxLoad() budget per allowed voice while the governor is active */
+static const EAS_I32 GOVERNOR_LOAD_PER_VOICE = 10;
+/* percentage of the block time that previews may use */
+static const int PREVIEW_LOAD_SHARE = 30;
+/* silence before the render loop is suspended, in milliseconds */
+static const int IDLE_TIME = 2000;
+/* largest sample magnitude still considered silent, for decaying effect tails */
+static const int IDLE_THRESHOLD = 4;
+/* descriptors polled while suspended: the wake up eventfd and the raw MIDI inputs */
+static const int IDLE_POLL_FDS = 16;
+/* poll period of the loader thread when its eventfd could not be created, in milliseconds */
+static const int LOADER_POLL_TIME = 50;
+/* adjustments kept in the latency history */
+static const int LATENCY_HISTORY_SIZE = 64;
+/* bytes read from each raw MIDI input per rendered block */
+static const int RAWMIDI_READ_SIZE = 1024;
+/* shortest time between two seeks of a file parsed by EAS on the render thread, in milliseconds */
+static const int LOCATE_INTERVAL = 250;
+
 SynthRenderer::SynthRenderer(int bufTime, QObject *parent) : QObject(parent),
     m_Stopped(true),
     m_isPlaying(false),
-    m_bufferTime(bufTime)
+    m_pendingSeek(-1),
+    m_playbackPosition(0),
+    m_governorEnabled(false),
+    m_governorLevel(LoadGovernor::FullQuality),
+    m_defaultMaxLoad(0),
+    m_renderLoad(0.0),
+    m_engine(&m_engines[0]),
+    m_standby(&m_engines[1]),
+    m_loaderFd(-1),
+    m_loading(false),
+    m_standbyReady(false),
+    m_loaderStopped(false),
+    m_libVersion(0),
+    m_controls(ControlCount),
+    m_pendingSoundfont(nullptr),
+    m_cacheEnabled(false),
+    m_bufferTime(bufTime),
+    m_pulseHandle(nullptr),
+    m_underflows(0),
+    m_idleSuspend(false),
+    m_idleBlocks(0),
+    m_activity(false),
+    m_wakeFd(-1),
+    m_sleeping(false),
+    m_adaptiveLatency(false),
+    m_latencyFloor(bufTime),
+    m_latencyCeiling(bufTime),
+    m_currentBufferTime(bufTime),
+    m_outputLatency(0)
 {
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wakeFd < 0) {
+        qWarning() << "eventfd error:" << strerror(errno);
+    }
+    m_loaderFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_loaderFd < 0) {
+        qWarning() << "eventfd error:" << strerror(errno);
+    }
     initALSA();
     initEAS();
     initPulse();  
+    m_reverbWet.reset(m_engine->reverbWet());
+    m_chorusLevel.reset(m_engine->chorusLevel());
+    m_controls.init(ReverbTypeControl, m_engine->reverbType());
+    m_controls.init(ReverbWetControl, m_reverbWet.value());
+    m_controls.init(ChorusTypeControl, m_engine->chorusType());
+    m_controls.init(ChorusLevelControl, m_chorusLevel.value());
 }
 
 void
@@ -63,6 +130,12 @@ SynthRenderer::initALSA()
                 this,
                 &SynthRenderer::sequencerEvent,
                 Qt::UniqueConnection);
+        /* runs in the input thread, after the event has been posted to the render thread */
+        connect(m_Client,
+                &MidiClient::eventReceived,
+                this,
+                [this] { wake(); },
+                Qt::DirectConnection);
         m_Port = new MidiPort(this);
         m_Port->attach( m_Client );
         m_Port->setPortName("Synthesizer input");
@@ -89,66 +162,62 @@ SynthRenderer::initALSA()
 void
 SynthRenderer::initEAS()
 {
-    /* SONiVOX EAS initialization */
-    EAS_RESULT eas_res;
-    EAS_DATA_HANDLE dataHandle;
-    EAS_HANDLE handle;
-
-    const S_EAS_LIB_CONFIG *easConfig = EAS_Config();
-    if (easConfig == 0) {
-        qFatal("EAS_Config returned null\n");
+    if (!m_engine->init(m_soundfont)) {
+        qFatal("SONiVOX EAS initialization failed\n");
         return;
     }
+    const qint64 blockTime = qint64(m_engine->bufferSize()) * 1000000000 / m_engine->sampleRate();
+    m_governor.reset(blockTime);
+    m_governorLevel = LoadGovernor::FullQuality;
+    m_defaultMaxLoad = m_engine->maxLoad();
+    m_libVersion = m_engine->libVersion();
+    m_collector.reset(m_engine->sampleRate(), m_engine->maxPolyphony());
+    m_meter.reset(m_engine->sampleRate());
+    m_tap.reset(m_engine->sampleRate(), m_engine->channels());
+    m_previews.setup(m_engine->bufferSize(), m_engine->channels(), blockTime * PREVIEW_LOAD_SHARE / 100);
+    m_dsp.setup(m_engine->sampleRate(), m_engine->channels(), m_engine->bufferSize());
+    m_reverbWet.setup(m_engine->sampleRate(), m_engine->bufferSize());
+    m_chorusLevel.setup(m_engine->sampleRate(), m_engine->bufferSize());
+    qDebug() << Q_FUNC_INFO << "Sonivox library:" << libVersion() << "bufferSize:" << m_engine->bufferSize()
+             << "sampleRate:" << m_engine->sampleRate() << "channels:" << m_engine->channels();
+    m_loaderStopped = false;
+    m_loader = std::thread(&SynthRenderer::runLoader, this);
+}
 
-    eas_res = EAS_Init(&dataHandle);
-    if (eas_res != EAS_SUCCESS) {
-      qFatal("EAS_Init error: %ld\n", eas_res);
-      return;
-    }
-
-    if (!m_soundfont.isEmpty()) {
-      FileWrapper dlsFile(m_soundfont);
-      if (dlsFile.ok()) {
-          eas_res = EAS_LoadDLSCollection(dataHandle, nullptr, dlsFile.getLocator());
-          if (eas_res != EAS_SUCCESS) {
-              qWarning() << QString("EAS_LoadDLSCollection(%1) error: %2").arg(m_soundfont).arg(eas_res);
-          }
-      } else {
-          qWarning() << "Failed to open" << m_soundfont;
-      }
+/* the asynchronous stream is only needed to resize the buffer with adaptive latency */
+void
+SynthRenderer::initPulse()
+{
+    int err;
+    if (m_adaptiveLatency) {
+        if (!m_output.open("Synthesizer output", m_engine->sampleRate(), m_engine->channels(), m_bufferTime, &err))
+        {
+          qFatal("Failed to create PulseAudio connection. err:%d - %s", err, pa_strerror(err));
+        }
+        m_underflows = m_output.underflows();
+        qDebug() << Q_FUNC_INFO << "latency:" << m_output.latency();
+        return;
     }
-
-    eas_res = EAS_OpenMIDIStream(dataHandle, &handle, NULL);
-    if (eas_res != EAS_SUCCESS) {
-      qFatal("EAS_OpenMIDIStream error: %ld\n", eas_res);
-      EAS_Shutdown(dataHandle);
-      return;
+    m_pulseHandle = openPulse("Synthesizer output", &err);
+    if (err != PA_OK || !m_pulseHandle)
+    {
+      qFatal("Failed to create PulseAudio connection. err:%d - %s", err, pa_strerror(err));
     }
-
-    m_easData = dataHandle;
-    m_streamHandle = handle;
-    assert(m_streamHandle != 0);
-    m_sampleRate = easConfig->sampleRate;
-    m_bufferSize = easConfig->mixBufferSize;
-    m_channels = easConfig->numChannels;
-    m_libVersion = easConfig->libVersion;
-    qDebug() << Q_FUNC_INFO << "Sonivox library:" << libVersion() << "bufferSize:" << m_bufferSize
-             << "sampleRate:" << m_sampleRate << "channels:" << m_channels;
+    qDebug() << Q_FUNC_INFO << "latency:" << pa_simple_get_latency(m_pulseHandle, &err);
 }
 
-void
-SynthRenderer::initPulse()
+pa_simple *
+SynthRenderer::openPulse(const char *streamName, int *err)
 {
     pa_sample_spec samplespec;
     pa_buffer_attr bufattr;
     int period_bytes = 0;
     char *server = 0;
     char *device = 0;
-    int err;
 
     samplespec.format = PA_SAMPLE_S16LE;
-    samplespec.channels = m_channels;
-    samplespec.rate = m_sampleRate;
+    samplespec.channels = m_engine->channels();
+    samplespec.rate = m_engine->sampleRate();
 
     period_bytes = pa_usec_to_bytes(m_bufferTime * 1000, &samplespec);
     qDebug() << "period_bytes:" << period_bytes;
@@ -158,37 +227,38 @@ SynthRenderer::initPulse()
     bufattr.prebuf = (int32_t)-1;
     bufattr.fragsize = (int32_t)-1;
 
-    m_pulseHandle = pa_simple_new (server, "SonivoxEAS", PA_STREAM_PLAYBACK,
-                    device, "Synthesizer output", &samplespec,
+    *err = PA_OK;
+    return pa_simple_new (server, "SonivoxEAS", PA_STREAM_PLAYBACK,
+                    device, streamName, &samplespec,
                     NULL, /* pa_channel_map */
-                    &bufattr, &err);
-    if (err != PA_OK || !m_pulseHandle)
-    {
-      qFatal("Failed to create PulseAudio connection. err:%d - %s", err, pa_strerror(err));
-    }
-    qDebug() << Q_FUNC_INFO << "latency:" << pa_simple_get_latency(m_pulseHandle, &err);
+                    &bufattr, err);
 }
 
 void
 SynthRenderer::uninitEAS()
 {
-    EAS_RESULT eas_res;
-    if (m_easData != 0 && m_streamHandle != 0) {
-      eas_res = EAS_CloseMIDIStream(m_easData, m_streamHandle);
-      if (eas_res != EAS_SUCCESS) {
-          qWarning() << "EAS_CloseMIDIStream error: " << eas_res;
-      }
-      m_streamHandle = 0;
-      eas_res = EAS_Shutdown(m_easData);
-      if (eas_res != EAS_SUCCESS) {
-          qWarning() << "EAS_Shutdown error: " << eas_res;
-      }
-      m_easData = 0;
+    if (m_loader.joinable()) {
+        m_loaderStopped = true;
+        notifyLoader();
+        m_loader.join();
+    }
+    m_loading = false;
+    m_standbyReady = false;
+    if (m_cachedFile.isOpen()) {
+        m_cachedFile.close();
     }
+    m_engine->uninit();
+    m_standby->uninit();
+    m_standbySoundfont.clear();
 }
 
 void SynthRenderer::uninitALSA()
 {
+    for (MidiPort *port : m_ports) {
+        port->detach();
+        delete port;
+    }
+    m_ports.clear();
     if (m_Port != nullptr) {
         m_Port->detach();
         delete m_Port;
@@ -205,12 +275,17 @@ void SynthRenderer::uninitALSA()
 
 void SynthRenderer::uninitPulse()
 {
-    pa_simple_free(m_pulseHandle);
+    if (m_pulseHandle != nullptr) {
+        pa_simple_free(m_pulseHandle);
+        m_pulseHandle = nullptr;
+    }
+    m_output.close();
 }
 
 QString SynthRenderer::libVersion() const
 {
     quint8 v1, v2, v3, v4;
+    /* read once by initEAS(), the engines belong to the render thread */
     v1 = (m_libVersion >> 24) & 0xff;
     v2 = (m_libVersion >> 16) & 0xff;
     v3 = (m_libVersion >> 8) & 0xff;
@@ -235,6 +310,15 @@ SynthRenderer::~SynthRenderer()
     uninitALSA();
     uninitEAS();
     uninitPulse();
+    qDeleteAll(m_workers);
+    qDeleteAll(m_midiInputs);
+    delete m_pendingSoundfont.exchange(nullptr);
+    if (m_wakeFd >= 0) {
+        ::close(m_wakeFd);
+    }
+    if (m_loaderFd >= 0) {
+        ::close(m_loaderFd);
+    }
     qDebug() << Q_FUNC_INFO;
 }
 
@@ -251,6 +335,7 @@ SynthRenderer::stop()
 	QWriteLocker locker(&m_mutex);
     qDebug() << Q_FUNC_INFO;
     m_Stopped = true;
+    wake();
 }
 
 void
@@ -290,57 +375,148 @@ void SynthRenderer::unsubscribe(const QString &portName)
     }
 }
 
+/* must be called before the synth is started */
+bool
+SynthRenderer::addMidiInput(const QString &source)
+{
+    RawMidiInput *input = new RawMidiInput;
+    if (!input->open(source)) {
+        delete input;
+        return false;
+    }
+    m_midiInputs.append(input);
+    return true;
+}
+
+QStringList
+SynthRenderer::midiInputs() const
+{
+    QStringList sources;
+    for (RawMidiInput *input : m_midiInputs) {
+        if (input->isOpen()) {
+            sources << input->source();
+        }
+    }
+    return sources;
+}
+
 void
 SynthRenderer::run()
 {
     int pa_err;
-    unsigned char data[m_bufferSize * sizeof (EAS_PCM) * m_channels];
+    const int channels = m_engine->channels();
+    unsigned char data[m_engine->bufferSize() * sizeof (EAS_PCM) * channels];
+    QVector<EAS_PCM> mixBuffer(m_engine->bufferSize() * channels);
+    QElapsedTimer renderTimer;
+    const int idleLimit = IDLE_TIME * m_engine->sampleRate() / 1000 / m_engine->bufferSize();
     qDebug() << Q_FUNC_INFO << "started";
     try {
         m_Client->setRealTimeInput(false);
         m_Client->startSequencerInput();
         m_Stopped = false;
         m_isPlaying = false;
-        if (m_files.length() > 0) {
-            preparePlayback();
+        m_schedule.apply("render", qint64(m_engine->bufferSize()) * 1000000000 / m_engine->sampleRate());
+        applyControls();
+        if (m_adaptiveLatency) {
+            m_latency.reset(qint64(m_engine->bufferSize()) * 1000000000 / m_engine->sampleRate(),
+                            m_bufferTime, m_latencyFloor, m_latencyCeiling);
+        }
+        for (PortWorker *worker : m_workers) {
+            worker->setSchedule(m_workerSchedule);
+            worker->start();
         }
+        m_streamer.start();
         while (!stopped()) {
-            EAS_RESULT eas_res;
             EAS_I32 numGen = 0;
             size_t bytes = 0;
             QCoreApplication::sendPostedEvents();
+            applyControls();
+            readMidiInputs();
+            if (!m_isPlaying && m_files.length() > 0) {
+                preparePlayback();
+            }
             if (m_isPlaying) {
+                /* the start position of a new file waits here as a seek */
+                int seek = m_pendingSeek.exchange(-1);
+                if (seek >= 0 && !applySeek(seek)) {
+                    /* retried with the next block, unless a newer seek replaced it */
+                    int none = -1;
+                    m_pendingSeek.compare_exchange_strong(none, seek);
+                }
                 int t = getPlaybackLocation();
+                m_playbackPosition = t;
                 emit playbackTime(t);
             }
-            if (m_easData != 0)
+            if (m_engine->isValid())
             {
                 EAS_PCM *buffer = (EAS_PCM *) data;
-                eas_res = EAS_Render(m_easData, buffer, m_bufferSize, &numGen);
-                if (eas_res != EAS_SUCCESS) {
-                    qWarning() << "EAS_Render error:" << eas_res;
+                smoothControls();
+                /* the other ports render in parallel with this one */
+                for (PortWorker *worker : m_workers) {
+                    if (!worker->hasSink()) {
+                        worker->renderBlock();
+                    }
+                }
+                renderTimer.start();
+                numGen = m_engine->render(buffer);
+                updateGovernor(renderTimer.nsecsElapsed());
+                mixPorts(buffer, numGen, channels);
+                if (m_cachedFile.isOpen()) {
+                    int frames = m_cachedFile.read(mixBuffer.data(), numGen);
+                    mixSaturated(buffer, mixBuffer.constData(), frames * channels);
+                } else if (m_streamer.isOpen()) {
+                    int frames = m_streamer.read(mixBuffer.data(), numGen);
+                    mixSaturated(buffer, mixBuffer.constData(), frames * channels);
                 }
-                bytes += (size_t) numGen * sizeof(EAS_PCM) * m_channels;
+                renderPreviews(buffer, numGen);
+                m_dsp.process(buffer, numGen);
+                m_meter.process(buffer, numGen, channels);
+                m_tap.write(buffer, numGen);
+                if (m_collector.renderedFrames(numGen, m_statistics.writeBuffer())) {
+                    m_statistics.publish();
+                }
+                bytes += (size_t) numGen * sizeof(EAS_PCM) * channels;
                 // hand over to pulseaudio the rendered buffer
-                if (pa_simple_write (m_pulseHandle, data, bytes, &pa_err) < 0)
-                {
-                    qWarning() << "Error writing to PulseAudio connection:" << pa_err;
+                if (m_adaptiveLatency) {
+                    TRACE_SCOPE("pa_stream_write");
+                    if (!m_output.write(data, bytes, &pa_err))
+                    {
+                        qWarning() << "Error writing to PulseAudio connection:" << pa_err;
+                    }
+                } else {
+                    TRACE_SCOPE("pa_simple_write");
+                    if (pa_simple_write (m_pulseHandle, data, bytes, &pa_err) < 0)
+                    {
+                        qWarning() << "Error writing to PulseAudio connection:" << pa_err;
+                    }
+                }
+                if (m_adaptiveLatency) {
+                    updateLatency(buffer, numGen * channels);
+                }
+                if (m_idleSuspend && !m_isPlaying && !m_previews.isActive() && !m_cachedFile.isOpen()) {
+                    if (!silentBlock(buffer, numGen * channels, IDLE_THRESHOLD)) {
+                        m_idleBlocks = 0;
+                    } else if (++m_idleBlocks >= idleLimit) {
+                        waitForActivity();
+                    }
                 }
             }
+            /* the next file in the list is opened at the start of the next block */
             if (m_isPlaying && playbackCompleted()) {
                 closePlayback();
                 if (m_files.length() == 0) {
-                    m_isPlaying = false;
                     emit playbackStopped();
-                } else {
-                    preparePlayback();
                 }
             }
-            //qDebug() << Q_FUNC_INFO << pa_simple_get_latency(m_pulseHandle, &pa_err);
         }
         if (m_isPlaying) {
             closePlayback();
         }
+        m_streamer.stop();
+        for (PortWorker *worker : m_workers) {
+            worker->stop();
+        }
+        m_previews.clear();
         m_Client->stopSequencerInput();
     } catch (const SequencerError& err) {
         qWarning() << "SequencerError exception. Error code: " << err.code()
@@ -363,6 +539,8 @@ SynthRenderer::sequencerEvent(SequencerEvent *ev)
     case SND_SEQ_EVENT_PGMCHANGE:
     case SND_SEQ_EVENT_PITCHBEND:
         writeMIDIData(ev);
+        m_activity = true;
+        m_idleBlocks = 0;
         break;
     }
     delete ev;
@@ -371,220 +549,911 @@ SynthRenderer::sequencerEvent(SequencerEvent *ev)
 void
 SynthRenderer::writeMIDIData(SequencerEvent *ev)
 {
-    EAS_RESULT eas_res = EAS_ERROR_ALREADY_STOPPED;
+    TRACE_SCOPE("writeMIDIData");
     EAS_I32 count;
     EAS_U8 buffer[256];
+    const int port = ev->getHandle()->dest.port;
+
+    if (port != m_Port->getPortId()) {
+        PortWorker *worker = portWorker(port);
+        if (worker != nullptr) {
+            count = m_codec->decode((unsigned char *)&buffer, sizeof(buffer), ev->getHandle());
+            if (count > 0 && !worker->writeMIDI(buffer, count)) {
+                qWarning() << "MIDI buffer overflow on port" << port;
+            }
+        }
+        return;
+    }
 
-    if (m_easData != 0 && m_streamHandle != 0)
+    if (m_engine->isValid())
     {
         count = m_codec->decode((unsigned char *)&buffer, sizeof(buffer), ev->getHandle());
         if (count > 0) {
             //qDebug() << Q_FUNC_INFO << QByteArray((char *)&buffer, count).toHex();
-            eas_res = EAS_WriteMIDIStream(m_easData, m_streamHandle, buffer, count);
-            if (eas_res != EAS_SUCCESS) {
-                qWarning() << "EAS_WriteMIDIStream error: " << eas_res;
-            }
+            m_collector.midiMessage(buffer, count);
+            m_engine->writeMIDI(buffer, count);
         }
     }
 }
 
+PortWorker *
+SynthRenderer::portWorker(int port) const
+{
+    for (PortWorker *worker : m_workers) {
+        if (worker->port() == port) {
+            return worker;
+        }
+    }
+    return nullptr;
+}
+
+/* must be called before the synth is started */
 void
-SynthRenderer::initReverb(int reverb_type)
+SynthRenderer::setInputPorts(int ports, const QStringList &soundfonts, bool separateOutputs)
 {
-    EAS_RESULT eas_res;
-    EAS_BOOL sw = EAS_TRUE;
-    if ( reverb_type >= EAS_PARAM_REVERB_LARGE_HALL && reverb_type <= EAS_PARAM_REVERB_ROOM ) {
-        sw = EAS_FALSE;
-        eas_res = EAS_SetParameter(m_easData, EAS_MODULE_REVERB, EAS_PARAM_REVERB_PRESET, (EAS_I32) reverb_type);
-        if (eas_res != EAS_SUCCESS) {
-            qWarning() << "EAS_SetParameter error:" << eas_res;
+    for (int i = 1; i < ports; ++i) {
+        QString soundfont = soundfonts.value(i - 1);
+        MidiPort *port = new MidiPort(this);
+        port->attach( m_Client );
+        port->setPortName(QString("Synthesizer input %1").arg(i + 1));
+        port->setCapability( SND_SEQ_PORT_CAP_WRITE |
+                             SND_SEQ_PORT_CAP_SUBS_WRITE );
+        port->setPortType( SND_SEQ_PORT_TYPE_APPLICATION |
+                           SND_SEQ_PORT_TYPE_MIDI_GENERIC );
+        PortWorker *worker = new PortWorker(port->getPortId(), soundfont);
+        if (!worker->init()) {
+            qWarning() << "SONiVOX EAS initialization failed for port" << i + 1;
+            delete worker;
+            port->detach();
+            delete port;
+            continue;
+        }
+        if (separateOutputs) {
+            int err;
+            QByteArray name = QString("Synthesizer output %1").arg(i + 1).toUtf8();
+            pa_simple *sink = openPulse(name.constData(), &err);
+            if (sink != nullptr) {
+                worker->setSink(sink);
+            } else {
+                qWarning() << "Failed to create PulseAudio connection for port" << i + 1
+                           << "err:" << pa_strerror(err) << "- mixing it instead";
+            }
         }
+        worker->initReverb(m_controls.value(ReverbTypeControl));
+        worker->setReverbWet(m_controls.value(ReverbWetControl));
+        worker->initChorus(m_controls.value(ChorusTypeControl));
+        worker->setChorusLevel(m_controls.value(ChorusLevelControl));
+        m_ports.append(port);
+        m_workers.append(worker);
+        qDebug() << Q_FUNC_INFO << port->getPortName() << soundfont << separateOutputs;
     }
-    eas_res = EAS_SetParameter(m_easData, EAS_MODULE_REVERB, EAS_PARAM_REVERB_BYPASS, sw);
-    if (eas_res != EAS_SUCCESS) {
-        qWarning() << "EAS_SetParameter error: " << eas_res;
+}
+
+int
+SynthRenderer::inputPorts() const
+{
+    return m_workers.count() + 1;
+}
+
+void
+SynthRenderer::mixPorts(EAS_PCM *buffer, int frames, int channels)
+{
+    for (PortWorker *worker : m_workers) {
+        if (!worker->hasSink()) {
+            const EAS_PCM *block;
+            int count = worker->waitBlock(&block);
+            mixSaturated(buffer, block, qMin(count, frames) * channels);
+        }
     }
-    //qDebug() << Q_FUNC_INFO << reverb_type << sw;
 }
 
 void
-SynthRenderer::initChorus(int chorus_type)
+SynthRenderer::readMidiInputs()
 {
-    EAS_RESULT eas_res;
-    EAS_BOOL sw = EAS_TRUE;
-    if (chorus_type >= EAS_PARAM_CHORUS_PRESET1 && chorus_type <= EAS_PARAM_CHORUS_PRESET4 ) {
-        sw = EAS_FALSE;
-        eas_res = EAS_SetParameter(m_easData, EAS_MODULE_CHORUS, EAS_PARAM_CHORUS_PRESET, (EAS_I32) chorus_type);
-        if (eas_res != EAS_SUCCESS) {
-            qWarning() << "EAS_SetParameter error:" << eas_res;
+    if (m_midiInputs.isEmpty() || !m_engine->isValid()) {
+        return;
+    }
+    TRACE_SCOPE("readMidiInputs");
+    quint8 buffer[RAWMIDI_READ_SIZE];
+    EAS_U8 batch[RAWMIDI_READ_SIZE];
+    int length = 0;
+    /* complete messages from all the inputs are written to EAS at once */
+    auto message = [&](const quint8 *data, int count) {
+        if (length + count > RAWMIDI_READ_SIZE) {
+            m_engine->writeMIDI(batch, length);
+            length = 0;
+        }
+        memcpy(batch + length, data, size_t(count));
+        length += count;
+        m_collector.midiMessage(data, count);
+        m_activity = true;
+        m_idleBlocks = 0;
+    };
+    for (RawMidiInput *input : m_midiInputs) {
+        if (input->isOpen()) {
+            int count = input->read(buffer, sizeof(buffer));
+            if (count > 0) {
+                input->parser().parse(buffer, count, message);
+            }
         }
     }
-    eas_res = EAS_SetParameter(m_easData, EAS_MODULE_CHORUS, EAS_PARAM_CHORUS_BYPASS, sw);
-    if (eas_res != EAS_SUCCESS) {
-        qWarning() << "EAS_SetParameter error:" << eas_res;
+    if (length > 0) {
+        m_engine->writeMIDI(batch, length);
     }
-    //qDebug() << Q_FUNC_INFO << chorus_type << sw;
 }
 
-int SynthRenderer::reverbWet()
+void
+SynthRenderer::updateGovernor(qint64 renderTime)
 {
-    EAS_I32 wet = 0;
-    EAS_RESULT eas_res = EAS_GetParameter(m_easData, EAS_MODULE_REVERB, EAS_PARAM_REVERB_WET, &wet);
-    if (eas_res != EAS_SUCCESS) {
-        qWarning() << "EAS_GetParameter error:" << eas_res;
+    /* while disabled the load is still measured, but the level stays at full quality */
+    m_governor.update(renderTime, m_governorEnabled);
+    m_renderLoad = m_governor.load();
+    int level = m_governor.level();
+    if (level != m_governorLevel) {
+        applyGovernorLevel(level);
+        m_governorLevel = level;
+        qWarning() << "Load governor:" << LoadGovernor::levelName(level)
+                   << "render load:" << m_governor.load();
+        emit governorLevelChanged(level);
     }
-    //qDebug() << Q_FUNC_INFO << wet;
-    return wet;
 }
 
 void
-SynthRenderer::setReverbWet(int amount)
+SynthRenderer::applyGovernorLevel(int level)
 {
-    EAS_RESULT eas_res = EAS_SetParameter(m_easData, EAS_MODULE_REVERB, EAS_PARAM_REVERB_WET, (EAS_I32) amount);
-    if (eas_res != EAS_SUCCESS) {
-        qWarning() << "EAS_SetParameter error:" << eas_res;
+    EAS_I32 maxPolyphony = m_engine->maxPolyphony();
+    EAS_I32 polyphony = maxPolyphony;
+    if (level >= LoadGovernor::MinimalPolyphony) {
+        polyphony = maxPolyphony / 2;
+    } else if (level == LoadGovernor::ReducedPolyphony) {
+        polyphony = maxPolyphony * 3 / 4;
     }
+    polyphony = qMax<EAS_I32>(1, polyphony);
+    m_engine->setPolyphony(polyphony);
+    m_collector.setPolyphony(polyphony);
+    m_engine->setMaxLoad(level == LoadGovernor::FullQuality ? m_defaultMaxLoad
+                                                           : polyphony * GOVERNOR_LOAD_PER_VOICE);
+    /* the user selected presets are kept, only the bypass switches are toggled */
+    m_engine->suspendChorus(level >= LoadGovernor::ChorusBypassed);
+    m_engine->suspendReverb(level >= LoadGovernor::ReverbBypassed);
+}
+
+void
+SynthRenderer::setGovernorEnabled(bool enabled)
+{
+    m_governorEnabled = enabled;
+}
+
+bool
+SynthRenderer::governorEnabled() const
+{
+    return m_governorEnabled;
+}
+
+int
+SynthRenderer::governorLevel() const
+{
+    return m_governorLevel;
+}
+
+double
+SynthRenderer::renderLoad() const
+{
+    return m_renderLoad;
+}
+
+SynthStatistics
+SynthRenderer::statistics()
+{
+    m_statistics.update();
+    return m_statistics.readBuffer();
+}
+
+float
+SynthRenderer::peakLevel(int channel)
+{
+    return m_meter.peak(channel);
+}
+
+float
+SynthRenderer::rmsLevel(int channel) const
+{
+    return m_meter.rms(channel);
+}
+
+AudioTap *
+SynthRenderer::audioTap()
+{
+    return &m_tap;
+}
+
+void
+SynthRenderer::initReverb(int reverb_type)
+{
+    m_controls.set(ReverbTypeControl, reverb_type);
+    //qDebug() << Q_FUNC_INFO << reverb_type;
+}
+
+void
+SynthRenderer::initChorus(int chorus_type)
+{
+    m_controls.set(ChorusTypeControl, chorus_type);
+    //qDebug() << Q_FUNC_INFO << chorus_type;
+}
+
+int SynthRenderer::reverbWet() const
+{
+    return m_controls.value(ReverbWetControl);
+}
+
+void
+SynthRenderer::setReverbWet(int amount)
+{
+    m_controls.set(ReverbWetControl, amount);
     //qDebug() << Q_FUNC_INFO << amount;
 }
 
-int SynthRenderer::chorusLevel()
+int SynthRenderer::chorusLevel() const
 {
-    EAS_I32 level = 0;
-    EAS_RESULT eas_res = EAS_GetParameter(m_easData,
-                                          EAS_MODULE_CHORUS,
-                                          EAS_PARAM_CHORUS_LEVEL,
-                                          &level);
-    if (eas_res != EAS_SUCCESS) {
-        qWarning() << "EAS_GetParameter error:" << eas_res;
-    }
-    //qDebug() << Q_FUNC_INFO << level;
-    return level;
+    return m_controls.value(ChorusLevelControl);
 }
 
 void
 SynthRenderer::setChorusLevel(int amount)
 {
-    EAS_RESULT eas_res = EAS_SetParameter(m_easData, EAS_MODULE_CHORUS, EAS_PARAM_CHORUS_LEVEL, (EAS_I32) amount);
-    if (eas_res != EAS_SUCCESS) {
-        qWarning() << "EAS_SetParameter error:" << eas_res;
-    }
+    m_controls.set(ChorusLevelControl, amount);
     //qDebug() << Q_FUNC_INFO << amount;
 }
 
 void SynthRenderer::initSoundfont(const QString &dlsFile)
 {
-    if (m_soundfont != dlsFile) {
-        m_soundfont = dlsFile;
-        uninitEAS();
-        initEAS();
+    /* only the most recent request is kept until the render thread takes it */
+    delete m_pendingSoundfont.exchange(new QString(dlsFile));
+}
+
+void
+SynthRenderer::applyControls()
+{
+    TRACE_SCOPE("applyControls");
+    if (m_standbyReady) {
+        /* cleared first, so that the loader does not take the request again */
+        m_loading = false;
+        m_standbyReady = false;
+        swapEngines();
+    }
+    /* a newer request waits until the one being loaded is live */
+    if (!m_loading) {
+        QString *dlsFile = m_pendingSoundfont.exchange(nullptr);
+        if (dlsFile != nullptr) {
+            if (m_soundfont == *dlsFile) {
+                /* already live */
+            } else if (m_standby->isValid() && m_standbySoundfont == *dlsFile) {
+                swapEngines();
+            } else {
+                m_standbySoundfont = *dlsFile;
+                m_loading = true;
+                notifyLoader();
+            }
+            delete dlsFile;
+        }
+    }
+
+    /* a preset resets its level unless a newer level follows in the same batch */
+    bool reverbPreset = false;
+    bool chorusPreset = false;
+    int parameter, value;
+    while (m_controls.next(parameter, value)) {
+        switch (parameter) {
+        case ReverbTypeControl:
+            m_engine->initReverb(value);
+            m_streamer.initReverb(value);
+            for (PortWorker *worker : m_workers) {
+                worker->initReverb(value);
+            }
+            reverbPreset = value >= 0;
+            if (reverbPreset) {
+                m_reverbWet.reset(m_engine->reverbWet());
+            }
+            break;
+        case ReverbWetControl:
+            m_reverbWet.setTarget(value);
+            m_streamer.setReverbWet(value);
+            for (PortWorker *worker : m_workers) {
+                worker->setReverbWet(value);
+            }
+            reverbPreset = false;
+            break;
+        case ChorusTypeControl:
+            m_engine->initChorus(value);
+            m_streamer.initChorus(value);
+            for (PortWorker *worker : m_workers) {
+                worker->initChorus(value);
+            }
+            chorusPreset = value >= 0;
+            if (chorusPreset) {
+                m_chorusLevel.reset(m_engine->chorusLevel());
+            }
+            break;
+        case ChorusLevelControl:
+            m_chorusLevel.setTarget(value);
+            m_streamer.setChorusLevel(value);
+            for (PortWorker *worker : m_workers) {
+                worker->setChorusLevel(value);
+            }
+            chorusPreset = false;
+            break;
+        }
+    }
+    if (reverbPreset) {
+        emit reverbWetChanged(m_reverbWet.value());
+    }
+    if (chorusPreset) {
+        emit chorusLevelChanged(m_chorusLevel.value());
     }
 }
 
+/*
+ * The loader thread lives as long as the engines. It waits for the render
+ * thread to set m_loading, and then loads m_standbySoundfont.
+ */
 void
-SynthRenderer::playFile(const QString fileName)
+SynthRenderer::runLoader()
 {
-    qDebug() << Q_FUNC_INFO << fileName;
-    m_files.append(fileName);
+    while (!m_loaderStopped) {
+        if (m_loading && !m_standbyReady) {
+            loadStandby();
+            continue;
+        }
+        struct pollfd fd;
+        fd.fd = m_loaderFd;
+        fd.events = POLLIN;
+        fd.revents = 0;
+        while (poll(&fd, 1, m_loaderFd < 0 ? LOADER_POLL_TIME : -1) < 0 && errno == EINTR) { }
+        quint64 count;
+        while (::read(m_loaderFd, &count, sizeof(count)) > 0) { }
+    }
 }
 
 void
-SynthRenderer::preparePlayback()
+SynthRenderer::notifyLoader()
 {
-    EAS_HANDLE handle;
-    EAS_RESULT result;
-    EAS_I32 playTime;
+    quint64 one = 1;
+    if (m_loaderFd >= 0 && ::write(m_loaderFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        qWarning() << "eventfd write error:" << strerror(errno);
+    }
+}
 
-    m_currentFile = new FileWrapper(m_files.first());
-    m_files.removeFirst();
+/*
+ * Runs on the loader thread while the render thread keeps playing with the
+ * live engine. Parsing a large DLS file may take seconds.
+ */
+void
+SynthRenderer::loadStandby()
+{
+    TRACE_SCOPE("loadStandby");
+    QElapsedTimer timer;
+    timer.start();
+    m_standby->uninit();
+    if (!m_standby->init(m_standbySoundfont)) {
+        qWarning() << "Failed to load" << m_standbySoundfont;
+    }
+    /* the render thread needs it for the render cache keys, and cannot hash a large file */
+    m_standbySoundfontDigest = m_cacheEnabled ? RenderCache::fileDigest(m_standbySoundfont) : QByteArray();
+    qDebug() << Q_FUNC_INFO << m_standbySoundfont << timer.elapsed() << "ms";
+    m_standbyReady = true;
+}
 
-    /* call EAS library to open file */
-    if ((result = EAS_OpenFile(m_easData, m_currentFile->getLocator(), &handle)) != EAS_SUCCESS)
-    {
-        qWarning() << "EAS_OpenFile" << result;
+/*
+ * Makes the standby engine live with the current effect settings. The old
+ * engine is silenced and kept as the standby, so switching back to its
+ * soundfont does not load it again. A file being played is opened again
+ * with the new soundfont, at the same position.
+ */
+void
+SynthRenderer::swapEngines()
+{
+    if (!m_standby->isValid()) {
+        m_standbySoundfont.clear();
         return;
     }
+    if (m_isPlaying) {
+        PlaybackRequest request = m_playback;
+        const int seek = m_pendingSeek;
+        request.start = seek >= 0 ? seek : getPlaybackLocation();
+        closePlayback();
+        m_files.prepend(request);
+    }
+    for (int channel = 0; channel < 16; ++channel) {
+        /* all sound off and reset all controllers */
+        const EAS_U8 soundOff[3] = { EAS_U8(0xB0 | channel), 120, 0 };
+        const EAS_U8 resetControllers[3] = { EAS_U8(0xB0 | channel), 121, 0 };
+        m_engine->writeMIDI(soundOff, 3);
+        m_engine->writeMIDI(resetControllers, 3);
+    }
+    const int reverbType = m_engine->reverbType();
+    const int chorusType = m_engine->chorusType();
+    std::swap(m_engine, m_standby);
+    std::swap(m_soundfont, m_standbySoundfont);
+    std::swap(m_soundfontDigest, m_standbySoundfontDigest);
+    m_engine->initReverb(reverbType);
+    m_engine->setReverbWet(m_reverbWet.value());
+    m_engine->initChorus(chorusType);
+    m_engine->setChorusLevel(m_chorusLevel.value());
+    applyGovernorLevel(m_governorLevel);
+    qDebug() << Q_FUNC_INFO << m_soundfont;
+}
 
-    /* prepare to play the file */
-    if ((result = EAS_Prepare(m_easData, handle)) != EAS_SUCCESS)
-    {
-        qWarning() << "EAS_Prepare" << result;
-        return;
+void
+SynthRenderer::smoothControls()
+{
+    if (m_reverbWet.next()) {
+        m_engine->setReverbWet(m_reverbWet.value());
     }
+    if (m_chorusLevel.next()) {
+        m_engine->setChorusLevel(m_chorusLevel.value());
+    }
+}
 
-    /* get play length */
-    if ((result = EAS_ParseMetaData(m_easData, handle, &playTime)) != EAS_SUCCESS)
-    {
-        qWarning() << "EAS_ParseMetaData. result=" << result;
+/* must be called before the synth is started */
+void
+SynthRenderer::setRenderCacheEnabled(bool enabled)
+{
+    m_cacheEnabled = enabled;
+    if (enabled && m_soundfontDigest.isEmpty() && !m_soundfont.isEmpty()) {
+        m_soundfontDigest = RenderCache::fileDigest(m_soundfont);
+    }
+}
+
+void
+SynthRenderer::setRenderCacheSize(int megabytes)
+{
+    m_cache.setMaxSize(qint64(megabytes) * 1024 * 1024);
+}
+
+/* must be called before the synth is started */
+void
+SynthRenderer::setLibraryIndex(const LibraryIndex &index)
+{
+    m_library = index;
+}
+
+/* must be called before the synth is started */
+void
+SynthRenderer::setRenderAhead(int milliseconds)
+{
+    m_streamer.setup(m_engine->sampleRate(), m_engine->channels(), milliseconds);
+}
+
+/* must be called before the synth is started */
+void
+SynthRenderer::setScheduling(const ThreadSchedule &render, const ThreadSchedule &workers)
+{
+    m_schedule = render;
+    m_workerSchedule = workers;
+    m_streamer.setCpus(workers.cpus());
+}
+
+void
+SynthRenderer::setDspParameter(DspChain::Parameter parameter, int value)
+{
+    m_dsp.setParameter(parameter, value);
+}
+
+int
+SynthRenderer::dspParameter(DspChain::Parameter parameter) const
+{
+    return m_dsp.parameter(parameter);
+}
+
+/* must be called before the synth is started, startPlayback() is for a running synth */
+void
+SynthRenderer::playFile(const QString fileName)
+{
+    qDebug() << Q_FUNC_INFO << fileName;
+    m_files.append(playbackRequest(fileName));
+    wake();
+}
+
+/*
+ * The file is hashed and its song compiled, loaded and indexed by the
+ * caller. The render thread only combines the digests and takes the song.
+ */
+SynthRenderer::PlaybackRequest
+SynthRenderer::playbackRequest(const QString &fileName, int start) const
+{
+    PlaybackRequest request;
+    request.fileName = fileName;
+    request.start = qMax(0, start);
+    if (m_cacheEnabled) {
+        request.digest = RenderCache::fileDigest(fileName);
+    }
+    if (SynthEngine::compactSongs() && request.song.load(fileName)) {
+        request.snapshots.build(request.song);
+    }
+    return request;
+}
+
+bool
+SynthRenderer::openCachedFile(const QByteArray &digest)
+{
+    RenderParameters params;
+    params.soundfont = m_soundfont;
+    params.reverbType = m_engine->reverbType();
+    params.reverbWet = m_reverbWet.target();
+    params.chorusType = m_engine->chorusType();
+    params.chorusLevel = m_chorusLevel.target();
+    params.compactSongs = SynthEngine::compactSongs();
+    params.libVersion = m_engine->libVersion();
+    params.sampleRate = m_engine->sampleRate();
+    params.channels = m_engine->channels();
+    if (m_cache.lookup(m_cache.key(digest, m_soundfontDigest, params), m_cachedFile)) {
+        if (m_cachedFile.sampleRate() == m_engine->sampleRate()
+            && m_cachedFile.channels() == m_engine->channels()) {
+            return true;
+        }
+        m_cachedFile.close();
+    }
+    return false;
+}
+
+void
+SynthRenderer::preparePlayback()
+{
+    TRACE_SCOPE("preparePlayback");
+    m_playback = m_files.takeFirst();
+    const PlaybackRequest &request = m_playback;
+    const QString &fileName = request.fileName;
+
+    /* a cached render is streamed instead of synthesizing the file again */
+    if (m_cacheEnabled && openCachedFile(request.digest)) {
+        qDebug() << Q_FUNC_INFO << "cached" << fileName;
+        startAt(request.start);
+        m_isPlaying = true;
         return;
     }
-    else
-    {
-        qDebug() << "EAS_ParseMetaData. playTime=" << playTime;
+
+    /* an indexed file does not need to be parsed twice to learn its length */
+    LibraryEntry entry;
+    int duration = m_library.lookup(fileName, entry) && entry.valid ? entry.duration : -1;
+    if (m_streamer.isEnabled()) {
+        m_streamer.initReverb(m_engine->reverbType());
+        m_streamer.setReverbWet(m_reverbWet.target());
+        m_streamer.initChorus(m_engine->chorusType());
+        m_streamer.setChorusLevel(m_chorusLevel.target());
+        if (!m_streamer.open(fileName, m_soundfont, duration, request.start)) {
+            return;
+        }
+    } else {
+        bool opened = request.song.isEmpty()
+                ? m_engine->openFile(fileName, duration, false)
+                : m_engine->openSong(request.song, request.snapshots, duration);
+        if (!opened) {
+            return;
+        }
+        startAt(request.start);
     }
 
     qDebug() << Q_FUNC_INFO;
-    m_midiFileHandle = handle;
     m_isPlaying = true;
 }
 
+/* the start position waits with the seeks, unless a newer seek is already waiting */
+void
+SynthRenderer::startAt(int milliseconds)
+{
+    if (milliseconds > 0) {
+        int none = -1;
+        m_pendingSeek.compare_exchange_strong(none, milliseconds);
+    }
+}
+
 bool
 SynthRenderer::playbackCompleted()
 {
-    EAS_RESULT result;
-    EAS_STATE state = EAS_STATE_EMPTY;
-    if ((result = EAS_State(m_easData, m_midiFileHandle, &state)) != EAS_SUCCESS)
-    {
-        qWarning() << "EAS_State:" << result;
+    if (m_cachedFile.isOpen()) {
+        return m_cachedFile.atEnd();
+    }
+    if (m_streamer.isOpen()) {
+        return m_streamer.atEnd();
     }
-    //qDebug() << Q_FUNC_INFO << state;
-    /* is playback complete */
-    return ((state == EAS_STATE_STOPPED) || (state == EAS_STATE_ERROR));
+    return m_engine->playbackCompleted();
 }
 
 void
 SynthRenderer::closePlayback()
 {
     qDebug() << Q_FUNC_INFO;
-    EAS_RESULT result = EAS_SUCCESS;
-    /* close the input file */
-    if ((result = EAS_CloseFile(m_easData, m_midiFileHandle)) != EAS_SUCCESS)
-    {
-        qWarning() << "EAS_CloseFile" << result;
+    if (m_cachedFile.isOpen()) {
+        m_cachedFile.close();
+    } else if (m_streamer.isOpen()) {
+        m_streamer.close();
+    } else {
+        m_engine->closeFile();
     }
-    m_midiFileHandle = 0;
-    delete m_currentFile;
-    m_currentFile = 0;
     m_isPlaying = false;
+    m_pendingSeek = -1;
+    m_playbackPosition = 0;
 }
 
 int
 SynthRenderer::getPlaybackLocation()
 {
-    EAS_I32 playTime = 0;
-    EAS_RESULT result = EAS_SUCCESS;
-    /* get the current time */
-    if ((result = EAS_GetLocation(m_easData, m_midiFileHandle, &playTime)) != EAS_SUCCESS)
-    {
-        qWarning() << "EAS_GetLocation" << result;
+    if (m_cachedFile.isOpen()) {
+        return int(m_cachedFile.position() * 1000 / m_cachedFile.sampleRate());
+    }
+    if (m_streamer.isOpen()) {
+        return m_streamer.position();
     }
-    //qDebug() << Q_FUNC_INFO << playTime;
-    return playTime;
+    return m_engine->playbackLocation();
 }
 
+/*
+ * any thread: the render thread replaces the current file between two blocks,
+ * and starts playing it from this position in milliseconds
+ */
 void
-SynthRenderer::startPlayback(const QString fileName)
+SynthRenderer::startPlayback(const QString fileName, int start)
 {
     if (!stopped())
     {
-        playFile(fileName);
-        preparePlayback();
+        PlaybackRequest request = playbackRequest(fileName, start);
+        QMetaObject::invokeMethod(this, [this, request] {
+            if (m_isPlaying) {
+                closePlayback();
+            }
+            /* a seek of the previous file does not apply to this one */
+            m_pendingSeek = -1;
+            m_files.prepend(request);
+            m_activity = true;
+        }, Qt::QueuedConnection);
+        wake();
     }
 }
 
+/* any thread */
 void
 SynthRenderer::stopPlayback()
 {
     if (!stopped()) {
-        closePlayback();
+        QMetaObject::invokeMethod(this, [this] {
+            if (m_isPlaying) {
+                closePlayback();
+            }
+        }, Qt::QueuedConnection);
+        wake();
+    }
+}
+
+/* moves the file playback to this time, in milliseconds from the start of the song */
+void
+SynthRenderer::seekPlayback(int milliseconds)
+{
+    m_pendingSeek = qMax(0, milliseconds);
+    wake();
+}
+
+/* the playback location last seen by the render thread */
+int
+SynthRenderer::playbackPosition() const
+{
+    return m_playbackPosition;
+}
+
+/*
+ * A compiled song, a cached render and the streamer seek at a bounded cost.
+ * A file parsed by EAS is located from its start on this thread, so while
+ * scrubbing it is located at most once per LOCATE_INTERVAL; false means the
+ * seek has to wait.
+ */
+bool
+SynthRenderer::applySeek(int milliseconds)
+{
+    TRACE_SCOPE("applySeek");
+    if (m_cachedFile.isOpen()) {
+        m_cachedFile.seek(qint64(milliseconds) * m_cachedFile.sampleRate() / 1000);
+    } else if (m_streamer.isOpen()) {
+        m_streamer.seek(milliseconds);
+    } else if (m_engine->isSongOpen()) {
+        m_engine->seek(milliseconds);
+    } else {
+        if (m_locateTimer.isValid() && m_locateTimer.elapsed() < LOCATE_INTERVAL) {
+            return false;
+        }
+        m_locateTimer.start();
+        m_engine->seek(milliseconds);
+    }
+    return true;
+}
+
+/* must be called before the synth is started */
+void
+SynthRenderer::setIdleSuspend(bool enabled)
+{
+    m_idleSuspend = enabled && m_wakeFd >= 0;
+}
+
+bool
+SynthRenderer::suspended() const
+{
+    return m_sleeping;
+}
+
+/*
+ * Blocks the render thread until a MIDI event arrives or the synth is
+ * asked to do something. The output stream is left without data, so the
+ * sound server lets it run empty; writing resumes with the next block.
+ */
+void
+SynthRenderer::waitForActivity()
+{
+    quint64 count;
+    m_activity = false;
+    m_sleeping = true;
+    while (::read(m_wakeFd, &count, sizeof(count)) > 0) { }
+    /* anything posted before m_sleeping was set has not woken us up */
+    QCoreApplication::sendPostedEvents();
+    readMidiInputs();
+    if (!m_activity && !stopped()) {
+        qDebug() << Q_FUNC_INFO << "suspended";
+        struct pollfd fds[IDLE_POLL_FDS];
+        fds[0].fd = m_wakeFd;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        int nfds = 1;
+        for (RawMidiInput *input : m_midiInputs) {
+            if (input->isOpen()) {
+                nfds += input->pollDescriptors(fds + nfds, IDLE_POLL_FDS - nfds);
+            }
+        }
+        /* clock and active sensing wake the thread too, without being activity */
+        do {
+            while (poll(fds, nfds, -1) < 0 && errno == EINTR) { }
+            while (::read(m_wakeFd, &count, sizeof(count)) > 0) { }
+            QCoreApplication::sendPostedEvents();
+            readMidiInputs();
+        } while (!m_activity && !stopped());
+        qDebug() << Q_FUNC_INFO << "resumed";
+    }
+    m_sleeping = false;
+    m_idleBlocks = 0;
+    if (m_adaptiveLatency) {
+        m_latency.resume();
+    }
+}
+
+/* any thread */
+void
+SynthRenderer::wake()
+{
+    if (m_sleeping) {
+        quint64 one = 1;
+        if (::write(m_wakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            qWarning() << "eventfd write error:" << strerror(errno);
+        }
+    }
+}
+
+bool
+SynthRenderer::silentBlock(const EAS_PCM *buffer, int samples, int threshold)
+{
+    for (int i = 0; i < samples; ++i) {
+        if (buffer[i] > threshold || buffer[i] < -threshold) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* must be called before the synth is started, in milliseconds */
+void
+SynthRenderer::setAdaptiveLatency(bool enabled, int floor, int ceiling)
+{
+    if (enabled != m_adaptiveLatency) {
+        /* the output stream of the other kind replaces the one opened by the constructor */
+        uninitPulse();
+        m_adaptiveLatency = enabled;
+        initPulse();
+    }
+    m_latencyFloor = floor;
+    m_latencyCeiling = ceiling;
+}
+
+/* buffer time of the output stream in milliseconds */
+int
+SynthRenderer::bufferTime() const
+{
+    return m_currentBufferTime;
+}
+
+/* last latency reported by the output stream in milliseconds, if adaptive */
+int
+SynthRenderer::outputLatency() const
+{
+    return m_outputLatency / 1000;
+}
+
+QVector<LatencyChange>
+SynthRenderer::latencyHistory() const
+{
+    QMutexLocker locker(&m_historyMutex);
+    return m_latencyHistory;
+}
+
+void
+SynthRenderer::updateLatency(const EAS_PCM *buffer, int samples)
+{
+    /* counted by the sound server, those of a suspension fall in the warm-up */
+    quint32 underflows = m_output.underflows();
+    bool underrun = underflows != m_underflows;
+    m_underflows = underflows;
+    qint64 latency = m_output.latency();
+    if (latency >= 0) {
+        m_outputLatency = int(latency);
+    }
+    m_latency.update(underrun);
+    if (!m_latency.pending()) {
+        return;
+    }
+    if (!m_latency.ready(silentBlock(buffer, samples, 0))) {
+        return;
+    }
+    LatencyChange change;
+    change.time = m_latency.elapsed();
+    change.from = m_latency.bufferTime();
+    change.to = m_latency.target();
+    change.underrun = m_latency.growing();
+    if (!m_output.setBufferTime(change.to)) {
+        return;
+    }
+    /* the ports opened later use the new buffer time */
+    m_bufferTime = change.to;
+    m_currentBufferTime = change.to;
+    m_latency.applied();
+    qWarning() << "Output buffer time:" << change.from << "->" << change.to << "ms"
+               << (change.underrun ? "after an underrun" : "after a healthy period");
+    {
+        QMutexLocker locker(&m_historyMutex);
+        if (m_latencyHistory.count() >= LATENCY_HISTORY_SIZE) {
+            m_latencyHistory.removeFirst();
+        }
+        m_latencyHistory.append(change);
+    }
+    emit bufferTimeChanged(change.to);
+}
+
+int
+SynthRenderer::startPreview(const QString &fileName, double rate)
+{
+    int id = m_previews.start(fileName, rate);
+    QMetaObject::invokeMethod(this, [this] {
+        m_activity = true;
+    }, Qt::QueuedConnection);
+    wake();
+    return id;
+}
+
+void
+SynthRenderer::stopPreview(int id)
+{
+    m_previews.stop(id);
+}
+
+void
+SynthRenderer::renderPreviews(EAS_PCM *buffer, int frames)
+{
+    m_previews.processRequests(m_finishedPreviews);
+    m_previews.render(buffer, frames, m_finishedPreviews);
+    for (int id : m_finishedPreviews) {
+        emit previewStopped(id);
+    }
+    m_finishedPreviews.clear();
+}
+
+void
+SynthRenderer::mixSaturated(EAS_PCM *dest, const EAS_PCM *src, int samples)
+{
+    for (int i = 0; i < samples; ++i) {
+        int sample = dest[i] + src[i];
+        dest[i] = EAS_PCM(qBound(-32768, sample, 32767));
     }
 }
@@ -19,14 +19,35 @@
 #ifndef SYNTHRENDERER_H_
 #define SYNTHRENDERER_H_
 
+#include <QElapsedTimer>
+#include <QMutex>
 #include <QObject>
 #include <QReadWriteLock>
+#include <atomic>
+#include <thread>
 #include <drumstick/alsaclient.h>
 #include <drumstick/alsaport.h>
 #include <drumstick/alsaevent.h>
 #include <pulse/simple.h>
 #include "eas.h"
-#include "filewrapper.h"
+#include "audiotap.h"
+#include "controlqueue.h"
+#include "dspchain.h"
+#include "filestreamer.h"
+#include "gainsmoother.h"
+#include "latencycontroller.h"
+#include "levelmeter.h"
+#include "libraryindex.h"
+#include "loadgovernor.h"
+#include "portworker.h"
+#include "previewmixer.h"
+#include "pulseoutput.h"
+#include "rawmidiinput.h"
+#include "rendercache.h"
+#include "synthengine.h"
+#include "synthstatistics.h"
+#include "threadschedule.h"
+#include "triplebuffer.h"
 
 class SynthRenderer : public QObject
 {
@@ -38,21 +59,54 @@ public:
 
     void subscribe(const QString& portName);
     void unsubscribe(const QString &portName);
+    void setInputPorts(int ports, const QStringList &soundfonts, bool separateOutputs);
+    int inputPorts() const;
+    bool addMidiInput(const QString &source);
+    QStringList midiInputs() const;
 
     void stop();
     bool stopped();
 
     void initReverb(int reverb_type);
     void initChorus(int chorus_type);
-    int reverbWet();
+    int reverbWet() const;
     void setReverbWet(int amount);
-    int chorusLevel();
+    int chorusLevel() const;
     void setChorusLevel(int amount);
     void initSoundfont(const QString& dlsFile);
+    void setRenderCacheEnabled(bool enabled);
+    void setRenderCacheSize(int megabytes);
+    void setLibraryIndex(const LibraryIndex &index);
+    void setRenderAhead(int milliseconds);
+    void setAdaptiveLatency(bool enabled, int floor, int ceiling);
+    void setIdleSuspend(bool enabled);
+    bool suspended() const;
+    int bufferTime() const;
+    int outputLatency() const;
+    QVector<LatencyChange> latencyHistory() const;
+    void setScheduling(const ThreadSchedule &render, const ThreadSchedule &workers);
+    void setDspParameter(DspChain::Parameter parameter, int value);
+    int dspParameter(DspChain::Parameter parameter) const;
+
+    void setGovernorEnabled(bool enabled);
+    bool governorEnabled() const;
+    int governorLevel() const;
+    double renderLoad() const;
+    SynthStatistics statistics();
+    float peakLevel(int channel);
+    float rmsLevel(int channel) const;
+    AudioTap *audioTap();
 
     void playFile(const QString fileName);
-    void startPlayback(const QString fileName);
+    void startPlayback(const QString fileName, int start = 0);
     void stopPlayback();
+    void seekPlayback(int milliseconds);
+    int playbackPosition() const;
+    int startPreview(const QString &fileName, double rate = 1.0);
+    void stopPreview(int id = -1);
+
+    static void mixSaturated(EAS_PCM *dest, const EAS_PCM *src, int samples);
+    static bool silentBlock(const EAS_PCM *buffer, int samples, int threshold);
 
     void uninitALSA();
     void uninitPulse();
@@ -61,15 +115,49 @@ public:
     QStringList alsaConnections() const;
 
 private:
+    /*
+     * A file queued for playback, with the digest of its contents for the
+     * render cache, its compiled song when compact songs are enabled, and
+     * the position to start from in milliseconds.
+     */
+    struct PlaybackRequest
+    {
+        QString fileName;
+        QByteArray digest;
+        CompactSong song;
+        SongSnapshots snapshots;
+        int start;
+    };
+
     void initALSA();
     void initEAS();
     void uninitEAS();
+    void applyControls();
+    void runLoader();
+    void notifyLoader();
+    void loadStandby();
+    void swapEngines();
+    void smoothControls();
     void initPulse();
+    pa_simple *openPulse(const char *streamName, int *err);
     void writeMIDIData(drumstick::ALSA::SequencerEvent *ev);
+    void readMidiInputs();
+    PortWorker *portWorker(int port) const;
+    void mixPorts(EAS_PCM *buffer, int frames, int channels);
+    void updateGovernor(qint64 renderTime);
+    void applyGovernorLevel(int level);
+    void renderPreviews(EAS_PCM *buffer, int frames);
+    void updateLatency(const EAS_PCM *buffer, int samples);
+    void waitForActivity();
+    void wake();
 
+    PlaybackRequest playbackRequest(const QString &fileName, int start = 0) const;
+    bool openCachedFile(const QByteArray &digest);
     void preparePlayback();
     bool playbackCompleted();
     void closePlayback();
+    bool applySeek(int milliseconds);
+    void startAt(int milliseconds);
     int getPlaybackLocation();
 
 public slots:
@@ -81,31 +169,123 @@ signals:
     void finished();
     void playbackStopped();
     void playbackTime(int time);
+    void previewStopped(int id);
+    void governorLevelChanged(int level);
+    void bufferTimeChanged(int bufferTime);
+    void reverbWetChanged(int amount);
+    void chorusLevelChanged(int amount);
 
 private:
     bool m_Stopped;
     bool m_isPlaying;
+    /* a seek waiting for the render thread, or -1, and the last playback location */
+    std::atomic<int> m_pendingSeek;
+    std::atomic<int> m_playbackPosition;
+    QElapsedTimer m_locateTimer;
 
     QReadWriteLock m_mutex;
-    QStringList m_files;
+    QList<PlaybackRequest> m_files;
+    PlaybackRequest m_playback;
 
     /* Drumstick ALSA*/
     drumstick::ALSA::MidiClient* m_Client;
     drumstick::ALSA::MidiPort* m_Port;
     drumstick::ALSA::MidiCodec* m_codec;
 
-    /* SONiVOX EAS */
-    int m_sampleRate, m_bufferSize, m_channels;
-    uint m_libVersion;
-    EAS_DATA_HANDLE m_easData;
-    EAS_HANDLE m_streamHandle;
-    EAS_HANDLE m_midiFileHandle;
-    FileWrapper *m_currentFile;
+    /* additional input ports, one engine each */
+    QList<drumstick::ALSA::MidiPort*> m_ports;
+    QList<PortWorker*> m_workers;
+
+    /* applied by the render thread and the workers when they start */
+    ThreadSchedule m_schedule;
+    ThreadSchedule m_workerSchedule;
+
+    /* raw MIDI sources, read by the render thread */
+    QList<RawMidiInput*> m_midiInputs;
+
+    /* SONiVOX EAS: the live engine, and the previous one or a soundfont being loaded */
+    SynthEngine m_engines[2];
+    SynthEngine *m_engine;
+    SynthEngine *m_standby;
     QString m_soundfont;
+    QString m_standbySoundfont;
+    QByteArray m_soundfontDigest;
+    QByteArray m_standbySoundfontDigest;
+    std::thread m_loader;
+    int m_loaderFd;
+    std::atomic<bool> m_loading;
+    std::atomic<bool> m_standbyReady;
+    std::atomic<bool> m_loaderStopped;
+    uint m_libVersion;
+
+    /* parameter changes, applied by the render thread */
+    enum ControlParameter {
+        ReverbTypeControl = 0,
+        ReverbWetControl,
+        ChorusTypeControl,
+        ChorusLevelControl,
+        ControlCount
+    };
+    ControlQueue m_controls;
+    std::atomic<QString*> m_pendingSoundfont;
+    GainSmoother m_reverbWet;
+    GainSmoother m_chorusLevel;
+
+    /* load governor */
+    LoadGovernor m_governor;
+    std::atomic<bool> m_governorEnabled;
+    std::atomic<int> m_governorLevel;
+    EAS_I32 m_defaultMaxLoad;
+    std::atomic<double> m_renderLoad;
+
+    /* statistics */
+    StatisticsCollector m_collector;
+    TripleBuffer<SynthStatistics> m_statistics;
+
+    /* post processing of the output */
+    DspChain m_dsp;
+
+    /* metering */
+    LevelMeter m_meter;
+    AudioTap m_tap;
+
+    /* previews, mixed over the live output */
+    PreviewMixer m_previews;
+    QVector<int> m_finishedPreviews;
+
+    /* file playback rendered ahead of the live engine */
+    FileStreamer m_streamer;
+
+    /* file metadata, read only while running */
+    LibraryIndex m_library;
+
+    /* render cache */
+    RenderCache m_cache;
+    RenderCache::Reader m_cachedFile;
+    bool m_cacheEnabled;
 
     /* pulseaudio */
     int m_bufferTime;
     pa_simple *m_pulseHandle;
+    PulseOutput m_output;
+    quint32 m_underflows;
+
+    /* suspension while silent */
+    bool m_idleSuspend;
+    int m_idleBlocks;
+    bool m_activity;
+    int m_wakeFd;
+    std::atomic<bool> m_sleeping;
+
+    /* adaptive output latency */
+    LatencyController m_latency;
+    bool m_adaptiveLatency;
+    int m_latencyFloor;
+    int m_latencyCeiling;
+    std::atomic<int> m_currentBufferTime;
+    std::atomic<int> m_outputLatency;
+    mutable QMutex m_historyMutex;
+    QVector<LatencyChange> m_latencyHistory;
 };
 
 #endif /*SYNTHRENDERER_H_*/
@@ -0,0 +1,168 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "synthstatistics.h"
+
+/* statistics are published four times per second of rendered audio */
+static const int PUBLISH_RATE = 4;
+
+SynthStatistics::SynthStatistics()
+    : activeVoices(0)
+    , peakVoices(0)
+    , polyphony(0)
+    , voiceSteals(0)
+{
+    for (int i = 0; i < MIDI_CHANNELS; ++i) {
+        channelVoices[i] = 0;
+        noteRate[i] = 0.0;
+        eventRate[i] = 0.0;
+    }
+}
+
+StatisticsCollector::StatisticsCollector()
+{
+    reset(0, 0);
+}
+
+void StatisticsCollector::reset(int sampleRate, int polyphony)
+{
+    m_sampleRate = sampleRate;
+    m_polyphony = polyphony;
+    m_frames = 0;
+    m_sounding = 0;
+    m_peakVoices = 0;
+    m_voiceSteals = 0;
+    for (int i = 0; i < SynthStatistics::MIDI_CHANNELS; ++i) {
+        m_held[i].reset();
+        m_sustained[i].reset();
+        m_pedal[i] = false;
+        m_channelVoices[i] = 0;
+        m_notes[i] = 0;
+        m_events[i] = 0;
+    }
+}
+
+void StatisticsCollector::setPolyphony(int polyphony)
+{
+    m_polyphony = polyphony;
+}
+
+void StatisticsCollector::midiMessage(const quint8 *msg, int len)
+{
+    if (len < 1 || msg[0] < 0x80 || msg[0] >= 0xf0) {
+        return;
+    }
+    int channel = msg[0] & 0x0f;
+    m_events[channel]++;
+    switch (msg[0] & 0xf0) {
+    case 0x90:
+        if (len > 2 && msg[2] > 0) {
+            m_notes[channel]++;
+            noteOn(channel, msg[1] & 0x7f);
+            break;
+        }
+        /* note on with velocity zero */
+        // fall through
+    case 0x80:
+        if (len > 1) {
+            noteOff(channel, msg[1] & 0x7f);
+        }
+        break;
+    case 0xb0:
+        if (len > 2) {
+            if (msg[1] == 64) {
+                sustain(channel, msg[2] >= 64);
+            } else if (msg[1] == 120 || msg[1] == 123) {
+                allNotesOff(channel);
+            }
+        }
+        break;
+    }
+}
+
+bool StatisticsCollector::renderedFrames(int frames, SynthStatistics &stats)
+{
+    m_frames += frames;
+    if (m_sampleRate <= 0 || m_frames < m_sampleRate / PUBLISH_RATE) {
+        return false;
+    }
+    double seconds = double(m_frames) / m_sampleRate;
+    stats.activeVoices = qMin(m_sounding, m_polyphony);
+    stats.peakVoices = m_peakVoices;
+    stats.polyphony = m_polyphony;
+    stats.voiceSteals = m_voiceSteals;
+    for (int i = 0; i < SynthStatistics::MIDI_CHANNELS; ++i) {
+        stats.channelVoices[i] = m_channelVoices[i];
+        stats.noteRate[i] = m_notes[i] / seconds;
+        stats.eventRate[i] = m_events[i] / seconds;
+        m_notes[i] = 0;
+        m_events[i] = 0;
+    }
+    m_frames = 0;
+    return true;
+}
+
+void StatisticsCollector::noteOn(int channel, int key)
+{
+    if (!m_held[channel].test(key) && !m_sustained[channel].test(key)) {
+        if (m_sounding >= m_polyphony) {
+            m_voiceSteals++;
+        }
+    }
+    m_held[channel].set(key);
+    m_sustained[channel].reset(key);
+    updateVoices();
+}
+
+void StatisticsCollector::noteOff(int channel, int key)
+{
+    if (m_held[channel].test(key)) {
+        m_held[channel].reset(key);
+        if (m_pedal[channel]) {
+            m_sustained[channel].set(key);
+        }
+        updateVoices();
+    }
+}
+
+void StatisticsCollector::sustain(int channel, bool on)
+{
+    m_pedal[channel] = on;
+    if (!on && m_sustained[channel].any()) {
+        m_sustained[channel].reset();
+        updateVoices();
+    }
+}
+
+void StatisticsCollector::allNotesOff(int channel)
+{
+    m_held[channel].reset();
+    m_sustained[channel].reset();
+    updateVoices();
+}
+
+void StatisticsCollector::updateVoices()
+{
+    m_sounding = 0;
+    for (int i = 0; i < SynthStatistics::MIDI_CHANNELS; ++i) {
+        m_channelVoices[i] = int((m_held[i] | m_sustained[i]).count());
+        m_sounding += m_channelVoices[i];
+    }
+    m_peakVoices = qMax(m_peakVoices, qMin(m_sounding, m_polyphony));
+}
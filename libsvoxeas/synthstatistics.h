@@ -0,0 +1,79 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SYNTHSTATISTICS_H
+#define SYNTHSTATISTICS_H
+
+#include <QtGlobal>
+#include <bitset>
+
+struct SynthStatistics
+{
+    static const int MIDI_CHANNELS = 16;
+
+    SynthStatistics();
+
+    int activeVoices;
+    int peakVoices;
+    int polyphony;
+    quint64 voiceSteals;
+    int channelVoices[MIDI_CHANNELS];
+    double noteRate[MIDI_CHANNELS];
+    double eventRate[MIDI_CHANNELS];
+};
+
+/*
+ * Gathers the statistics on the render thread from the MIDI messages sent to
+ * the engine. Sounding notes, including those held by the sustain pedal, are
+ * counted per channel and limited by the polyphony, which makes an estimate
+ * of the voices allocated by EAS; a note started while all the voices are in
+ * use counts as a voice steal.
+ */
+class StatisticsCollector
+{
+public:
+    StatisticsCollector();
+
+    void reset(int sampleRate, int polyphony);
+    void setPolyphony(int polyphony);
+    void midiMessage(const quint8 *msg, int len);
+    bool renderedFrames(int frames, SynthStatistics &stats);
+
+private:
+    void noteOn(int channel, int key);
+    void noteOff(int channel, int key);
+    void sustain(int channel, bool on);
+    void allNotesOff(int channel);
+    void updateVoices();
+
+    int m_sampleRate;
+    int m_polyphony;
+    int m_frames;
+    int m_sounding;
+    int m_peakVoices;
+    quint64 m_voiceSteals;
+    std::bitset<128> m_held[SynthStatistics::MIDI_CHANNELS];
+    std::bitset<128> m_sustained[SynthStatistics::MIDI_CHANNELS];
+    bool m_pedal[SynthStatistics::MIDI_CHANNELS];
+    int m_channelVoices[SynthStatistics::MIDI_CHANNELS];
+    quint32 m_notes[SynthStatistics::MIDI_CHANNELS];
+    quint32 m_events[SynthStatistics::MIDI_CHANNELS];
+};
+
+#endif // SYNTHSTATISTICS_H
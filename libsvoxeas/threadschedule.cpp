@@ -0,0 +1,302 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QStringList>
+#include <QtDebug>
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef SVOXEAS_RTKIT
+#include <QDBusConnection>
+#include <QDBusInterface>
+#include <QDBusReply>
+#endif
+
+#include "threadschedule.h"
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+#ifndef SCHED_RESET_ON_FORK
+#define SCHED_RESET_ON_FORK 0x40000000
+#endif
+/* threads started by a deadline thread would fail without this flag */
+static const quint64 SCHED_FLAG_RESET_ON_FORK = 0x01;
+
+static const int DEFAULT_PRIORITY = 10;
+/* share of the block period reserved for a SCHED_DEADLINE thread */
+static const int DEADLINE_RUNTIME_SHARE = 60;
+/* rtkit only accepts threads with a CPU time limit, in microseconds */
+static const rlim_t RTKIT_RTTIME_LIMIT = 200000;
+
+/* glibc has no wrapper for sched_setattr() before version 2.41 */
+struct DeadlineAttributes {
+    quint32 size;
+    quint32 sched_policy;
+    quint64 sched_flags;
+    qint32 sched_nice;
+    quint32 sched_priority;
+    quint64 sched_runtime;
+    quint64 sched_deadline;
+    quint64 sched_period;
+};
+
+static pid_t
+currentThreadId()
+{
+    return pid_t(syscall(SYS_gettid));
+}
+
+static bool
+setDeadline(qint64 period, QString *error)
+{
+#ifdef SYS_sched_setattr
+    DeadlineAttributes attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.sched_policy = SCHED_DEADLINE;
+    attr.sched_flags = SCHED_FLAG_RESET_ON_FORK;
+    attr.sched_runtime = quint64(period) * DEADLINE_RUNTIME_SHARE / 100;
+    attr.sched_deadline = quint64(period);
+    attr.sched_period = quint64(period);
+    if (syscall(SYS_sched_setattr, 0, &attr, 0) == 0) {
+        return true;
+    }
+    *error = QString::fromLocal8Bit(std::strerror(errno));
+    if (errno == EPERM || errno == EBUSY) {
+        *error += " (needs CAP_SYS_NICE, and an affinity covering its whole root domain)";
+    }
+#else
+    Q_UNUSED(period)
+    *error = "not supported by this system";
+#endif
+    return false;
+}
+
+static bool
+setRealtime(int policy, int priority, QString *error)
+{
+    /* new threads start with the normal policy, and set their own schedule */
+    policy |= SCHED_RESET_ON_FORK;
+    struct sched_param param;
+    std::memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    int result = sched_setscheduler(0, policy, &param) == 0 ? 0 : errno;
+    if (result == EPERM) {
+        /* an unprivileged process may raise its soft limit up to the hard one */
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_RTPRIO, &limit) == 0 && limit.rlim_cur < rlim_t(priority)
+                && limit.rlim_max >= rlim_t(priority)) {
+            limit.rlim_cur = rlim_t(priority);
+            if (setrlimit(RLIMIT_RTPRIO, &limit) == 0) {
+                result = sched_setscheduler(0, policy, &param) == 0 ? 0 : errno;
+            }
+        }
+    }
+    if (result == 0) {
+        return true;
+    }
+    *error = QString::fromLocal8Bit(std::strerror(result));
+    if (result == EPERM) {
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_RTPRIO, &limit) == 0) {
+            *error += QString(" (RLIMIT_RTPRIO is %1, see limits.conf)").arg(QString::number(quint64(limit.rlim_max)));
+        }
+    }
+    return false;
+}
+
+#ifdef SVOXEAS_RTKIT
+static bool
+setRealtimeWithRtkit(int priority, QString *error)
+{
+    struct rlimit limit;
+    limit.rlim_cur = limit.rlim_max = RTKIT_RTTIME_LIMIT;
+    if (setrlimit(RLIMIT_RTTIME, &limit) < 0) {
+        *error = QString("RLIMIT_RTTIME: %1").arg(QString::fromLocal8Bit(std::strerror(errno)));
+        return false;
+    }
+    QDBusInterface rtkit("org.freedesktop.RealtimeKit1", "/org/freedesktop/RealtimeKit1",
+                         "org.freedesktop.RealtimeKit1", QDBusConnection::systemBus());
+    if (!rtkit.isValid()) {
+        *error = "rtkit is not available";
+        return false;
+    }
+    int maxPriority = rtkit.property("MaxRealtimePriority").toInt();
+    if (maxPriority > 0) {
+        priority = qMin(priority, maxPriority);
+    }
+    QDBusReply<void> reply = rtkit.call("MakeThreadRealtime", quint64(currentThreadId()), quint32(priority));
+    if (!reply.isValid()) {
+        *error = reply.error().message();
+        return false;
+    }
+    return true;
+}
+#endif
+
+ThreadSchedule::ThreadSchedule()
+    : m_policy(Normal)
+    , m_priority(DEFAULT_PRIORITY)
+{
+}
+
+ThreadSchedule::Policy
+ThreadSchedule::policy() const
+{
+    return m_policy;
+}
+
+void
+ThreadSchedule::setPolicy(Policy policy)
+{
+    m_policy = policy;
+}
+
+int
+ThreadSchedule::priority() const
+{
+    return m_priority;
+}
+
+void
+ThreadSchedule::setPriority(int priority)
+{
+    m_priority = priority;
+}
+
+QList<int>
+ThreadSchedule::cpus() const
+{
+    return m_cpus;
+}
+
+void
+ThreadSchedule::setCpus(const QList<int> &cpus)
+{
+    m_cpus = cpus;
+}
+
+/* the period, in nanoseconds, is only used by the deadline policy */
+bool
+ThreadSchedule::apply(const QString &threadName, qint64 period) const
+{
+    bool ok = true;
+    if (!m_cpus.isEmpty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : m_cpus) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (result != 0) {
+            qWarning() << threadName << "thread: CPU affinity refused:" << std::strerror(result);
+            ok = false;
+        }
+    }
+
+    QString error;
+    Policy policy = m_policy;
+    if (policy == Deadline) {
+        if (setDeadline(period, &error)) {
+            qDebug() << threadName << "thread: SCHED_DEADLINE runtime"
+                     << period * DEADLINE_RUNTIME_SHARE / 100 << "ns every" << period << "ns";
+            return ok;
+        }
+        qWarning() << threadName << "thread: SCHED_DEADLINE refused:" << error << "- trying SCHED_FIFO";
+        policy = Fifo;
+    }
+    if (policy == Fifo || policy == RoundRobin) {
+        const char *name = policy == Fifo ? "SCHED_FIFO" : "SCHED_RR";
+        if (setRealtime(policy == Fifo ? SCHED_FIFO : SCHED_RR, m_priority, &error)) {
+            qDebug() << threadName << "thread:" << name << "priority" << m_priority;
+            return ok;
+        }
+        qWarning() << threadName << "thread:" << name << "refused:" << error;
+#ifdef SVOXEAS_RTKIT
+        if (setRealtimeWithRtkit(m_priority, &error)) {
+            qWarning() << threadName << "thread: SCHED_RR granted by rtkit";
+            return ok;
+        }
+        qWarning() << threadName << "thread: rtkit refused:" << error;
+#endif
+        qWarning() << threadName << "thread: running with the normal scheduler";
+        ok = false;
+    }
+    return ok;
+}
+
+bool
+ThreadSchedule::parsePolicy(const QString &name, Policy *policy)
+{
+    const QString lower = name.trimmed().toLower();
+    for (Policy p : { Normal, Fifo, RoundRobin, Deadline }) {
+        if (lower == policyName(p)) {
+            *policy = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+QString
+ThreadSchedule::policyName(Policy policy)
+{
+    switch (policy) {
+    case Fifo:
+        return "fifo";
+    case RoundRobin:
+        return "rr";
+    case Deadline:
+        return "deadline";
+    default:
+        return "normal";
+    }
+}
+
+/* a list like "2,3,6-7", empty for no affinity */
+bool
+ThreadSchedule::parseCpus(const QString &list, QList<int> *cpus)
+{
+    QList<int> result;
+    for (const QString &item : list.split(',')) {
+        if (item.trimmed().isEmpty()) {
+            continue;
+        }
+        QStringList range = item.split('-');
+        bool ok1, ok2 = true;
+        int first = range.value(0).trimmed().toInt(&ok1);
+        int last = range.count() > 1 ? range.value(1).trimmed().toInt(&ok2) : first;
+        if (!ok1 || !ok2 || range.count() > 2 || first < 0 || last < first || last >= CPU_SETSIZE) {
+            return false;
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            result << cpu;
+        }
+    }
+    *cpus = result;
+    return true;
+}
@@ -0,0 +1,64 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef THREADSCHEDULE_H
+#define THREADSCHEDULE_H
+
+#include <QList>
+#include <QString>
+#include <QtGlobal>
+
+/*
+ * Scheduling class and CPU affinity requested for a rendering thread.
+ * apply() is called by the thread itself when it starts. A policy that the
+ * system refuses is downgraded step by step (deadline, FIFO, round robin
+ * through rtkit, normal), and every refusal is reported with its reason.
+ */
+class ThreadSchedule
+{
+public:
+    enum Policy {
+        Normal = 0,
+        Fifo,
+        RoundRobin,
+        Deadline
+    };
+
+    ThreadSchedule();
+
+    Policy policy() const;
+    void setPolicy(Policy policy);
+    int priority() const;
+    void setPriority(int priority);
+    QList<int> cpus() const;
+    void setCpus(const QList<int> &cpus);
+
+    bool apply(const QString &threadName, qint64 period) const;
+
+    static bool parsePolicy(const QString &name, Policy *policy);
+    static QString policyName(Policy policy);
+    static bool parseCpus(const QString &list, QList<int> *cpus);
+
+private:
+    Policy m_policy;
+    int m_priority;
+    QList<int> m_cpus;
+};
+
+#endif // THREADSCHEDULE_H
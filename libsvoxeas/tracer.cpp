@@ -0,0 +1,179 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifdef SVOXEAS_TRACING
+
+#include <QFile>
+#include <QtDebug>
+
+#include <chrono>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "tracer.h"
+
+/* events per thread between two flushes */
+static const size_t TRACE_BUFFER_EVENTS = 16384;
+static const int TRACE_FLUSH_INTERVAL_MS = 100;
+
+Tracer *
+Tracer::instance()
+{
+    static Tracer tracer;
+    return &tracer;
+}
+
+Tracer::Tracer()
+    : m_enabled(false)
+    , m_stopping(false)
+    , m_file(nullptr)
+    , m_firstEvent(true)
+    , m_origin(0)
+{
+}
+
+Tracer::~Tracer()
+{
+    stop();
+    for (ThreadBuffer *buffer : m_buffers) {
+        delete buffer;
+    }
+}
+
+qint64
+Tracer::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+bool
+Tracer::start(const QString &fileName)
+{
+    if (m_file != nullptr) {
+        return false;
+    }
+    m_file = fopen(QFile::encodeName(fileName).constData(), "w");
+    if (m_file == nullptr) {
+        qWarning() << "Can't write the trace file" << fileName;
+        return false;
+    }
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", m_file);
+    m_firstEvent = true;
+    m_origin = now();
+    m_stopping = false;
+    m_thread = std::thread(&Tracer::flushLoop, this);
+    m_enabled.store(true, std::memory_order_release);
+    qDebug() << Q_FUNC_INFO << fileName;
+    return true;
+}
+
+void
+Tracer::stop()
+{
+    if (m_file == nullptr) {
+        return;
+    }
+    m_enabled.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeup.notify_one();
+    m_thread.join();
+    flush();
+    fputs("\n]}\n", m_file);
+    fclose(m_file);
+    m_file = nullptr;
+    quint64 dropped = 0;
+    for (ThreadBuffer *buffer : m_buffers) {
+        dropped += buffer->dropped.exchange(0);
+    }
+    if (dropped > 0) {
+        qWarning() << "Trace buffers overflowed," << dropped << "events were dropped";
+    }
+}
+
+void
+Tracer::record(const char *name, qint64 start, qint64 duration)
+{
+    ThreadBuffer *buffer = threadBuffer();
+    TraceEvent event = { name, start, duration };
+    if (!buffer->ring.push(event)) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+Tracer::ThreadBuffer *
+Tracer::threadBuffer()
+{
+    /* the lock is taken once per thread, the first time it records an event */
+    static thread_local ThreadBuffer *buffer = nullptr;
+    if (buffer == nullptr) {
+        ThreadBuffer *newBuffer = new ThreadBuffer;
+        newBuffer->ring.resize(TRACE_BUFFER_EVENTS);
+        newBuffer->tid = syscall(SYS_gettid);
+        newBuffer->dropped.store(0);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_buffers.push_back(newBuffer);
+        buffer = newBuffer;
+    }
+    return buffer;
+}
+
+void
+Tracer::flushLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stopping) {
+        m_wakeup.wait_for(lock, std::chrono::milliseconds(TRACE_FLUSH_INTERVAL_MS));
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
+
+void
+Tracer::flush()
+{
+    std::vector<ThreadBuffer *> buffers;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        buffers = m_buffers;
+    }
+    const int pid = getpid();
+    TraceEvent events[256];
+    for (ThreadBuffer *buffer : buffers) {
+        size_t count;
+        while ((count = buffer->ring.read(events, 256)) > 0) {
+            for (size_t i = 0; i < count; ++i) {
+                fprintf(m_file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%lld,"
+                        "\"ts\":%.3f,\"dur\":%.3f}",
+                        m_firstEvent ? "" : ",\n", events[i].name, pid,
+                        (long long) buffer->tid, (events[i].start - m_origin) / 1000.0,
+                        events[i].duration / 1000.0);
+                m_firstEvent = false;
+            }
+        }
+    }
+    fflush(m_file);
+}
+
+#endif // SVOXEAS_TRACING
@@ -0,0 +1,122 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef TRACER_H
+#define TRACER_H
+
+/*
+ * Trace event instrumentation, built only when SVOXEAS_TRACING is defined
+ * (cmake -DUSE_TRACING=ON, or qmake CONFIG+=tracing). Otherwise TRACE_SCOPE
+ * expands to nothing.
+ *
+ * Each thread records complete events into its own lock-free ring buffer;
+ * a background thread drains the rings and writes them as Chrome trace
+ * event JSON, which can be opened in Perfetto or chrome://tracing.
+ */
+
+#ifdef SVOXEAS_TRACING
+
+#include <QString>
+#include <QtGlobal>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "spscring.h"
+
+struct TraceEvent
+{
+    const char *name;
+    qint64 start;
+    qint64 duration;
+};
+
+class Tracer
+{
+public:
+    static Tracer *instance();
+
+    bool start(const QString &fileName);
+    void stop();
+
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    void record(const char *name, qint64 start, qint64 duration);
+
+    static qint64 now();
+
+private:
+    struct ThreadBuffer
+    {
+        SpscRing<TraceEvent> ring;
+        qint64 tid;
+        std::atomic<quint64> dropped;
+    };
+
+    Tracer();
+    ~Tracer();
+    Q_DISABLE_COPY(Tracer)
+
+    ThreadBuffer *threadBuffer();
+    void flushLoop();
+    void flush();
+
+    std::atomic<bool> m_enabled;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    bool m_stopping;
+    std::vector<ThreadBuffer *> m_buffers;
+    std::thread m_thread;
+    FILE *m_file;
+    bool m_firstEvent;
+    qint64 m_origin;
+};
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name)
+        : m_name(name)
+        , m_start(Tracer::instance()->isEnabled() ? Tracer::now() : -1)
+    {}
+
+    ~TraceScope()
+    {
+        if (m_start >= 0) {
+            Tracer::instance()->record(m_name, m_start, Tracer::now() - m_start);
+        }
+    }
+
+private:
+    const char *m_name;
+    qint64 m_start;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+#else
+
+#define TRACE_SCOPE(name) do {} while (0)
+
+#endif // SVOXEAS_TRACING
+
+#endif // TRACER_H
@@ -0,0 +1,71 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+/*
+ * Lock-free single writer, single reader snapshot exchange. The writer fills
+ * writeBuffer() and calls publish(); the reader calls update() and then reads
+ * readBuffer(). Neither side ever waits for the other, the reader simply sees
+ * the most recently published value.
+ */
+template<typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer()
+        : m_back(0)
+        , m_middle(1)
+        , m_front(2)
+    {}
+
+    T &writeBuffer() { return m_buffers[m_back]; }
+
+    void publish()
+    {
+        int previous = m_middle.exchange(m_back | DIRTY, std::memory_order_acq_rel);
+        m_back = previous & INDEX;
+    }
+
+    bool update()
+    {
+        if ((m_middle.load(std::memory_order_relaxed) & DIRTY) == 0) {
+            return false;
+        }
+        int previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+        m_front = previous & INDEX;
+        return true;
+    }
+
+    const T &readBuffer() const { return m_buffers[m_front]; }
+
+private:
+    static const int INDEX = 0x3;
+    static const int DIRTY = 0x4;
+
+    T m_buffers[3];
+    int m_back;
+    std::atomic<int> m_middle;
+    int m_front;
+};
+
+#endif // TRIPLEBUFFER_H
@@ -0,0 +1,125 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <QByteArray>
+#include <QtDebug>
+#include <QtEndian>
+
+#include "wavewriter.h"
+
+static const int WAVE_HEADER_SIZE = 44;
+
+static void appendU32(QByteArray &data, quint32 value)
+{
+    uchar buf[4];
+    qToLittleEndian(value, buf);
+    data.append(reinterpret_cast<const char *>(buf), 4);
+}
+
+static void appendU16(QByteArray &data, quint16 value)
+{
+    uchar buf[2];
+    qToLittleEndian(value, buf);
+    data.append(reinterpret_cast<const char *>(buf), 2);
+}
+
+WaveWriter::WaveWriter()
+    : m_sampleRate(0)
+    , m_channels(0)
+    , m_frames(0)
+{}
+
+WaveWriter::~WaveWriter()
+{
+    close();
+}
+
+bool WaveWriter::open(const QString &fileName, int sampleRate, int channels)
+{
+    close();
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Failed to create" << fileName << m_file.errorString();
+        return false;
+    }
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+    m_frames = 0;
+    return writeHeader();
+}
+
+bool WaveWriter::write(const EAS_PCM *buffer, int frames)
+{
+    if (!m_file.isOpen() || frames <= 0) {
+        return false;
+    }
+    qint64 bytes = qint64(frames) * m_channels * sizeof(EAS_PCM);
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    QByteArray swapped(int(bytes), Qt::Uninitialized);
+    qToLittleEndian<qint16>(buffer, frames * m_channels, swapped.data());
+    bool ok = m_file.write(swapped) == bytes;
+#else
+    bool ok = m_file.write(reinterpret_cast<const char *>(buffer), bytes) == bytes;
+#endif
+    if (ok) {
+        m_frames += frames;
+    } else {
+        qWarning() << "Error writing" << m_file.fileName() << m_file.errorString();
+    }
+    return ok;
+}
+
+bool WaveWriter::close()
+{
+    if (!m_file.isOpen()) {
+        return false;
+    }
+    bool ok = m_file.seek(0) && writeHeader();
+    m_file.close();
+    return ok;
+}
+
+qint64 WaveWriter::frames() const
+{
+    return m_frames;
+}
+
+bool WaveWriter::writeHeader()
+{
+    quint32 dataSize = quint32(m_frames * m_channels * sizeof(EAS_PCM));
+    QByteArray header;
+    header.reserve(WAVE_HEADER_SIZE);
+    header.append("RIFF", 4);
+    appendU32(header, WAVE_HEADER_SIZE - 8 + dataSize);
+    header.append("WAVEfmt ", 8);
+    appendU32(header, 16);
+    appendU16(header, 1); /* PCM */
+    appendU16(header, quint16(m_channels));
+    appendU32(header, quint32(m_sampleRate));
+    appendU32(header, quint32(m_sampleRate * m_channels * sizeof(EAS_PCM)));
+    appendU16(header, quint16(m_channels * sizeof(EAS_PCM)));
+    appendU16(header, 16);
+    header.append("data", 4);
+    appendU32(header, dataSize);
+    if (m_file.write(header) != header.size()) {
+        qWarning() << "Error writing" << m_file.fileName() << m_file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,48 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef WAVEWRITER_H
+#define WAVEWRITER_H
+
+#include <QFile>
+#include <QString>
+#include <eas_types.h>
+
+/* 16 bit PCM RIFF/WAVE file writer */
+class WaveWriter
+{
+public:
+    WaveWriter();
+    ~WaveWriter();
+
+    bool open(const QString &fileName, int sampleRate, int channels);
+    bool write(const EAS_PCM *buffer, int frames);
+    bool close();
+    qint64 frames() const;
+
+private:
+    bool writeHeader();
+
+    QFile m_file;
+    int m_sampleRate;
+    int m_channels;
+    qint64 m_frames;
+};
+
+#endif // WAVEWRITER_H
@@ -0,0 +1,14 @@
+include(../global.pri)
+
+QT       += core testlib
+QT       -= gui
+CONFIG   += console testcase
+CONFIG   -= app_bundle
+TEMPLATE = app
+
+DEPENDPATH += ../libsvoxeas
+INCLUDEPATH += ../libsvoxeas \
+               ../sonivox/host_src
+QMAKE_LFLAGS += -L../libsvoxeas
+LIBS += -lsvoxeas
+QMAKE_RPATHDIR = $$OUT_PWD/../libsvoxeas
@@ -0,0 +1,11 @@
+#------------------------
+#
+# Sonivox EAS unit tests
+#
+#------------------------
+
+TEMPLATE = subdirs
+SUBDIRS += tst_queues.pro \
+           tst_midiparser.pro \
+           tst_smfreader.pro \
+           tst_rendercache.pro
@@ -0,0 +1,165 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QByteArray>
+#include <QList>
+#include <QtTest>
+
+#include "midiparser.h"
+
+class TestMidiParser : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void channelMessages();
+    void runningStatus();
+    void splitMessages();
+    void realTimeInterleaved();
+    void systemCommon();
+    void strayDataBytes();
+    void sysex();
+    void sysexOverflow();
+    void sysexInterrupted();
+
+private:
+    QList<QByteArray> parse(MidiParser &parser, const QByteArray &bytes);
+    QList<QByteArray> parse(const QByteArray &bytes);
+};
+
+QList<QByteArray> TestMidiParser::parse(MidiParser &parser, const QByteArray &bytes)
+{
+    QList<QByteArray> messages;
+    parser.parse(reinterpret_cast<const quint8 *>(bytes.constData()), bytes.size(),
+                 [&messages](const quint8 *data, int length) {
+        messages << QByteArray(reinterpret_cast<const char *>(data), length);
+    });
+    return messages;
+}
+
+QList<QByteArray> TestMidiParser::parse(const QByteArray &bytes)
+{
+    MidiParser parser;
+    return parse(parser, bytes);
+}
+
+void TestMidiParser::channelMessages()
+{
+    QList<QByteArray> messages = parse(QByteArray::fromHex("903c64c005e0007f"));
+    QCOMPARE(messages.count(), 3);
+    QCOMPARE(messages.at(0), QByteArray::fromHex("903c64"));
+    QCOMPARE(messages.at(1), QByteArray::fromHex("c005"));
+    QCOMPARE(messages.at(2), QByteArray::fromHex("e0007f"));
+}
+
+void TestMidiParser::runningStatus()
+{
+    QList<QByteArray> messages = parse(QByteArray::fromHex("903c644030c10203"));
+    QCOMPARE(messages.count(), 4);
+    /* every message gets its status byte back */
+    QCOMPARE(messages.at(0), QByteArray::fromHex("903c64"));
+    QCOMPARE(messages.at(1), QByteArray::fromHex("904030"));
+    QCOMPARE(messages.at(2), QByteArray::fromHex("c102"));
+    QCOMPARE(messages.at(3), QByteArray::fromHex("c103"));
+}
+
+void TestMidiParser::splitMessages()
+{
+    const QByteArray stream = QByteArray::fromHex("903c644030b0077ff0417e01f7");
+    /* any split between reads gives the same messages */
+    const QList<QByteArray> expected = parse(stream);
+    QCOMPARE(expected.count(), 4);
+    QCOMPARE(expected.at(1), QByteArray::fromHex("904030"));
+    QCOMPARE(expected.at(3), QByteArray::fromHex("f0417e01f7"));
+    for (int split = 1; split < stream.size(); ++split) {
+        MidiParser parser;
+        QList<QByteArray> messages = parse(parser, stream.left(split));
+        messages += parse(parser, stream.mid(split));
+        QCOMPARE(messages, expected);
+    }
+    MidiParser parser;
+    QList<QByteArray> messages;
+    for (int i = 0; i < stream.size(); ++i) {
+        messages += parse(parser, stream.mid(i, 1));
+    }
+    QCOMPARE(messages, expected);
+}
+
+void TestMidiParser::realTimeInterleaved()
+{
+    /* clock, start and active sensing in the middle of messages are dropped */
+    QList<QByteArray> messages = parse(QByteArray::fromHex("90f83cfa64fe4030f0f841f7"));
+    QCOMPARE(messages.count(), 3);
+    QCOMPARE(messages.at(0), QByteArray::fromHex("903c64"));
+    QCOMPARE(messages.at(1), QByteArray::fromHex("904030"));
+    QCOMPARE(messages.at(2), QByteArray::fromHex("f041f7"));
+}
+
+void TestMidiParser::systemCommon()
+{
+    /* system common messages cancel the running status */
+    QList<QByteArray> messages = parse(QByteArray::fromHex("903c64f20102f6403090"));
+    QCOMPARE(messages.count(), 3);
+    QCOMPARE(messages.at(0), QByteArray::fromHex("903c64"));
+    QCOMPARE(messages.at(1), QByteArray::fromHex("f20102"));
+    QCOMPARE(messages.at(2), QByteArray::fromHex("f6"));
+}
+
+void TestMidiParser::strayDataBytes()
+{
+    QList<QByteArray> messages = parse(QByteArray::fromHex("0102903c64"));
+    QCOMPARE(messages.count(), 1);
+    QCOMPARE(messages.at(0), QByteArray::fromHex("903c64"));
+}
+
+void TestMidiParser::sysex()
+{
+    QByteArray sysex = QByteArray::fromHex("f0");
+    sysex += QByteArray(MidiParser::MAX_SYSEX - 2, 0x11);
+    sysex += QByteArray::fromHex("f7");
+    QList<QByteArray> messages = parse(sysex);
+    QCOMPARE(messages.count(), 1);
+    QCOMPARE(messages.at(0), sysex);
+}
+
+void TestMidiParser::sysexOverflow()
+{
+    QByteArray sysex = QByteArray::fromHex("f0");
+    sysex += QByteArray(MidiParser::MAX_SYSEX, 0x11);
+    sysex += QByteArray::fromHex("f7");
+    MidiParser parser;
+    QList<QByteArray> messages = parse(parser, sysex + QByteArray::fromHex("903c64"));
+    /* the long message is discarded, the next one is not affected */
+    QCOMPARE(messages.count(), 1);
+    QCOMPARE(messages.at(0), QByteArray::fromHex("903c64"));
+    messages = parse(parser, QByteArray::fromHex("f07e7ff7"));
+    QCOMPARE(messages.count(), 1);
+    QCOMPARE(messages.at(0), QByteArray::fromHex("f07e7ff7"));
+}
+
+void TestMidiParser::sysexInterrupted()
+{
+    /* a status byte ends an unterminated system exclusive message without sending it */
+    QList<QByteArray> messages = parse(QByteArray::fromHex("f0417e903c64"));
+    QCOMPARE(messages.count(), 1);
+    QCOMPARE(messages.at(0), QByteArray::fromHex("903c64"));
+}
+
+QTEST_APPLESS_MAIN(TestMidiParser)
+
+#include "tst_midiparser.moc"
@@ -0,0 +1,4 @@
+include(tests.pri)
+
+TARGET = tst_midiparser
+SOURCES += tst_midiparser.cpp
@@ -0,0 +1,324 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest>
+#include <thread>
+#include <vector>
+
+#include "controlqueue.h"
+#include "spscring.h"
+#include "triplebuffer.h"
+
+class TestQueues : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void mpscEmpty();
+    void mpscFull();
+    void mpscWraparound();
+    void mpscProducers();
+    void controlCollapsing();
+    void controlOrder();
+    void controlSetWhileApplying();
+    void ringEmpty();
+    void ringFull();
+    void ringWraparound();
+    void ringTake();
+    void ringSkipTo();
+    void tripleBufferEmpty();
+    void tripleBufferLatest();
+};
+
+void TestQueues::mpscEmpty()
+{
+    MpscQueue<int> queue(4);
+    int value = -1;
+    QVERIFY(!queue.pop(value));
+    QCOMPARE(value, -1);
+}
+
+void TestQueues::mpscFull()
+{
+    /* the capacity is rounded up to a power of two */
+    MpscQueue<int> queue(3);
+    for (int i = 0; i < 4; ++i) {
+        QVERIFY(queue.push(i));
+    }
+    QVERIFY(!queue.push(4));
+    int value;
+    QVERIFY(queue.pop(value));
+    QCOMPARE(value, 0);
+    QVERIFY(queue.push(4));
+    QVERIFY(!queue.push(5));
+}
+
+void TestQueues::mpscWraparound()
+{
+    MpscQueue<int> queue(4);
+    int next = 0;
+    int expected = 0;
+    for (int lap = 0; lap < 10; ++lap) {
+        while (queue.push(next)) {
+            ++next;
+        }
+        int value;
+        for (int i = 0; i < 3; ++i) {
+            QVERIFY(queue.pop(value));
+            QCOMPARE(value, expected++);
+        }
+    }
+    int value;
+    while (queue.pop(value)) {
+        QCOMPARE(value, expected++);
+    }
+    QCOMPARE(expected, next);
+}
+
+void TestQueues::mpscProducers()
+{
+    static const int PRODUCERS = 4;
+    static const int ITEMS = 20000;
+    MpscQueue<int> queue(64);
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; ++p) {
+        producers.emplace_back([&queue, p] {
+            for (int i = 0; i < ITEMS; ++i) {
+                while (!queue.push(p * ITEMS + i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    /* the items of each producer arrive in the order they were pushed */
+    std::vector<int> last(PRODUCERS, -1);
+    int received = 0;
+    while (received < PRODUCERS * ITEMS) {
+        int value;
+        if (!queue.pop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        const int producer = value / ITEMS;
+        QVERIFY(value % ITEMS > last[producer]);
+        last[producer] = value % ITEMS;
+        ++received;
+    }
+    for (std::thread &producer : producers) {
+        producer.join();
+    }
+    int value;
+    QVERIFY(!queue.pop(value));
+}
+
+void TestQueues::controlCollapsing()
+{
+    ControlQueue controls(4);
+    for (int i = 0; i < 100; ++i) {
+        controls.set(2, i);
+    }
+    int parameter, value;
+    QVERIFY(controls.next(parameter, value));
+    QCOMPARE(parameter, 2);
+    QCOMPARE(value, 99);
+    QVERIFY(!controls.next(parameter, value));
+}
+
+void TestQueues::controlOrder()
+{
+    ControlQueue controls(4);
+    controls.init(0, 5);
+    QCOMPARE(controls.value(0), 5);
+    int parameter, value;
+    QVERIFY(!controls.next(parameter, value));
+    controls.set(3, 1);
+    controls.set(1, 2);
+    controls.set(3, 3);
+    controls.set(0, 4);
+    QVERIFY(controls.next(parameter, value));
+    QCOMPARE(parameter, 3);
+    QCOMPARE(value, 3);
+    QVERIFY(controls.next(parameter, value));
+    QCOMPARE(parameter, 1);
+    QCOMPARE(value, 2);
+    QVERIFY(controls.next(parameter, value));
+    QCOMPARE(parameter, 0);
+    QCOMPARE(value, 4);
+    QVERIFY(!controls.next(parameter, value));
+}
+
+void TestQueues::controlSetWhileApplying()
+{
+    ControlQueue controls(2);
+    int parameter, value;
+    /* every parameter changed after it was taken is queued again */
+    for (int i = 0; i < 10; ++i) {
+        controls.set(0, i);
+        controls.set(1, -i);
+        QVERIFY(controls.next(parameter, value));
+        QCOMPARE(parameter, 0);
+        QCOMPARE(value, i);
+        controls.set(0, i + 100);
+        QVERIFY(controls.next(parameter, value));
+        QCOMPARE(parameter, 1);
+        QCOMPARE(value, -i);
+        QVERIFY(controls.next(parameter, value));
+        QCOMPARE(parameter, 0);
+        QCOMPARE(value, i + 100);
+        QVERIFY(!controls.next(parameter, value));
+    }
+}
+
+void TestQueues::ringEmpty()
+{
+    SpscRing<int> ring(8);
+    QCOMPARE(ring.capacity(), size_t(8));
+    QCOMPARE(ring.readAvailable(), size_t(0));
+    QCOMPARE(ring.writeAvailable(), size_t(8));
+    int data[4];
+    QCOMPARE(ring.read(data, 4), size_t(0));
+    int value;
+    QVERIFY(!ring.pop(value));
+    QVERIFY(!ring.take(value));
+
+    SpscRing<int> none;
+    QCOMPARE(none.capacity(), size_t(0));
+    QVERIFY(!none.push(1));
+}
+
+void TestQueues::ringFull()
+{
+    /* the capacity is rounded up to a power of two */
+    SpscRing<int> ring(5);
+    QCOMPARE(ring.capacity(), size_t(8));
+    int data[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    /* a write that does not fit is truncated */
+    QCOMPARE(ring.write(data, 10), size_t(8));
+    QCOMPARE(ring.writeAvailable(), size_t(0));
+    QVERIFY(!ring.push(10));
+    int moved = 10;
+    QVERIFY(!ring.push(std::move(moved)));
+    int out[10];
+    QCOMPARE(ring.read(out, 10), size_t(8));
+    for (int i = 0; i < 8; ++i) {
+        QCOMPARE(out[i], i);
+    }
+}
+
+void TestQueues::ringWraparound()
+{
+    SpscRing<int> ring(8);
+    int next = 0;
+    int expected = 0;
+    for (int lap = 0; lap < 20; ++lap) {
+        int data[5];
+        for (int i = 0; i < 5; ++i) {
+            data[i] = next + i;
+        }
+        next += int(ring.write(data, 5));
+        int out[3];
+        const size_t count = ring.read(out, 3);
+        QCOMPARE(count, size_t(3));
+        for (size_t i = 0; i < count; ++i) {
+            QCOMPARE(out[i], expected++);
+        }
+    }
+    int value;
+    while (ring.pop(value)) {
+        QCOMPARE(value, expected++);
+    }
+    QCOMPARE(expected, next);
+    QCOMPARE(ring.written(), size_t(next));
+}
+
+void TestQueues::ringTake()
+{
+    SpscRing<QByteArray> ring(2);
+    QVERIFY(ring.push(QByteArray("one")));
+    QVERIFY(ring.push(QByteArray("two")));
+    QByteArray item;
+    QVERIFY(ring.take(item));
+    QCOMPARE(item, QByteArray("one"));
+    /* the slot was left empty, the next lap writes over a default item */
+    QVERIFY(ring.push(QByteArray("three")));
+    QVERIFY(ring.take(item));
+    QCOMPARE(item, QByteArray("two"));
+    QVERIFY(ring.take(item));
+    QCOMPARE(item, QByteArray("three"));
+    QVERIFY(!ring.take(item));
+}
+
+void TestQueues::ringSkipTo()
+{
+    SpscRing<int> ring(8);
+    for (int i = 0; i < 6; ++i) {
+        QVERIFY(ring.push(i));
+    }
+    const size_t mark = ring.written() - 2;
+    ring.skipTo(mark);
+    int value;
+    QVERIFY(ring.pop(value));
+    QCOMPARE(value, 4);
+    /* a position already read is ignored */
+    ring.skipTo(mark);
+    QVERIFY(ring.pop(value));
+    QCOMPARE(value, 5);
+    QVERIFY(!ring.pop(value));
+    QVERIFY(ring.push(6));
+    ring.clear();
+    QCOMPARE(ring.readAvailable(), size_t(0));
+    QCOMPARE(ring.writeAvailable(), size_t(8));
+}
+
+void TestQueues::tripleBufferEmpty()
+{
+    TripleBuffer<int> buffer;
+    QVERIFY(!buffer.update());
+    buffer.writeBuffer() = 1;
+    buffer.publish();
+    QVERIFY(buffer.update());
+    QCOMPARE(buffer.readBuffer(), 1);
+    /* nothing new was published */
+    QVERIFY(!buffer.update());
+    QCOMPARE(buffer.readBuffer(), 1);
+}
+
+void TestQueues::tripleBufferLatest()
+{
+    TripleBuffer<int> buffer;
+    for (int i = 1; i <= 5; ++i) {
+        buffer.writeBuffer() = i;
+        buffer.publish();
+    }
+    QVERIFY(buffer.update());
+    QCOMPARE(buffer.readBuffer(), 5);
+    for (int i = 6; i <= 20; ++i) {
+        buffer.writeBuffer() = i;
+        buffer.publish();
+        if (i % 3 == 0) {
+            QVERIFY(buffer.update());
+            QCOMPARE(buffer.readBuffer(), i);
+        }
+    }
+    QVERIFY(buffer.update());
+    QCOMPARE(buffer.readBuffer(), 20);
+}
+
+QTEST_APPLESS_MAIN(TestQueues)
+
+#include "tst_queues.moc"
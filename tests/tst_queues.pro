@@ -0,0 +1,4 @@
+include(tests.pri)
+
+TARGET = tst_queues
+SOURCES += tst_queues.cpp
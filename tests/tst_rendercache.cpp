@@ -0,0 +1,181 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QTemporaryDir>
+#include <QVector>
+#include <QtTest>
+
+#include "rendercache.h"
+
+/* frames written per call: the writer stores a chunk every 8192 frames */
+static const int BLOCK_FRAMES = 1024;
+static const int CHUNK_FRAMES = 8192;
+static const int TOTAL_FRAMES = 3 * CHUNK_FRAMES + 1000;
+static const int CHANNELS = 2;
+
+/* each frame holds its own number, so a read tells where it came from */
+static EAS_PCM sample(qint64 frame, int channel)
+{
+    return EAS_PCM((frame * CHANNELS + channel) % 32000);
+}
+
+class TestRenderCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void readAll();
+    void seek_data();
+    void seek();
+    void seekSequence();
+    void truncated();
+
+private:
+    bool verify(RenderCache::Reader &reader, qint64 frame, int frames);
+
+    QTemporaryDir m_dir;
+    QString m_fileName;
+};
+
+void TestRenderCache::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+    m_fileName = m_dir.filePath(QStringLiteral("entry.svc"));
+    RenderCache::Writer writer;
+    QVERIFY(writer.open(m_fileName, 22050, CHANNELS));
+    QVector<EAS_PCM> block(BLOCK_FRAMES * CHANNELS);
+    for (qint64 frame = 0; frame < TOTAL_FRAMES; frame += BLOCK_FRAMES) {
+        const int frames = int(qMin<qint64>(BLOCK_FRAMES, TOTAL_FRAMES - frame));
+        for (int i = 0; i < frames; ++i) {
+            for (int channel = 0; channel < CHANNELS; ++channel) {
+                block[i * CHANNELS + channel] = sample(frame + i, channel);
+            }
+        }
+        QVERIFY(writer.write(block.constData(), frames));
+    }
+    QVERIFY(writer.finish());
+}
+
+/* reads this many frames and compares them with the ones written at this position */
+bool TestRenderCache::verify(RenderCache::Reader &reader, qint64 frame, int frames)
+{
+    QVector<EAS_PCM> buffer(frames * CHANNELS);
+    const int expected = int(qMin<qint64>(frames, TOTAL_FRAMES - frame));
+    if (reader.read(buffer.data(), frames) != expected) {
+        return false;
+    }
+    for (int i = 0; i < expected; ++i) {
+        for (int channel = 0; channel < CHANNELS; ++channel) {
+            if (buffer.at(i * CHANNELS + channel) != sample(frame + i, channel)) {
+                return false;
+            }
+        }
+    }
+    return reader.position() == frame + expected;
+}
+
+void TestRenderCache::readAll()
+{
+    RenderCache::Reader reader;
+    QVERIFY(reader.open(m_fileName));
+    QCOMPARE(reader.frames(), qint64(TOTAL_FRAMES));
+    QCOMPARE(reader.channels(), CHANNELS);
+    QCOMPARE(reader.sampleRate(), 22050);
+    /* an odd read size, so that reads straddle the chunk boundaries */
+    for (qint64 frame = 0; frame < TOTAL_FRAMES; frame += 3000) {
+        QVERIFY(verify(reader, frame, 3000));
+    }
+    QVERIFY(reader.atEnd());
+    EAS_PCM buffer[CHANNELS];
+    QCOMPARE(reader.read(buffer, 1), 0);
+}
+
+void TestRenderCache::seek_data()
+{
+    QTest::addColumn<qint64>("start");
+    QTest::addColumn<qint64>("target");
+    QTest::newRow("start") << Q_INT64_C(0) << Q_INT64_C(0);
+    QTest::newRow("within the first chunk") << Q_INT64_C(0) << Q_INT64_C(100);
+    QTest::newRow("last frame of a chunk") << Q_INT64_C(0) << qint64(CHUNK_FRAMES - 1);
+    QTest::newRow("first frame of a chunk") << Q_INT64_C(0) << qint64(CHUNK_FRAMES);
+    QTest::newRow("two chunks ahead") << Q_INT64_C(100) << qint64(2 * CHUNK_FRAMES + 5);
+    QTest::newRow("into the last chunk") << qint64(CHUNK_FRAMES + 1) << qint64(3 * CHUNK_FRAMES + 10);
+    QTest::newRow("next chunk") << qint64(CHUNK_FRAMES - 10) << qint64(CHUNK_FRAMES + 10);
+    QTest::newRow("back within a chunk") << qint64(2 * CHUNK_FRAMES + 500) << qint64(2 * CHUNK_FRAMES + 1);
+    QTest::newRow("back to an earlier chunk") << qint64(3 * CHUNK_FRAMES + 10) << Q_INT64_C(7);
+    QTest::newRow("back to a chunk boundary") << qint64(2 * CHUNK_FRAMES + 1) << qint64(CHUNK_FRAMES);
+    QTest::newRow("end") << Q_INT64_C(0) << qint64(TOTAL_FRAMES);
+    QTest::newRow("past the end") << qint64(CHUNK_FRAMES) << qint64(TOTAL_FRAMES + 5000);
+    QTest::newRow("before the start") << qint64(CHUNK_FRAMES) << Q_INT64_C(-10);
+}
+
+void TestRenderCache::seek()
+{
+    QFETCH(qint64, start);
+    QFETCH(qint64, target);
+    RenderCache::Reader reader;
+    QVERIFY(reader.open(m_fileName));
+    /* the reader is left in the middle of the chunk holding the start */
+    if (start > 0) {
+        QVERIFY(reader.seek(start - 1));
+        QVERIFY(verify(reader, start - 1, 1));
+    }
+    QVERIFY(reader.seek(target));
+    const qint64 frame = qBound<qint64>(0, target, TOTAL_FRAMES);
+    QCOMPARE(reader.position(), frame);
+    QCOMPARE(reader.atEnd(), frame == TOTAL_FRAMES);
+    QVERIFY(verify(reader, frame, CHUNK_FRAMES + 17));
+}
+
+void TestRenderCache::seekSequence()
+{
+    RenderCache::Reader reader;
+    QVERIFY(reader.open(m_fileName));
+    quint32 random = 12345;
+    for (int i = 0; i < 200; ++i) {
+        random = random * 1103515245 + 12345;
+        const qint64 frame = (random >> 8) % TOTAL_FRAMES;
+        QVERIFY(reader.seek(frame));
+        QVERIFY2(verify(reader, frame, int(random % 3000) + 1), qPrintable(QString::number(frame)));
+    }
+}
+
+void TestRenderCache::truncated()
+{
+    const QString fileName = m_dir.filePath(QStringLiteral("truncated.svc"));
+    QVERIFY(QFile::copy(m_fileName, fileName));
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.resize(file.size() / 2));
+    file.close();
+
+    RenderCache::Reader reader;
+    QVERIFY(reader.open(fileName));
+    /* a seek past the chunks present fails and the entry ends at the last one */
+    QVERIFY(!reader.seek(TOTAL_FRAMES - 1));
+    QVERIFY(reader.frames() < TOTAL_FRAMES);
+    QVERIFY(reader.frames() % CHUNK_FRAMES == 0);
+    QVERIFY(reader.atEnd());
+    QVERIFY(reader.seek(0));
+    QVERIFY(verify(reader, 0, 100));
+}
+
+QTEST_GUILESS_MAIN(TestRenderCache)
+
+#include "tst_rendercache.moc"
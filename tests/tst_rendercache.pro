@@ -0,0 +1,4 @@
+include(tests.pri)
+
+TARGET = tst_rendercache
+SOURCES += tst_rendercache.cpp
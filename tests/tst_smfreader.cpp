@@ -0,0 +1,277 @@
+/*
+    Sonivox EAS Synthesizer for Qt applications
+    Copyright (C) 2016-2024, Pedro Lopez-Cabanillas <plcl@users.sf.net>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QFile>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <QtTest>
+#include <cstddef>
+
+#include "compactsong.h"
+#include "smfreader.h"
+
+/* a standard MIDI file with these track chunks, 96 ticks per quarter note */
+static QByteArray smf(const QList<QByteArray> &tracks, int division = 96)
+{
+    uchar header[14] = { 'M', 'T', 'h', 'd' };
+    qToBigEndian<quint32>(6, header + 4);
+    qToBigEndian<quint16>(1, header + 8);
+    qToBigEndian<quint16>(quint16(tracks.count()), header + 10);
+    qToBigEndian<quint16>(quint16(division), header + 12);
+    QByteArray data(reinterpret_cast<const char *>(header), sizeof(header));
+    for (const QByteArray &track : tracks) {
+        uchar chunk[8] = { 'M', 'T', 'r', 'k' };
+        qToBigEndian<quint32>(quint32(track.size()), chunk + 4);
+        data += QByteArray(reinterpret_cast<const char *>(chunk), sizeof(chunk)) + track;
+    }
+    return data;
+}
+
+static QByteArray message(const SmfReader &reader, const SmfReader::Event &event)
+{
+    return QByteArray(reinterpret_cast<const char *>(reader.data(event)), event.length);
+}
+
+static QByteArray message(const CompactSong &song, int index)
+{
+    const CompactSong::Event &event = song.event(index);
+    return QByteArray(reinterpret_cast<const char *>(song.data(event)), event.length);
+}
+
+template<typename T>
+static QByteArray native(T value)
+{
+    return QByteArray(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+class TestSmfReader : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void malformed_data();
+    void malformed();
+    void truncatedTrack_data();
+    void truncatedTrack();
+    void runningStatus();
+    void tempoMap();
+    void unknownChunks();
+    void compactBuild();
+    void compiledStale_data();
+    void compiledStale();
+
+private:
+    QString writeSong();
+
+    QTemporaryDir m_dir;
+};
+
+/* tempo at the start, a note on, a system exclusive message and a note off, a beat apart */
+static const char *SONG = "00ff510307a120" "00903c64" "60f00341" "10f7" "60803c00" "00ff2f00";
+
+void TestSmfReader::initTestCase()
+{
+    /* compiled songs go to a test location, not to the cache of the user */
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(m_dir.isValid());
+}
+
+void TestSmfReader::malformed_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    const QByteArray song = smf({ QByteArray::fromHex(SONG) });
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("not a MIDI file") << QByteArray("RIFF0000WAVEfmt ");
+    QTest::newRow("truncated header") << song.left(12);
+    QByteArray longHeader = song;
+    longHeader[7] = char(0x7f);
+    QTest::newRow("header length past the end") << longHeader;
+    QByteArray noDivision = song;
+    noDivision[12] = 0;
+    noDivision[13] = 0;
+    QTest::newRow("zero division") << noDivision;
+    QTest::newRow("no track chunk") << song.left(14);
+    QTest::newRow("truncated chunk header") << song.left(18);
+    QTest::newRow("data byte without status") << smf({ QByteArray::fromHex("003c64") });
+    QTest::newRow("unexpected status") << smf({ QByteArray::fromHex("00903c6400f10000") });
+    QTest::newRow("invalid RMID") << QByteArray("RIFF\x20\0\0\0RMIDLIST\x40\0\0\0", 20);
+}
+
+void TestSmfReader::malformed()
+{
+    QFETCH(QByteArray, data);
+    SmfReader reader;
+    QVERIFY(!reader.parse(data));
+    QVERIFY(!reader.errorString().isEmpty());
+}
+
+void TestSmfReader::truncatedTrack_data()
+{
+    QTest::addColumn<QByteArray>("track");
+    QTest::addColumn<int>("events");
+    /* the events before the damage are kept */
+    QTest::newRow("truncated channel message") << QByteArray::fromHex("00903c6460803c") << 1;
+    QTest::newRow("truncated delta time") << QByteArray::fromHex("00903c64ffffffff") << 1;
+    QTest::newRow("truncated meta event") << QByteArray::fromHex("00903c6400ff510307a1") << 1;
+    QTest::newRow("system exclusive past the end") << QByteArray::fromHex("00903c6400f01041") << 1;
+    QTest::newRow("events after the end of track") << QByteArray::fromHex("00903c6400ff2f0000803c00") << 1;
+    QTest::newRow("empty track") << QByteArray() << 0;
+}
+
+void TestSmfReader::truncatedTrack()
+{
+    QFETCH(QByteArray, track);
+    QFETCH(int, events);
+    SmfReader reader;
+    QVERIFY2(reader.parse(smf({ track })), qPrintable(reader.errorString()));
+    QCOMPARE(reader.events().count(), events);
+    if (events > 0) {
+        QCOMPARE(message(reader, reader.events().first()), QByteArray::fromHex("903c64"));
+    }
+
+    /* a chunk size past the end of the file is cut to the data present */
+    QByteArray data = smf({ track });
+    qToBigEndian<quint32>(0x7fffffff, reinterpret_cast<uchar *>(data.data()) + 18);
+    QVERIFY(reader.parse(data));
+    QCOMPARE(reader.events().count(), events);
+}
+
+void TestSmfReader::runningStatus()
+{
+    SmfReader reader;
+    QVERIFY(reader.parse(smf({ QByteArray::fromHex("00903c6400403060c1050040") })));
+    QCOMPARE(reader.events().count(), 4);
+    QCOMPARE(message(reader, reader.events().at(1)), QByteArray::fromHex("904030"));
+    QCOMPARE(message(reader, reader.events().at(2)), QByteArray::fromHex("c105"));
+    QCOMPARE(reader.channel(reader.events().at(2)), 1);
+    QCOMPARE(message(reader, reader.events().at(3)), QByteArray::fromHex("c140"));
+}
+
+void TestSmfReader::tempoMap()
+{
+    SmfReader reader;
+    /* a beat at the default tempo, then a beat at one second per quarter note */
+    QVERIFY(reader.parse(smf({ QByteArray::fromHex("00903c6460803c0000ff51030f424060903e64") })));
+    QCOMPARE(reader.events().count(), 3);
+    QCOMPARE(reader.events().at(1).time, Q_INT64_C(500000));
+    QCOMPARE(reader.events().at(2).time, Q_INT64_C(1500000));
+    QCOMPARE(reader.tempoMap().count(), 1);
+    QCOMPARE(reader.tempoMap().first().time, Q_INT64_C(500000));
+    QCOMPARE(reader.tempoMap().first().tempo, 1000000);
+}
+
+void TestSmfReader::unknownChunks()
+{
+    QByteArray data = smf({ QByteArray::fromHex(SONG) });
+    data.insert(14, QByteArray("XFIH\0\0\0\x04" "abcd", 12));
+    SmfReader reader;
+    QVERIFY(reader.parse(data));
+    QCOMPARE(reader.tracks(), 1);
+    QCOMPARE(reader.events().count(), 3);
+    QCOMPARE(reader.channel(reader.events().at(1)), -1);
+    QCOMPARE(message(reader, reader.events().at(1)), QByteArray::fromHex("f04110f7"));
+}
+
+void TestSmfReader::compactBuild()
+{
+    SmfReader reader;
+    QVERIFY(reader.parse(smf({ QByteArray::fromHex(SONG) })));
+    CompactSong song;
+    song.build(reader);
+    QCOMPARE(song.count(), 3);
+    QCOMPARE(song.event(0).kind, quint8(CompactSong::ChannelMessage));
+    QCOMPARE(message(song, 0), QByteArray::fromHex("903c64"));
+    QCOMPARE(song.event(1).kind, quint8(CompactSong::SystemExclusive));
+    QCOMPARE(message(song, 1), QByteArray::fromHex("f04110f7"));
+    QCOMPARE(message(song, 2), QByteArray::fromHex("803c00"));
+    QCOMPARE(song.duration(), Q_INT64_C(1000000));
+    QCOMPARE(song.locate(0), 0);
+    QCOMPARE(song.locate(1), 1);
+    QCOMPARE(song.locate(1000000), 2);
+    QCOMPARE(song.locate(1000001), 3);
+}
+
+QString TestSmfReader::writeSong()
+{
+    const QString fileName = m_dir.filePath(QStringLiteral("song.mid"));
+    if (!QFile::exists(fileName)) {
+        QFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly) || file.write(smf({ QByteArray::fromHex(SONG) })) < 0) {
+            return QString();
+        }
+    }
+    return fileName;
+}
+
+void TestSmfReader::compiledStale_data()
+{
+    QTest::addColumn<qint64>("offset");  /* from the first event, or -1 to truncate */
+    QTest::addColumn<QByteArray>("patch");
+    const qint64 event = sizeof(CompactSong::Event);
+    QTest::newRow("truncated") << Q_INT64_C(-1) << QByteArray();
+    QTest::newRow("channel message too long")
+            << qint64(offsetof(CompactSong::Event, length)) << native<quint16>(4);
+    QTest::newRow("system exclusive past the blob")
+            << qint64(event + offsetof(CompactSong::Event, offset)) << native<quint32>(2);
+    QTest::newRow("unsorted events")
+            << qint64(event + offsetof(CompactSong::Event, time)) << native<qint64>(2000000);
+    QTest::newRow("unknown kind")
+            << qint64(2 * event + offsetof(CompactSong::Event, kind)) << native<quint8>(7);
+    QTest::newRow("missing status")
+            << qint64(2 * event + offsetof(CompactSong::Event, bytes)) << native<quint8>(0x3c);
+    QTest::newRow("invalid tempo")
+            << qint64(3 * event + offsetof(CompactSong::Tempo, tempo)) << native<qint32>(0);
+}
+
+void TestSmfReader::compiledStale()
+{
+    QFETCH(qint64, offset);
+    QFETCH(QByteArray, patch);
+    const QString fileName = writeSong();
+    QVERIFY(!fileName.isEmpty());
+    CompactSong song;
+    QVERIFY2(song.compile(fileName), qPrintable(song.errorString()));
+    QVERIFY(song.load(fileName, false));
+    QCOMPARE(song.count(), 3);
+
+    QFile compiled(CompactSong::compiledFileName(fileName));
+    QVERIFY(compiled.open(QIODevice::ReadWrite));
+    /* the events start after the header, with one tempo change, 4 sysex bytes and no title */
+    const qint64 events = compiled.size() - 4 * qint64(sizeof(CompactSong::Event)) - 4;
+    if (offset < 0) {
+        QVERIFY(compiled.resize(compiled.size() - 1));
+    } else {
+        QVERIFY(compiled.seek(events + offset));
+        QCOMPARE(compiled.write(patch), qint64(patch.size()));
+    }
+    compiled.close();
+
+    QVERIFY(!song.load(fileName, false));
+    QVERIFY(song.isEmpty());
+    /* a stale compiled song is replaced */
+    QVERIFY(song.load(fileName));
+    QCOMPARE(song.count(), 3);
+    QCOMPARE(message(song, 1), QByteArray::fromHex("f04110f7"));
+    QVERIFY(song.load(fileName, false));
+}
+
+QTEST_GUILESS_MAIN(TestSmfReader)
+
+#include "tst_smfreader.moc"
@@ -0,0 +1,4 @@
+include(tests.pri)
+
+TARGET = tst_smfreader
+SOURCES += tst_smfreader.cpp